@@ -0,0 +1,188 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cpu_affinity.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <packet_pool.hpp>
+#include <pthread.h>
+#include <sched.h>
+#include <spsc_queue.hpp>
+#include <thread>
+#include <vector>
+
+using namespace metric_collector::ingestion;
+
+namespace
+{
+constexpr std::size_t PAYLOAD     = 512;
+constexpr std::size_t BUFFERS     = 8192;
+constexpr std::size_t QUEUE_DEPTH = 4096;
+constexpr std::size_t POP_BATCH   = 64;
+
+using Queue = SpscQueue<Packet, QUEUE_DEPTH, FullPolicy::DropNewest>;
+
+// Where the receive side (this thread), the worker and the pool and queue between them sit.
+enum class Placement : uint8_t
+{
+    Unpinned,    // left to the scheduler, memory wherever the benchmark thread is
+    SameNode,    // two cpus of one node, memory on that node
+    CrossNode,   // worker on another node than the receive side and the memory
+    RemoteMemory // both threads on one node, the pool and queue on another
+};
+
+const char* name_of(Placement placement)
+{
+    switch (placement)
+    {
+    case Placement::Unpinned:
+        return "unpinned";
+    case Placement::SameNode:
+        return "same_node";
+    case Placement::CrossNode:
+        return "cross_node";
+    case Placement::RemoteMemory:
+        return "remote_memory";
+    }
+    return "unknown";
+}
+
+struct Cpus
+{
+    int receiver{ANY_CPU};
+    int worker{ANY_CPU};
+    int memory{ANY_CPU};
+};
+
+// false if the machine does not have the cpus or nodes the placement needs
+bool pick_cpus(Placement placement, Cpus& cpus)
+{
+    auto nodes = numa_nodes();
+    switch (placement)
+    {
+    case Placement::Unpinned:
+        return true;
+    case Placement::SameNode:
+        for (const auto& node : nodes)
+        {
+            if (node.size() >= 2)
+            {
+                cpus = {node[0], node[1], node[0]};
+                return true;
+            }
+        }
+        return false;
+    case Placement::CrossNode:
+        if (nodes.size() < 2)
+        {
+            return false;
+        }
+        cpus = {nodes[0][0], nodes[1][0], nodes[0][0]};
+        return true;
+    case Placement::RemoteMemory:
+        for (std::size_t i = 0; i < nodes.size() && nodes.size() >= 2; i++)
+        {
+            if (nodes[i].size() >= 2)
+            {
+                cpus = {nodes[i][0], nodes[i][1], nodes[(i + 1) % nodes.size()][0]};
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+// The listener to worker handoff on its own: this thread fills pool buffers and pushes them, a
+// worker thread pops them, reads every byte and releases them. The pool and the queue are
+// allocated and first touched on the memory cpu, so their pages come from that cpu's node.
+void BM_Handoff(benchmark::State& state)
+{
+    auto placement = static_cast<Placement>(state.range(0));
+    Cpus cpus;
+    if (!pick_cpus(placement, cpus))
+    {
+        state.SkipWithError("not enough cpus or numa nodes for this placement");
+        return;
+    }
+    state.SetLabel(name_of(placement));
+
+    auto pool  = construct_on(cpus.memory,
+                              []() { return std::make_unique<PacketPool>(BUFFERS, PAYLOAD); });
+    auto queue = construct_on(cpus.memory, []() { return std::make_unique<Queue>(); });
+
+    std::atomic<bool>     running{true};
+    std::atomic<uint64_t> checksum{0};
+    std::thread           worker(
+        [&]()
+        {
+            pin_thread(cpus.worker);
+
+            std::vector<Packet> batch(POP_BATCH);
+            uint64_t            sum = 0;
+            for (;;)
+            {
+                std::size_t n = queue->pop_n(batch);
+                if (n == 0)
+                {
+                    if (!running.load(std::memory_order_acquire) && queue->size() == 0)
+                    {
+                        break;
+                    }
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    for (auto byte : batch[i].data())
+                    {
+                        sum += static_cast<uint8_t>(byte);
+                    }
+                    batch[i].release();
+                }
+            }
+            checksum.store(sum, std::memory_order_relaxed);
+        });
+
+    // this thread stands in for the listener, put its affinity back for the next benchmark
+    cpu_set_t saved;
+    pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved);
+    pin_thread(cpus.receiver);
+
+    uint64_t handed = 0;
+    for (auto _ : state)
+    {
+        auto index = pool->acquire();
+        while (index == PacketPool::INVALID_INDEX)
+        {
+            std::this_thread::yield();
+            index = pool->acquire();
+        }
+        std::memset(pool->buffer(index).data(), static_cast<int>(handed), PAYLOAD);
+
+        Packet packet{pool.get(), index, static_cast<uint32_t>(PAYLOAD), 0};
+        while (!queue->try_push(packet))
+        {
+            std::this_thread::yield();
+        }
+        handed++;
+    }
+
+    running.store(false, std::memory_order_release);
+    worker.join();
+    pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+
+    benchmark::DoNotOptimize(checksum.load(std::memory_order_relaxed));
+    state.SetItemsProcessed(static_cast<int64_t>(handed));
+    state.SetBytesProcessed(static_cast<int64_t>(handed * PAYLOAD));
+}
+} // namespace
+
+BENCHMARK(BM_Handoff)
+    ->ArgName("placement")
+    ->Arg(static_cast<int>(Placement::Unpinned))
+    ->Arg(static_cast<int>(Placement::SameNode))
+    ->Arg(static_cast<int>(Placement::CrossNode))
+    ->Arg(static_cast<int>(Placement::RemoteMemory))
+    ->UseRealTime();
@@ -0,0 +1,43 @@
+#include "fixtures.hpp"
+
+#include <benchmark/benchmark.h>
+#include <prometheus_page.hpp>
+
+using namespace metric_collector::aggregation;
+using namespace metric_collector::exposition;
+using namespace metric_collector::benchmarks;
+
+namespace
+{
+// what a rotation pays to make every scrape free
+void BM_RenderPage(benchmark::State& state)
+{
+    auto           ring     = sealed_ring(static_cast<std::size_t>(state.range(0)));
+    auto           snapshot = ring->snapshot();
+    PrometheusPage page;
+
+    for (auto _ : state)
+    {
+        page.render(*snapshot);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+    state.counters["body_bytes"] = static_cast<double>(page.current()->body.size());
+}
+
+// what a scrape pays before the writev
+void BM_ScrapePage(benchmark::State& state)
+{
+    auto           ring = sealed_ring(1024);
+    PrometheusPage page;
+    page.render(*ring->snapshot());
+
+    for (auto _ : state)
+    {
+        auto current = page.current();
+        benchmark::DoNotOptimize(current->body.data());
+    }
+}
+} // namespace
+
+BENCHMARK(BM_RenderPage)->Arg(1024)->Arg(1 << 16)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ScrapePage)->ThreadRange(1, 4);
@@ -0,0 +1,61 @@
+#ifndef METRIC_COLLECTOR_BENCHMARKS_FIXTURES_HPP
+#define METRIC_COLLECTOR_BENCHMARKS_FIXTURES_HPP
+
+#include <bucket_ring.hpp>
+#include <cstddef>
+#include <local_table.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Inputs shared by the benchmarks, so their numbers are measured on the same names.
+namespace metric_collector::benchmarks
+{
+// the i-th metric name, spread over 64 services the way a fleet's names are
+inline std::string metric_name(std::size_t i)
+{
+    return "service" + std::to_string(i % 64) + ".api.endpoint" + std::to_string(i);
+}
+
+inline std::vector<std::string> metric_names(std::size_t count)
+{
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        names.push_back(metric_name(i));
+    }
+    return names;
+}
+
+// a ring with one sealed window of num_names metrics, every type in turn
+inline std::unique_ptr<aggregation::MetricRing> sealed_ring(std::size_t num_names)
+{
+    auto                    ring = std::make_unique<aggregation::MetricRing>();
+    aggregation::LocalTable local(ring->names());
+    for (std::size_t i = 0; i < num_names; i++)
+    {
+        auto name = metric_name(i);
+        switch (i % 4)
+        {
+        case 0:
+            local.add<aggregation::Counter>(name, i);
+            break;
+        case 1:
+            local.add<aggregation::Gauge>(name, i);
+            break;
+        case 2:
+            local.add<aggregation::Timer>(name, i);
+            break;
+        default:
+            local.add<aggregation::Set>(name, i);
+            break;
+        }
+    }
+    ring->merge(local);
+    ring->rotate();
+    return ring;
+}
+} // namespace metric_collector::benchmarks
+
+#endif
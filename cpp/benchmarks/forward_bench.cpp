@@ -0,0 +1,113 @@
+#include "fixtures.hpp"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <upstream_forwarder.hpp>
+
+using namespace metric_collector::aggregation;
+using namespace metric_collector::exposition;
+using namespace metric_collector::benchmarks;
+
+namespace
+{
+// Local stand-in for the upstream StatsD: counts the datagrams and bytes that arrive.
+class StandInReceiver
+{
+  public:
+    explicit StandInReceiver(uint16_t port)
+    {
+        fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+
+        int size = 8 << 20; // a whole window arrives in one burst
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+        timeval timeout{0, 10000};
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port   = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~StandInReceiver()
+    {
+        running_ = false;
+        thread_.join();
+        close(fd_);
+    }
+
+    // wait until expected datagrams arrived or the socket went quiet
+    void wait_for(uint64_t expected) const
+    {
+        for (int i = 0; i < 100 && packets_.load() < expected; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    [[nodiscard]] uint64_t packets() const { return packets_.load(); }
+    [[nodiscard]] uint64_t bytes() const { return bytes_.load(); }
+
+  private:
+    void run()
+    {
+        char buf[65536];
+        while (running_)
+        {
+            ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+            if (n > 0)
+            {
+                packets_.fetch_add(1);
+                bytes_.fetch_add(static_cast<uint64_t>(n));
+            }
+        }
+    }
+
+    int                   fd_{-1};
+    std::atomic<bool>     running_{true};
+    std::atomic<uint64_t> packets_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::thread           thread_;
+};
+
+// One window per iteration through the packing and sendmmsg path, with what the stand-in saw
+// per flush; received below datagrams means loopback drops, not forwarder loss.
+void BM_ForwardWindow(benchmark::State& state)
+{
+    constexpr uint16_t PORT = 9500;
+
+    auto              ring     = sealed_ring(static_cast<std::size_t>(state.range(0)));
+    auto              snapshot = ring->snapshot();
+    StandInReceiver   receiver(PORT);
+    UpstreamForwarder forwarder(ForwarderOptions{.host = "127.0.0.1", .port = PORT});
+
+    FlushStats stats;
+    for (auto _ : state)
+    {
+        stats = forwarder.flush(*snapshot);
+    }
+    receiver.wait_for(stats.datagrams * state.iterations());
+
+    auto flushes = static_cast<double>(state.iterations());
+    state.SetItemsProcessed(static_cast<int64_t>(stats.lines * state.iterations()));
+    state.counters["lines"]        = static_cast<double>(stats.lines);
+    state.counters["datagrams"]    = static_cast<double>(stats.datagrams);
+    state.counters["bytes"]        = static_cast<double>(stats.bytes);
+    state.counters["fill"]         = static_cast<double>(stats.bytes) /
+                             static_cast<double>(stats.datagrams * DEFAULT_UPSTREAM_PAYLOAD);
+    state.counters["recv_packets"] = static_cast<double>(receiver.packets()) / flushes;
+    state.counters["recv_bytes"]   = static_cast<double>(receiver.bytes()) / flushes;
+}
+} // namespace
+
+BENCHMARK(BM_ForwardWindow)->Arg(1024)->Arg(1 << 14)->Unit(benchmark::kMicrosecond);
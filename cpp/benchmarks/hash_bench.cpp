@@ -0,0 +1,104 @@
+#include "fixtures.hpp"
+
+#include <benchmark/benchmark.h>
+#include <hash.hpp>
+#include <local_table.hpp>
+#include <name_table.hpp>
+#include <string>
+#include <vector>
+
+using namespace metric_collector::aggregation;
+using namespace metric_collector::benchmarks;
+
+namespace
+{
+std::vector<std::string> make_names(std::size_t count, std::size_t length)
+{
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto name = metric_name(i);
+        name.resize(length, 'x');
+        names.push_back(std::move(name));
+    }
+    return names;
+}
+
+// the byte at a time hash keys were derived with before hash_bytes
+void BM_HashFnv1a(benchmark::State& state)
+{
+    auto     names = make_names(1024, static_cast<std::size_t>(state.range(0)));
+    uint64_t sink  = 0;
+
+    for (auto _ : state)
+    {
+        for (const auto& name : names)
+        {
+            sink ^= hash_fnv1a(name.data(), name.size());
+        }
+    }
+    benchmark::DoNotOptimize(sink);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+
+void BM_HashBytes(benchmark::State& state)
+{
+    auto     names = make_names(1024, static_cast<std::size_t>(state.range(0)));
+    uint64_t sink  = 0;
+
+    for (auto _ : state)
+    {
+        for (const auto& name : names)
+        {
+            sink ^= hash_bytes(name.data(), name.size());
+        }
+    }
+    benchmark::DoNotOptimize(sink);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+
+// names already interned, what BucketRing::store and the first sight of a name in an interval pay
+void BM_NameTableIntern(benchmark::State& state)
+{
+    auto      names = make_names(static_cast<std::size_t>(state.range(0)), 40);
+    NameTable table;
+    for (const auto& name : names)
+    {
+        table.intern(name);
+    }
+
+    uint64_t sink = 0;
+    for (auto _ : state)
+    {
+        for (const auto& name : names)
+        {
+            sink ^= table.intern(name).key;
+        }
+    }
+    benchmark::DoNotOptimize(sink);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+
+// the per sample worker path: hash, one probe and a name compare
+void BM_LocalTableAdd(benchmark::State& state)
+{
+    auto       names = make_names(static_cast<std::size_t>(state.range(0)), 40);
+    NameTable  table;
+    LocalTable local(table);
+
+    for (auto _ : state)
+    {
+        for (const auto& name : names)
+        {
+            local.add<Counter>(name, 1);
+        }
+    }
+    benchmark::DoNotOptimize(local.size());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+} // namespace
+
+BENCHMARK(BM_HashFnv1a)->ArgName("len")->Arg(16)->Arg(40)->Arg(128);
+BENCHMARK(BM_HashBytes)->ArgName("len")->Arg(16)->Arg(40)->Arg(128);
+BENCHMARK(BM_NameTableIntern)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(BM_LocalTableAdd)->Arg(1 << 10)->Arg(1 << 16);
@@ -0,0 +1,163 @@
+#include <arpa/inet.h>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <bucket_ring.hpp>
+#include <chrono>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <self_stats.hpp>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <udp_server.hpp>
+#include <unistd.h>
+
+using namespace metric_collector::ingestion;
+using namespace metric_collector::aggregation;
+
+namespace
+{
+constexpr std::size_t SEND_BATCH    = 64;
+constexpr std::size_t CLIENT_PAYLOAD = 512;  // a typical client batch
+constexpr std::size_t MTU_PAYLOAD    = 1400; // a client batch sized for a 1500 byte MTU
+constexpr std::size_t GSO_BATCH      = 32;   // datagrams per UDP_SEGMENT send
+
+// a client batch that fits size
+std::string make_payload(std::size_t size = CLIENT_PAYLOAD)
+{
+    std::string payload;
+    for (int i = 0; payload.size() < size - 64; i++)
+    {
+        payload += "service.api.endpoint" + std::to_string(i) + ".latency:" +
+                   std::to_string(i * 37) + "|t\n";
+    }
+    return payload;
+}
+
+// Blasts datagrams over loopback at a single inline listener and counts what it picked up.
+// Both ends share the machine, so compare backends by the received rate and the drop count
+// rather than by the wall time per iteration.
+void BM_Loopback(benchmark::State& state)
+{
+    auto             backend = static_cast<Backend>(state.range(0));
+    UdpServerOptions options{.port          = static_cast<uint16_t>(9400 + state.range(0)),
+                             .addr          = "127.0.0.1",
+                             .num_listeners = 1,
+                             .inline_parse  = true,
+                             .backend       = backend};
+
+    auto        ring   = std::make_unique<MetricRing>();
+    UdpServer   server(options, *ring);
+    std::thread thread([&] { server.run(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    int         fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port   = htons(options.port);
+    inet_pton(AF_INET, options.addr.c_str(), &dest.sin_addr);
+
+    auto                            payload = make_payload();
+    iovec                           iov{payload.data(), payload.size()};
+    std::array<mmsghdr, SEND_BATCH> msgs{};
+    for (auto& msg : msgs)
+    {
+        msg.msg_hdr.msg_name    = &dest;
+        msg.msg_hdr.msg_namelen = sizeof(dest);
+        msg.msg_hdr.msg_iov     = &iov;
+        msg.msg_hdr.msg_iovlen  = 1;
+    }
+
+    uint64_t sent = 0;
+    for (auto _ : state)
+    {
+        int n = sendmmsg(fd, msgs.data(), msgs.size(), 0);
+        if (n > 0)
+        {
+            sent += static_cast<uint64_t>(n);
+        }
+    }
+
+    // let the listener drain what is still queued on the socket
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    server.stop();
+    thread.join();
+    close(fd);
+
+    auto received = server.counted(SelfCounter::PacketsReceived);
+    state.SetItemsProcessed(static_cast<int64_t>(received));
+    state.SetBytesProcessed(static_cast<int64_t>(received * payload.size()));
+    state.counters["sent"]     = static_cast<double>(sent);
+    state.counters["received"] = static_cast<double>(received);
+    state.counters["dropped"]  = static_cast<double>(sent - std::min(sent, received));
+}
+
+// MTU sized datagrams sent GSO_BATCH at a time with UDP_SEGMENT, so they cross loopback as one
+// skb. Without UDP_GRO the receiving socket splits it and recvmmsg returns every datagram in a
+// slot of its own; with it the whole run lands in one buffer and is split by the listener.
+void BM_LoopbackGro(benchmark::State& state)
+{
+    bool             gro = state.range(0) != 0;
+    UdpServerOptions options{.port          = static_cast<uint16_t>(9410 + state.range(0)),
+                             .addr          = "127.0.0.1",
+                             .num_listeners = 1,
+                             .inline_parse  = true,
+                             .max_datagram  = MTU_PAYLOAD,
+                             .udp_gro       = gro};
+
+    auto        ring   = std::make_unique<MetricRing>();
+    UdpServer   server(options, *ring);
+    std::thread thread([&] { server.run(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    int         fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port   = htons(options.port);
+    inet_pton(AF_INET, options.addr.c_str(), &dest.sin_addr);
+    connect(fd, reinterpret_cast<sockaddr*>(&dest), sizeof(dest));
+
+    // every datagram of a run must be segment sized, only the last may be shorter
+    auto payload = make_payload(MTU_PAYLOAD);
+    payload.resize(MTU_PAYLOAD, '\n');
+    std::string run;
+    for (std::size_t i = 0; i < GSO_BATCH; i++)
+    {
+        run += payload;
+    }
+
+    int segment = static_cast<int>(MTU_PAYLOAD);
+    setsockopt(fd, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment));
+
+    uint64_t sent = 0;
+    for (auto _ : state)
+    {
+        if (send(fd, run.data(), run.size(), 0) > 0)
+        {
+            sent += GSO_BATCH;
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    server.stop();
+    thread.join();
+    close(fd);
+
+    auto received  = server.counted(SelfCounter::PacketsReceived);
+    auto truncated = server.counted(SelfCounter::DatagramsTruncated);
+    state.SetItemsProcessed(static_cast<int64_t>(received));
+    state.SetBytesProcessed(static_cast<int64_t>(received * payload.size()));
+    state.counters["sent"]      = static_cast<double>(sent);
+    state.counters["received"]  = static_cast<double>(received);
+    state.counters["dropped"]   = static_cast<double>(sent - std::min(sent, received));
+    state.counters["truncated"] = static_cast<double>(truncated);
+}
+} // namespace
+
+BENCHMARK(BM_Loopback)
+    ->ArgName("backend")
+    ->Arg(static_cast<int>(Backend::Epoll))
+    ->Arg(static_cast<int>(Backend::IoUring))
+    ->UseRealTime();
+BENCHMARK(BM_LoopbackGro)->ArgName("gro")->Arg(0)->Arg(1)->UseRealTime();
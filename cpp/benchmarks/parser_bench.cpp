@@ -0,0 +1,139 @@
+#include "fixtures.hpp"
+
+#include <aggregator.hpp>
+#include <benchmark/benchmark.h>
+#include <bucket_ring.hpp>
+#include <memory>
+#include <parser.hpp>
+#include <random>
+#include <self_stats.hpp>
+#include <string>
+#include <vector>
+
+using namespace metric_collector::ingestion;
+using namespace metric_collector::aggregation;
+using namespace metric_collector::benchmarks;
+
+namespace
+{
+constexpr std::size_t DATAGRAM_SIZE = 1400;
+
+// StatsD lines packed back to back up to the datagram size, the way client libraries batch them
+std::vector<std::string> make_datagrams(std::size_t count)
+{
+    std::mt19937_64          rng(42);
+    const char*              types[] = {"c", "g", "t"};
+    std::vector<std::string> datagrams;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::string datagram;
+        while (true)
+        {
+            auto line = metric_name(rng() % 1024) + ".latency:" +
+                        std::to_string(rng() % 100000) + "|" + types[rng() % 3];
+            if (datagram.size() + line.size() + 1 > DATAGRAM_SIZE)
+            {
+                break;
+            }
+            datagram += line;
+            datagram += '\n';
+        }
+        datagrams.push_back(std::move(datagram));
+    }
+    return datagrams;
+}
+
+// the per line find() parsing that parse_packet used before the delimiter bitmap
+void BM_ParseFindScan(benchmark::State& state)
+{
+    auto        datagrams = make_datagrams(256);
+    std::size_t bytes     = 0;
+    uint64_t    sink      = 0;
+
+    for (auto _ : state)
+    {
+        for (const auto& datagram : datagrams)
+        {
+            std::string_view packet = datagram;
+            std::size_t      pos    = 0;
+            while (pos < packet.size())
+            {
+                std::size_t end = packet.find('\n', pos);
+                if (end == std::string_view::npos)
+                {
+                    end = packet.size();
+                }
+                Parser::parse_metric(packet.substr(pos, end - pos),
+                                     [&](std::string_view, auto, uint64_t value)
+                                     { sink += value; });
+                pos = end + 1;
+            }
+            bytes += datagram.size();
+        }
+    }
+    benchmark::DoNotOptimize(sink);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+void BM_ParsePacket(benchmark::State& state)
+{
+    auto level = static_cast<SimdLevel>(state.range(0));
+    if (level > detect_simd_level())
+    {
+        state.SkipWithError("simd level not supported on this cpu");
+        return;
+    }
+    set_simd_level(level);
+
+    auto        datagrams = make_datagrams(256);
+    std::size_t bytes     = 0;
+    uint64_t    sink      = 0;
+
+    for (auto _ : state)
+    {
+        for (const auto& datagram : datagrams)
+        {
+            Parser::parse_packet(datagram,
+                                 [&](std::string_view, auto, uint64_t value) { sink += value; });
+            bytes += datagram.size();
+        }
+    }
+    benchmark::DoNotOptimize(sink);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+
+    set_simd_level(detect_simd_level());
+}
+
+// what a worker does with its packets: parse into the local table and merge it into the ring
+// after every pass, with the self stats counting along when they are built in
+void BM_Aggregate(benchmark::State& state)
+{
+    auto        datagrams = make_datagrams(256);
+    auto        ring      = std::make_unique<MetricRing>();
+    Aggregator  aggregator(*ring);
+    std::size_t bytes = 0;
+    uint64_t    lines = SelfStats::total(SelfCounter::LinesParsed);
+
+    for (auto _ : state)
+    {
+        for (const auto& datagram : datagrams)
+        {
+            aggregator.process(datagram);
+            bytes += datagram.size();
+        }
+        aggregator.merge();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(
+        static_cast<int64_t>(SelfStats::total(SelfCounter::LinesParsed) - lines));
+}
+} // namespace
+
+BENCHMARK(BM_ParseFindScan);
+BENCHMARK(BM_ParsePacket)
+    ->ArgName("simd")
+    ->Arg(static_cast<int>(SimdLevel::Scalar))
+    ->Arg(static_cast<int>(SimdLevel::Sse2))
+    ->Arg(static_cast<int>(SimdLevel::Avx2));
+BENCHMARK(BM_Aggregate);
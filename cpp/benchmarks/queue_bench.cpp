@@ -0,0 +1,202 @@
+#include <array>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <spsc_queue.hpp>
+
+using namespace metric_collector::ingestion;
+
+namespace
+{
+constexpr std::size_t CAPACITY = 8192;
+constexpr std::size_t BURST    = 64;
+
+// The queue the batched one replaced, kept as the baseline: both indices on one line, no
+// cached copies, and a full push that moves the consumer's index.
+template <typename T, std::size_t Capacity> class LegacySpscQueue
+{
+    static constexpr std::size_t MASK = Capacity - 1;
+
+  public:
+    void push(const T& item) noexcept
+    {
+        const auto wp   = write_pos_.load(std::memory_order_relaxed);
+        auto       rp   = read_pos_.load(std::memory_order_acquire);
+        auto       next = wp + 1;
+
+        if (next - rp > Capacity)
+        {
+            read_pos_.store(rp + 1, std::memory_order_release);
+        }
+
+        buffer_[wp & MASK] = item;
+        write_pos_.store(next, std::memory_order_release);
+    }
+
+    [[nodiscard]] std::optional<T> pop() noexcept
+    {
+        auto rp = read_pos_.load(std::memory_order_acquire);
+        auto wp = write_pos_.load(std::memory_order_acquire);
+        if (rp == wp)
+        {
+            return std::nullopt;
+        }
+
+        auto item = std::move(buffer_[rp & MASK]);
+        read_pos_.store(rp + 1, std::memory_order_release);
+        return item;
+    }
+
+  private:
+    std::array<T, Capacity>  buffer_;
+    std::atomic<std::size_t> write_pos_{0};
+    std::atomic<std::size_t> read_pos_{0};
+};
+
+using Legacy = LegacySpscQueue<uint64_t, CAPACITY>;
+using Queue  = SpscQueue<uint64_t, CAPACITY, FullPolicy::DropNewest>;
+
+constexpr auto ignore_drop = [](uint64_t&&) {};
+
+// one thread, a burst in and out: the per element cost without any contention
+void BM_LegacyPushPop(benchmark::State& state)
+{
+    static Legacy queue;
+    for (auto _ : state)
+    {
+        for (uint64_t i = 0; i < BURST; i++)
+        {
+            queue.push(i);
+        }
+        for (std::size_t i = 0; i < BURST; i++)
+        {
+            benchmark::DoNotOptimize(queue.pop());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * BURST));
+}
+
+void BM_QueuePushPop(benchmark::State& state)
+{
+    static Queue queue;
+    for (auto _ : state)
+    {
+        for (uint64_t i = 0; i < BURST; i++)
+        {
+            queue.push(i, ignore_drop);
+        }
+        for (std::size_t i = 0; i < BURST; i++)
+        {
+            benchmark::DoNotOptimize(queue.pop());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * BURST));
+}
+
+void BM_QueueBatchPushPop(benchmark::State& state)
+{
+    static Queue                queue;
+    std::array<uint64_t, BURST> in{};
+    std::array<uint64_t, BURST> out{};
+
+    for (auto _ : state)
+    {
+        queue.push_n(in, ignore_drop);
+        benchmark::DoNotOptimize(queue.pop_n(out));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * BURST));
+}
+
+// producer (thread 0) and consumer (thread 1) on separate threads, where the index lines
+// bounce between cores; items are what the consumer got
+template <typename Q, typename Push, typename Pop>
+void run_pipe(benchmark::State& state, Q& queue, Push push, Pop pop)
+{
+    int64_t consumed = 0;
+    for (auto _ : state)
+    {
+        if (state.thread_index() == 0)
+        {
+            push(queue);
+        }
+        else
+        {
+            consumed += static_cast<int64_t>(pop(queue));
+        }
+    }
+    state.SetItemsProcessed(consumed);
+}
+
+void BM_LegacyPipe(benchmark::State& state)
+{
+    static Legacy queue;
+    run_pipe(
+        state, queue,
+        [](Legacy& q)
+        {
+            for (uint64_t i = 0; i < BURST; i++)
+            {
+                q.push(i);
+            }
+        },
+        [](Legacy& q)
+        {
+            std::size_t n = 0;
+            while (n < BURST && q.pop().has_value())
+            {
+                n++;
+            }
+            return n;
+        });
+}
+
+void BM_QueuePipe(benchmark::State& state)
+{
+    static Queue queue;
+    run_pipe(
+        state, queue,
+        [](Queue& q)
+        {
+            for (uint64_t i = 0; i < BURST; i++)
+            {
+                q.push(i, ignore_drop);
+            }
+        },
+        [](Queue& q)
+        {
+            std::size_t n = 0;
+            while (n < BURST && q.pop().has_value())
+            {
+                n++;
+            }
+            return n;
+        });
+}
+
+void BM_QueueBatchPipe(benchmark::State& state)
+{
+    static Queue queue;
+    run_pipe(
+        state, queue,
+        [](Queue& q)
+        {
+            std::array<uint64_t, BURST> in{};
+            q.push_n(in, ignore_drop);
+        },
+        [](Queue& q)
+        {
+            std::array<uint64_t, BURST> out;
+            return q.pop_n(out);
+        });
+}
+} // namespace
+
+BENCHMARK(BM_LegacyPushPop);
+BENCHMARK(BM_QueuePushPop);
+BENCHMARK(BM_QueueBatchPushPop);
+BENCHMARK(BM_LegacyPipe)->Threads(2)->UseRealTime();
+BENCHMARK(BM_QueuePipe)->Threads(2)->UseRealTime();
+BENCHMARK(BM_QueueBatchPipe)->Threads(2)->UseRealTime();
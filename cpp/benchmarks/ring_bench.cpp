@@ -0,0 +1,214 @@
+#include "fixtures.hpp"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <bucket.hpp>
+#include <bucket_ring.hpp>
+#include <local_table.hpp>
+#include <memory>
+#include <name_table.hpp>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace metric_collector::aggregation;
+using namespace metric_collector::benchmarks;
+
+namespace
+{
+constexpr std::size_t MERGE_BATCH = 4096;
+
+// ~40 byte names spread over 64 services, in random order so consecutive samples hit
+// unrelated shards the way interleaved clients do
+std::vector<std::string> make_names(std::size_t count)
+{
+    auto names = metric_names(count);
+    for (auto& name : names)
+    {
+        name += ".latency";
+    }
+
+    std::mt19937_64 rng(42);
+    std::shuffle(names.begin(), names.end(), rng);
+    return names;
+}
+
+// State shared by every thread of a run. Thread 0 builds it before the timed loop and drops it
+// after; the loop's start and end are barriers across the threads, so only code inside the loop
+// may touch it.
+template <typename T> struct Shared
+{
+    std::unique_ptr<T>       target;
+    std::vector<std::string> names;
+    std::vector<uint64_t>    keys;
+};
+
+template <typename T> Shared<T>& shared()
+{
+    static Shared<T> instance;
+    return instance;
+}
+
+template <typename T> void set_up(benchmark::State& state)
+{
+    if (state.thread_index() != 0)
+    {
+        return;
+    }
+
+    auto& s  = shared<T>();
+    s.target = std::make_unique<T>();
+    s.names  = make_names(static_cast<std::size_t>(state.range(0)));
+    s.keys.clear();
+    for (const auto& name : s.names)
+    {
+        s.keys.push_back(NameTable::hash_of(name));
+    }
+}
+
+template <typename T> void tear_down(benchmark::State& state)
+{
+    if (state.thread_index() == 0)
+    {
+        shared<T>() = {};
+    }
+}
+
+// every thread starts at its own offset, so threads contend on shards rather than on one key
+std::size_t start_of(const benchmark::State& state, std::size_t count)
+{
+    return static_cast<std::size_t>(state.thread_index()) * count /
+           static_cast<std::size_t>(state.threads());
+}
+
+// the shared window alone: shard lock, index probe, update
+template <typename M> void BM_BucketAddMetric(benchmark::State& state)
+{
+    using Window = Bucket<DEFAULT_SHARDS_PER_BUCKET>;
+    set_up<Window>(state);
+
+    auto&       s = shared<Window>();
+    std::size_t n = static_cast<std::size_t>(state.range(0));
+    std::size_t i = start_of(state, n);
+    for (auto _ : state)
+    {
+        s.target->template add_metric<M>(s.keys[i], s.names[i], i);
+        i = i + 1 == n ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+
+    tear_down<Window>(state);
+}
+
+// a sample straight into the ring: name interning, the epoch announce and the shard update
+void BM_RingStore(benchmark::State& state)
+{
+    set_up<MetricRing>(state);
+
+    auto&       s = shared<MetricRing>();
+    std::size_t n = static_cast<std::size_t>(state.range(0));
+    std::size_t i = start_of(state, n);
+    for (auto _ : state)
+    {
+        s.target->store<Counter>(s.names[i], 1);
+        i = i + 1 == n ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+
+    tear_down<MetricRing>(state);
+}
+
+// the path workers take: MERGE_BATCH samples into a thread's LocalTable, then one merge
+void BM_RingMerge(benchmark::State& state)
+{
+    set_up<MetricRing>(state);
+
+    auto&       s = shared<MetricRing>();
+    std::size_t n = static_cast<std::size_t>(state.range(0));
+    std::size_t i = start_of(state, n);
+    // the ring only exists for every thread once the loop's start barrier has passed
+    std::optional<LocalTable> local;
+    for (auto _ : state)
+    {
+        if (!local.has_value())
+        {
+            state.PauseTiming();
+            local.emplace(s.target->names());
+            state.ResumeTiming();
+        }
+
+        for (std::size_t sample = 0; sample < MERGE_BATCH; sample++)
+        {
+            local->add<Counter>(s.names[i], 1);
+            i = i + 1 == n ? 0 : i + 1;
+        }
+        s.target->merge(*local);
+        local->clear();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * MERGE_BATCH));
+
+    tear_down<MetricRing>(state);
+}
+// rotate() alone, with window after window of samples for range(0) names of which range(1) per
+// mille are new and as many stop: the per request id churn the name expiry is there for
+void BM_RingRotate(benchmark::State& state)
+{
+    std::size_t n     = static_cast<std::size_t>(state.range(0));
+    std::size_t churn = n * static_cast<std::size_t>(state.range(1)) / 1000;
+
+    MetricRing  ring;
+    std::size_t first = 0; // the window's names are metric_name(first) to metric_name(first + n)
+    auto        fill  = [&ring, &first, n, churn]()
+    {
+        LocalTable local(ring.names());
+        for (std::size_t i = first; i < first + n; i++)
+        {
+            local.add<Counter>(metric_name(i), 1);
+        }
+        ring.merge(local);
+        first += churn;
+    };
+
+    // past the first expiry sweep, so names expire on every rotation
+    for (std::size_t window = 0; window < MetricRing::NAME_EXPIRY + NameTable::EXPIRE_SWEEP;
+         window++)
+    {
+        fill();
+        ring.rotate();
+    }
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        fill();
+        state.ResumeTiming();
+
+        ring.rotate();
+    }
+    state.counters["names"] = static_cast<double>(ring.names().size());
+}
+} // namespace
+
+// key cardinality from a small service to one with a per endpoint explosion, 1 to 4 threads
+// sharing the window
+BENCHMARK_TEMPLATE(BM_BucketAddMetric, Counter)
+    ->Arg(1 << 10)
+    ->Arg(1 << 16)
+    ->Arg(1 << 20)
+    ->ThreadRange(1, 4)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_BucketAddMetric, Timer)
+    ->Arg(1 << 10)
+    ->Arg(1 << 16)
+    ->ThreadRange(1, 4)
+    ->UseRealTime();
+BENCHMARK(BM_RingStore)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20)->ThreadRange(1, 4)->UseRealTime();
+BENCHMARK(BM_RingMerge)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20)->ThreadRange(1, 4)->UseRealTime();
+// 1M live names with no churn, 1% and 10% of them replaced every window
+BENCHMARK(BM_RingRotate)
+    ->Args({1 << 20, 0})
+    ->Args({1 << 20, 10})
+    ->Args({1 << 20, 100})
+    ->Iterations(2 * NameTable::EXPIRE_SWEEP)
+    ->Unit(benchmark::kMillisecond);
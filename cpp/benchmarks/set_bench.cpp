@@ -0,0 +1,72 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <metrics.hpp>
+#include <random>
+#include <vector>
+
+using namespace metric_collector::aggregation;
+
+namespace
+{
+std::vector<uint64_t> make_members(std::size_t count)
+{
+    std::mt19937_64       rng(42);
+    std::vector<uint64_t> members(count);
+    for (auto& member : members)
+    {
+        member = rng();
+    }
+    return members;
+}
+
+// sparse while the set is small, dense past HyperLogLog::SPARSE_MAX members
+void BM_SetAdd(benchmark::State& state)
+{
+    auto members = make_members(static_cast<std::size_t>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        Set set;
+        for (auto member : members)
+        {
+            set.add(member);
+        }
+        benchmark::DoNotOptimize(set);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * members.size()));
+}
+
+void BM_SetMergeDense(benchmark::State& state)
+{
+    Set source;
+    for (auto member : make_members(1 << 16))
+    {
+        source.add(member);
+    }
+
+    Set target;
+    for (auto _ : state)
+    {
+        target.merge(source);
+    }
+    benchmark::DoNotOptimize(target);
+}
+
+void BM_SetCount(benchmark::State& state)
+{
+    Set set;
+    for (auto member : make_members(1 << 16))
+    {
+        set.add(member);
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(set.count());
+    }
+}
+} // namespace
+
+BENCHMARK(BM_SetAdd)->Arg(64)->Arg(512)->Arg(1 << 16);
+BENCHMARK(BM_SetMergeDense);
+BENCHMARK(BM_SetCount);
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <bucket.hpp>
+#include <cardinality_guard.hpp>
+#include <flat_map.hpp>
+#include <hash.hpp>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shard.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace metric_collector::aggregation;
+
+namespace
+{
+// The node based shard Shard replaced, kept as the baseline to compare against.
+class LegacyShard
+{
+  public:
+    template <MetricTypeConcept T> std::shared_ptr<MetricValue> store(uint64_t key)
+    {
+        std::lock_guard lock(mutex_);
+
+        auto it = metrics_.find(key);
+        if (it != metrics_.end())
+        {
+            if (!std::holds_alternative<T>(it->second->metric))
+            {
+                return nullptr;
+            }
+            return it->second;
+        }
+
+        auto ptr = std::make_shared<MetricValue>(std::in_place_type<T>);
+        metrics_.emplace(key, ptr);
+        return ptr;
+    }
+
+    [[nodiscard]] std::shared_ptr<MetricValue> get_metric(uint64_t key) const
+    {
+        std::lock_guard lock(mutex_);
+
+        auto it = metrics_.find(key);
+        if (it == metrics_.end())
+        {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    void clear()
+    {
+        std::lock_guard lock(mutex_);
+        metrics_.clear();
+    }
+
+  private:
+    std::unordered_map<uint64_t, std::shared_ptr<MetricValue>> metrics_;
+    mutable std::mutex                                         mutex_;
+};
+
+std::string make_name(std::size_t i)
+{
+    return "service.api.requests." + std::to_string(i) + ".count";
+}
+
+std::vector<uint64_t> make_keys(std::size_t count)
+{
+    std::vector<uint64_t> keys;
+    keys.reserve(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto name = make_name(i);
+        keys.push_back(hash_fnv1a(name.data(), name.size()));
+    }
+    return keys;
+}
+
+// random access order so lookups are not served by the prefetcher
+std::vector<uint64_t> shuffled(std::vector<uint64_t> keys)
+{
+    std::mt19937_64 rng(42);
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+void BM_LegacyShardInsert(benchmark::State& state)
+{
+    auto        keys = make_keys(static_cast<std::size_t>(state.range(0)));
+    LegacyShard shard;
+
+    for (auto _ : state)
+    {
+        for (auto key : keys)
+        {
+            shard.store<Counter>(key);
+        }
+        state.PauseTiming();
+        shard.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ShardInsert(benchmark::State& state)
+{
+    auto  keys = make_keys(static_cast<std::size_t>(state.range(0)));
+    Shard shard;
+
+    for (auto _ : state)
+    {
+        for (auto key : keys)
+        {
+            shard.store<Counter>(key, {}, [](Counter& counter) { counter.increment(); });
+        }
+        state.PauseTiming();
+        shard.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// The per shard storage Shard's columns replaced: one inline variant per slot, each sized for
+// the largest alternative whatever the metric's type.
+using LegacyBucket = std::array<FlatMap<MetricValue>, 64>;
+
+// bytes of table and column storage per counter once count keys are in a 64 shard bucket
+void BM_LegacyBytesPerMetric(benchmark::State& state)
+{
+    auto keys = make_keys(static_cast<std::size_t>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        auto bucket = std::make_unique<LegacyBucket>();
+        for (auto key : keys)
+        {
+            (*bucket)[key & 63].try_emplace(key, std::in_place_type<Counter>);
+        }
+
+        std::size_t bytes = 0;
+        for (const auto& shard : *bucket)
+        {
+            bytes += shard.memory_usage();
+        }
+        state.counters["bytes_per_metric"] = static_cast<double>(bytes) / keys.size();
+    }
+}
+
+void BM_BytesPerMetric(benchmark::State& state)
+{
+    auto keys = make_keys(static_cast<std::size_t>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        auto bucket = std::make_unique<Bucket<64>>();
+        for (auto key : keys)
+        {
+            bucket->add_metric<Counter>(key, {}, 1);
+        }
+        state.counters["bytes_per_metric"] =
+            static_cast<double>(bucket->memory_usage()) / keys.size();
+    }
+}
+
+// what a rotation pays to reset a window that held count keys, half timers and half sets
+void BM_BucketClear(benchmark::State& state)
+{
+    auto keys   = make_keys(static_cast<std::size_t>(state.range(0)));
+    auto bucket = std::make_unique<Bucket<64>>();
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            if (i % 2 == 0)
+            {
+                bucket->add_metric<Timer>(keys[i], {}, i);
+            }
+            else
+            {
+                bucket->add_metric<Set>(keys[i], {}, i);
+            }
+        }
+        state.ResumeTiming();
+
+        bucket->clear();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// BM_ShardInsert with every new key admitted by a guard holding a global and a few prefix
+// limits, all high enough to let everything in
+void BM_GuardedShardInsert(benchmark::State& state)
+{
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto keys  = make_keys(count);
+
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        names.push_back(make_name(i));
+    }
+
+    NameTable        table;
+    CardinalityGuard guard(CardinalityLimits{.max_names = count,
+                                             .prefixes  = {{"service.api.", count},
+                                                           {"service.web.", count},
+                                                           {"batch.", count}}},
+                           table);
+    CardinalityGuard::WindowCounts counts;
+    counts.resize(guard.slots());
+
+    Shard shard;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            shard.store<Counter>(
+                keys[i], names[i],
+                [&guard, &counts, &name = names[i]]() noexcept
+                { return guard.admit(name, counts) == CardinalityGuard::ADMITTED; },
+                [](Counter& counter) { counter.increment(); });
+        }
+        state.PauseTiming();
+        shard.clear();
+        counts.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_LegacyShardUpdate(benchmark::State& state)
+{
+    auto        keys = make_keys(static_cast<std::size_t>(state.range(0)));
+    LegacyShard shard;
+    for (auto key : keys)
+    {
+        shard.store<Counter>(key);
+    }
+    keys = shuffled(std::move(keys));
+
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        auto ptr = shard.store<Counter>(keys[i++ & (keys.size() - 1)]);
+        std::get<Counter>(ptr->metric).increment();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ShardUpdate(benchmark::State& state)
+{
+    auto  keys = make_keys(static_cast<std::size_t>(state.range(0)));
+    Shard shard;
+    for (auto key : keys)
+    {
+        shard.store<Counter>(key, {}, [](Counter&) {});
+    }
+    keys = shuffled(std::move(keys));
+
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        shard.store<Counter>(keys[i++ & (keys.size() - 1)], {},
+                             [](Counter& counter) { counter.increment(); });
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_LegacyShardGet(benchmark::State& state)
+{
+    auto        keys = make_keys(static_cast<std::size_t>(state.range(0)));
+    LegacyShard shard;
+    for (auto key : keys)
+    {
+        shard.store<Counter>(key);
+    }
+    keys = shuffled(std::move(keys));
+
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(shard.get_metric(keys[i++ & (keys.size() - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ShardGet(benchmark::State& state)
+{
+    auto  keys = make_keys(static_cast<std::size_t>(state.range(0)));
+    Shard shard;
+    for (auto key : keys)
+    {
+        shard.store<Counter>(key, {}, [](Counter&) {});
+    }
+    keys = shuffled(std::move(keys));
+
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(shard.get_metric(keys[i++ & (keys.size() - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+// key counts are powers of two so the access index can be masked
+BENCHMARK(BM_LegacyShardInsert)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ShardInsert)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_GuardedShardInsert)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+// refilling dominates the wall time, so the iterations are fixed
+BENCHMARK(BM_BucketClear)
+    ->Arg(1 << 16)
+    ->Arg(1 << 20)
+    ->Iterations(10)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_LegacyBytesPerMetric)->Arg(10'000'000)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BytesPerMetric)->Arg(10'000'000)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LegacyShardUpdate)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ShardUpdate)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_LegacyShardGet)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_ShardGet)->Arg(1 << 16)->Arg(1 << 20);
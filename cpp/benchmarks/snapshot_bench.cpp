@@ -0,0 +1,204 @@
+#include "fixtures.hpp"
+
+#include <benchmark/benchmark.h>
+#include <bucket_ring.hpp>
+#include <cstdio>
+#include <local_table.hpp>
+#include <memory>
+#include <snapshot_file.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace metric_collector::aggregation;
+using namespace metric_collector::benchmarks;
+
+namespace
+{
+constexpr std::size_t NUM_NAMES  = 1 << 16;
+constexpr std::size_t RANGE_SPAN = DEFAULT_RING_SIZE - 1;
+
+struct Fixture
+{
+    // windows sealed windows with the same names, at least one so there is a snapshot
+    explicit Fixture(std::size_t windows = 1) : names(metric_names(NUM_NAMES))
+    {
+        views.assign(names.begin(), names.end());
+
+        LocalTable local(ring->names());
+        for (std::size_t window = 0; window < windows; window++)
+        {
+            for (std::size_t i = 0; i < NUM_NAMES; i++)
+            {
+                local.add<Counter>(names[i], i);
+            }
+            ring->merge(local);
+            local.clear();
+            ring->rotate();
+        }
+    }
+
+    std::unique_ptr<MetricRing>   ring =
+        std::make_unique<MetricRing>(CardinalityLimits{}, std::vector<std::size_t>{RANGE_SPAN});
+    std::vector<std::string>      names;
+    std::vector<std::string_view> views;
+};
+
+// the locked path: NameTable stripe lock, then a shard lock per window walked
+void BM_QueryLocked(benchmark::State& state)
+{
+    Fixture     fixture;
+    std::size_t i = 0;
+
+    for (auto _ : state)
+    {
+        auto value = fixture.ring->get_metric<Counter>(fixture.names[i++ % NUM_NAMES]);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+void BM_QuerySnapshot(benchmark::State& state)
+{
+    Fixture     fixture;
+    auto        snapshot = fixture.ring->snapshot();
+    std::size_t i        = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(snapshot->find(fixture.views[i++ % NUM_NAMES]));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// one snapshot acquisition amortised over a batch of keys
+void BM_QuerySnapshotBulk(benchmark::State& state)
+{
+    Fixture fixture;
+    auto    batch = static_cast<std::size_t>(state.range(0));
+
+    std::vector<const MetricValue*> out(batch);
+    std::size_t                     offset = 0;
+
+    for (auto _ : state)
+    {
+        auto snapshot = fixture.ring->snapshot();
+        snapshot->find_many(std::span(fixture.views).subspan(offset, batch), out);
+        benchmark::DoNotOptimize(out.data());
+        offset = (offset + batch) % (NUM_NAMES - batch);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * batch));
+}
+
+// counter sum over every sealed window from the incrementally maintained range
+void BM_RangeQuery(benchmark::State& state)
+{
+    Fixture     fixture(RANGE_SPAN);
+    auto        range = fixture.ring->range(RANGE_SPAN);
+    std::size_t i     = 0;
+
+    for (auto _ : state)
+    {
+        const auto* value = range->find(fixture.views[i++ % NUM_NAMES]);
+        benchmark::DoNotOptimize(std::get<Counter>(value->metric).get());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// the same sum by visiting each window's snapshot, what a range costs without the running ranges
+void BM_RangeQueryWalk(benchmark::State& state)
+{
+    Fixture fixture(RANGE_SPAN);
+
+    std::vector<std::shared_ptr<const Snapshot>> windows;
+    for (std::size_t age = 0; age < RANGE_SPAN; age++)
+    {
+        windows.push_back(fixture.ring->snapshot(age));
+    }
+
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        uint64_t sum = 0;
+        for (const auto& window : windows)
+        {
+            if (const auto* value = window->find(fixture.views[i % NUM_NAMES]))
+            {
+                sum += std::get<Counter>(value->metric).get();
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+        i++;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+constexpr char SNAPSHOT_PATH[] = "/dev/shm/metric_collector_bench.snapshot";
+
+// Export and reopen a window holding every metric type; tests/snapshot_file_test.cpp checks
+// what the file holds.
+void BM_SnapshotFileRoundTrip(benchmark::State& state)
+{
+    auto       ring = std::make_unique<MetricRing>();
+    LocalTable local(ring->names());
+    for (std::size_t i = 0; i < NUM_NAMES / 16; i++)
+    {
+        auto suffix = std::to_string(i);
+        local.add<Counter>("roundtrip.counter" + suffix, i);
+        local.add<Gauge>("roundtrip.gauge" + suffix, i);
+        local.add<Timer>("roundtrip.timer" + suffix, i);
+        local.add<Timer>("roundtrip.timer" + suffix, 2 * i + 1);
+        local.add<Set>("roundtrip.set" + suffix, i);
+        local.add<Set>("roundtrip.set" + suffix, i + 1);
+    }
+    ring->merge(local);
+    ring->rotate();
+    auto snapshot = ring->snapshot();
+
+    SnapshotFileWriter writer(SNAPSHOT_PATH);
+    for (auto _ : state)
+    {
+        if (!writer.write(*snapshot))
+        {
+            state.SkipWithError("cannot write the snapshot file");
+            break;
+        }
+        SnapshotFileReader reader(SNAPSHOT_PATH);
+        benchmark::DoNotOptimize(reader.size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * snapshot->size()));
+    std::remove(SNAPSHOT_PATH);
+}
+
+// what sealing costs on top of the handoff: the window copy and the range advanced by it, then
+// the range snapshot its first reader builds
+void BM_RotateWithSnapshot(benchmark::State& state)
+{
+    Fixture    fixture(RANGE_SPAN);
+    LocalTable local(fixture.ring->names());
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        for (const auto& name : fixture.names)
+        {
+            local.add<Counter>(name, 1);
+        }
+        fixture.ring->merge(local);
+        local.clear();
+        state.ResumeTiming();
+
+        fixture.ring->rotate();
+        benchmark::DoNotOptimize(fixture.ring->range(RANGE_SPAN));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NUM_NAMES));
+}
+} // namespace
+
+BENCHMARK(BM_QueryLocked);
+BENCHMARK(BM_QuerySnapshot);
+BENCHMARK(BM_QuerySnapshotBulk)->Arg(64)->Arg(1024);
+BENCHMARK(BM_RangeQuery);
+BENCHMARK(BM_RangeQueryWalk);
+BENCHMARK(BM_RotateWithSnapshot)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SnapshotFileRoundTrip)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <limits>
+#include <metrics.hpp>
+#include <random>
+#include <vector>
+
+using namespace metric_collector::aggregation;
+
+namespace
+{
+// The atomic count/sum/min/max Timer the histogram backed one replaced, kept as the baseline.
+class LegacyTimer
+{
+  public:
+    void record(uint64_t value) noexcept
+    {
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t curr = min_.load(std::memory_order_relaxed);
+        while (value < curr && !min_.compare_exchange_weak(curr, value, std::memory_order_relaxed))
+        {
+        }
+
+        curr = max_.load(std::memory_order_relaxed);
+        while (value > curr && !max_.compare_exchange_weak(curr, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    [[nodiscard]] auto count() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> min_{std::numeric_limits<uint64_t>::max()};
+    std::atomic<uint64_t> max_{std::numeric_limits<uint64_t>::min()};
+};
+
+// latencies spread over several powers of two, like request timings in microseconds
+std::vector<uint64_t> make_samples(std::size_t count)
+{
+    std::mt19937_64                     rng(42);
+    std::lognormal_distribution<double> dist(8.0, 1.5);
+    std::vector<uint64_t>               samples(count);
+    for (auto& sample : samples)
+    {
+        sample = static_cast<uint64_t>(dist(rng));
+    }
+    return samples;
+}
+
+void BM_LegacyTimerRecord(benchmark::State& state)
+{
+    auto        samples = make_samples(4096);
+    LegacyTimer timer;
+
+    for (auto _ : state)
+    {
+        for (auto sample : samples)
+        {
+            timer.record(sample);
+        }
+    }
+    benchmark::DoNotOptimize(timer.count());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * samples.size()));
+}
+
+void BM_TimerRecord(benchmark::State& state)
+{
+    auto  samples = make_samples(4096);
+    Timer timer;
+
+    for (auto _ : state)
+    {
+        for (auto sample : samples)
+        {
+            timer.record(sample);
+        }
+    }
+    benchmark::DoNotOptimize(timer.count());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * samples.size()));
+}
+
+// what a worker flush or a window roll up pays per timer key
+void BM_TimerMerge(benchmark::State& state)
+{
+    Timer source;
+    for (auto sample : make_samples(4096))
+    {
+        source.record(sample);
+    }
+
+    Timer target;
+    for (auto _ : state)
+    {
+        target.merge(source);
+    }
+    benchmark::DoNotOptimize(target.count());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+void BM_TimerPercentile(benchmark::State& state)
+{
+    Timer timer;
+    for (auto sample : make_samples(4096))
+    {
+        timer.record(sample);
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(timer.percentile(0.5));
+        benchmark::DoNotOptimize(timer.percentile(0.99));
+        benchmark::DoNotOptimize(timer.percentile(0.999));
+    }
+}
+} // namespace
+
+BENCHMARK(BM_LegacyTimerRecord);
+BENCHMARK(BM_TimerRecord);
+BENCHMARK(BM_TimerMerge);
+BENCHMARK(BM_TimerPercentile);
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <bucket_ring.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <listener.hpp>
+#include <memory>
+#include <packet_pool.hpp>
+#include <self_stats.hpp>
+#include <spsc_queue.hpp>
+#include <thread>
+#include <vector>
+#include <wakeup.hpp>
+#include <worker.hpp>
+
+using namespace metric_collector::ingestion;
+using namespace metric_collector::aggregation;
+
+namespace
+{
+constexpr char PAYLOAD[] = "wakeup.probe:1|c";
+
+double cpu_seconds(clockid_t clock)
+{
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+// One datagram every gap microseconds into an otherwise idle worker: the time from the push
+// until the worker has parsed it, and the cpu the worker burns meanwhile. With a zero gap the
+// worker never gets to park, the longer gaps measure the wakeup from a parked worker.
+void BM_WorkerWakeup(benchmark::State& state)
+{
+    auto gap = std::chrono::microseconds(state.range(0));
+
+    auto       ring = std::make_unique<MetricRing>();
+    PacketPool pool(64, sizeof(PAYLOAD));
+    Worker     worker(*ring);
+    worker.start("bench_worker");
+
+    std::vector<double> latencies;
+    auto                wall_start = std::chrono::steady_clock::now();
+    auto                cpu_start  = cpu_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    auto                own_start  = cpu_seconds(CLOCK_THREAD_CPUTIME_ID);
+    for (auto _ : state)
+    {
+        auto index = pool.acquire();
+        std::memcpy(pool.buffer(index).data(), PAYLOAD, sizeof(PAYLOAD) - 1);
+        Packet packet{&pool, index, static_cast<uint32_t>(sizeof(PAYLOAD) - 1), 0};
+
+        auto before = SelfStats::total(SelfCounter::LinesParsed);
+        auto start  = std::chrono::steady_clock::now();
+        worker.queue().push(packet, [](Packet&& dropped) { dropped.release(); });
+        worker.wake();
+        while (SelfStats::total(SelfCounter::LinesParsed) == before)
+        {
+            std::this_thread::yield();
+        }
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+                .count());
+
+        if (gap.count() != 0)
+        {
+            std::this_thread::sleep_for(gap);
+        }
+    }
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start);
+    auto own  = cpu_seconds(CLOCK_THREAD_CPUTIME_ID) - own_start;
+    auto cpu  = cpu_seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu_start - own;
+    worker.stop();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&latencies](double q)
+    { return latencies[static_cast<std::size_t>(q * static_cast<double>(latencies.size() - 1))]; };
+    state.counters["p50_us"]     = at(0.50);
+    state.counters["p99_us"]     = at(0.99);
+    state.counters["worker_cpu"] = cpu / wall.count(); // cores kept busy by the worker
+}
+// What the producer pays per packet to keep a busy consumer's wakeup honest: a push and pop on
+// the same thread, with Wakeup::notify() after every batch pushes. A batch of 1 is the old
+// notify per push, BATCH_SIZE what the listener does per recvmmsg batch now.
+void BM_PushNotify(benchmark::State& state)
+{
+    auto batch = static_cast<std::size_t>(state.range(0));
+
+    SpscQueue<uint32_t, 1024> queue;
+    Wakeup                    wakeup;
+    std::vector<uint32_t>     out(batch);
+    uint32_t                  item = 0;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < batch; i++)
+        {
+            queue.push(item++, [](uint32_t&&) {});
+        }
+        benchmark::DoNotOptimize(wakeup.notify());
+        benchmark::DoNotOptimize(queue.pop_n(out));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * batch));
+}
+} // namespace
+
+BENCHMARK(BM_PushNotify)->ArgName("batch")->Arg(1)->Arg(BATCH_SIZE);
+
+BENCHMARK(BM_WorkerWakeup)
+    ->ArgName("gap_us")
+    ->Arg(0)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->UseRealTime();
@@ -1,10 +1,15 @@
 #ifndef METRIC_COLLECTOR_AGGREGATION_BUCKET_HPP
 #define METRIC_COLLECTOR_AGGREGATION_BUCKET_HPP
 
+#include "cardinality_guard.hpp"
+#include "local_table.hpp"
+#include "self_stats.hpp"
 #include "shard.hpp"
 
 #include <array>
 #include <cstdint>
+#include <optional>
+#include <string_view>
 
 namespace metric_collector::aggregation
 {
@@ -16,43 +21,108 @@ template <std::size_t NUM_SHARDS> class Bucket
 
     Bucket() = default;
 
-    template <MetricTypeConcept T> void add_metric(uint64_t key, uint64_t delta)
+    // names over a limit of guard are rejected or folded from now on; guard must outlive the
+    // bucket and is set before the first write
+    void set_guard(CardinalityGuard* guard)
     {
-        std::size_t idx = key & (NUM_SHARDS - 1);
-        auto        ptr = shards_[idx].template store<T>(key);
+        guard_ = guard;
+        counts_.resize(guard->slots());
+    }
 
-        if (ptr == nullptr)
-        {
-            return; // type mismatch ignore
-        }
+    // names admitted into this window so far, per limit
+    [[nodiscard]] const CardinalityGuard::WindowCounts& cardinality_counts() const noexcept
+    {
+        return counts_;
+    }
 
-        if constexpr (std::same_as<T, Counter>)
-        {
-            std::get<Counter>(ptr->metric).increment(delta);
-        }
-        else if constexpr (std::same_as<T, Gauge>)
-        {
-            std::get<Gauge>(ptr->metric).set(delta);
-        }
-        else if constexpr (std::same_as<T, Timer>)
-        {
-            std::get<Timer>(ptr->metric).record(delta);
-        }
+    template <MetricTypeConcept T>
+    void add_metric(uint64_t key, std::string_view name, uint64_t delta)
+    {
+        store<T>(key, name, 1,
+                 [delta](T& metric)
+                 {
+                     if constexpr (std::same_as<T, Counter>)
+                     {
+                         metric.increment(delta);
+                     }
+                     else if constexpr (std::same_as<T, Gauge>)
+                     {
+                         metric.set(delta);
+                     }
+                     else if constexpr (std::same_as<T, Timer>)
+                     {
+                         metric.record(delta);
+                     }
+                     else if constexpr (std::same_as<T, Set>)
+                     {
+                         metric.add(delta);
+                     }
+                 });
+    }
+
+    // one shard lock per key instead of one per sample
+    void merge(const LocalTable& table)
+    {
+        table.for_each(
+            [this](uint64_t key, std::string_view name, const LocalVariant& local,
+                   uint64_t samples)
+            {
+                std::visit([this, key, name, samples](const auto& value)
+                           { merge_metric(key, name, samples, value); },
+                           local);
+            });
+
+        // samples of names the gate refused, after the one it counted itself
+        table.for_each_refused(
+            [this](std::size_t limit, bool folded, uint64_t samples)
+            {
+                if (folded)
+                {
+                    guard_->count_folded(limit, samples);
+                }
+                else
+                {
+                    guard_->count_rejected(limit, samples);
+                }
+            });
     }
 
     template <MetricTypeConcept T>
-    [[nodiscard]] std::shared_ptr<MetricValue> get_metric(uint64_t key) const
+    [[nodiscard]] std::optional<MetricValue> get_metric(uint64_t key) const
     {
         std::size_t idx   = key & (NUM_SHARDS - 1);
         auto&       shard = shards_[idx];
 
-        auto ptr = shard.get_metric(key);
-        if (ptr == nullptr)
+        return shard.get_metric(key);
+    }
+
+    // func(key, name, metric) with the typed metric, see Shard::for_each
+    template <typename F> void for_each(F&& func) const
+    {
+        for (const auto& shard : shards_)
         {
-            return nullptr;
+            shard.for_each(func);
         }
+    }
 
-        return ptr;
+    [[nodiscard]] std::size_t size() const
+    {
+        std::size_t total = 0;
+        for (const auto& shard : shards_)
+        {
+            total += shard.size();
+        }
+        return total;
+    }
+
+    [[nodiscard]] std::size_t memory_usage() const
+    {
+        std::size_t total = 0;
+        for (const auto& shard : shards_)
+        {
+            total += shard.memory_usage();
+        }
+        return total;
     }
 
     void clear()
@@ -61,10 +131,89 @@ template <std::size_t NUM_SHARDS> class Bucket
         {
             shard.clear();
         }
+        counts_.reset();
     }
 
   private:
-    std::array<Shard, NUM_SHARDS> shards_;
+    template <typename Local>
+    void merge_metric(uint64_t key, std::string_view name, uint64_t samples, const Local& local)
+    {
+        using T = typename Local::shared_type;
+
+        store<T>(key, name, samples,
+                 [&local](T& metric)
+                 {
+                     if constexpr (std::same_as<T, Counter>)
+                     {
+                         metric.increment(local.get());
+                     }
+                     else if constexpr (std::same_as<T, Gauge>)
+                     {
+                         metric.set(local.get());
+                     }
+                     else if constexpr (std::same_as<T, Timer> || std::same_as<T, Set>)
+                     {
+                         metric.merge(local.get());
+                     }
+                 });
+    }
+
+    // a merged LocalTable entry counts once however many samples it holds
+    static void count_type_mismatch() noexcept
+    {
+        SelfStats::add(SelfCounter::WindowTypeMismatches);
+    }
+
+    // a type mismatch is counted and dropped, a name refused by the guard is dropped or folded
+    // into the overflow metric of the limit it hit; the guard counts the samples func carries
+    template <MetricTypeConcept T, typename F>
+    void store(uint64_t key, std::string_view name, uint64_t samples, const F& func)
+    {
+        Shard& shard = shards_[key & (NUM_SHARDS - 1)];
+        if (guard_ == nullptr)
+        {
+            if (!shard.template store<T>(key, name, func))
+            {
+                count_type_mismatch();
+            }
+            return;
+        }
+
+        std::size_t refused_by = CardinalityGuard::ADMITTED;
+        auto        admit      = [this, key, name, &refused_by]() noexcept
+        {
+            if (guard_->is_overflow(key))
+            {
+                return true;
+            }
+            refused_by = guard_->admit(name, counts_);
+            return refused_by == CardinalityGuard::ADMITTED;
+        };
+        auto result = shard.template store<T>(key, name, admit, func);
+        if (result == StoreResult::TypeMismatch)
+        {
+            count_type_mismatch();
+        }
+        if (result != StoreResult::Refused)
+        {
+            return;
+        }
+
+        if (guard_->action() == OverflowAction::Reject)
+        {
+            guard_->count_rejected(refused_by, samples);
+            return;
+        }
+
+        auto overflow = guard_->template overflow<T>(refused_by);
+        shards_[overflow.key & (NUM_SHARDS - 1)].template store<T>(overflow.key, overflow.name,
+                                                                   func);
+        guard_->count_folded(refused_by, samples);
+    }
+
+    std::array<Shard, NUM_SHARDS>  shards_;
+    CardinalityGuard*              guard_{nullptr};
+    CardinalityGuard::WindowCounts counts_;
 };
 } // namespace metric_collector::aggregation
 
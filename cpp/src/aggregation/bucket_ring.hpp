@@ -1,60 +1,528 @@
 #ifndef METRIC_COLLECTOR_AGGREGATION_BUCKET_RING_HPP
 #define METRIC_COLLECTOR_AGGREGATION_BUCKET_RING_HPP
 
-#include "hash.hpp"
+#include "cardinality_guard.hpp"
+#include "name_table.hpp"
+#include "range_aggregate.hpp"
+#include "snapshot.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <bucket.hpp>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace metric_collector::aggregation
 {
+// Timings of the last and slowest rotation, see BucketRing::rotate.
+struct RotationStats
+{
+    uint64_t rotations{0};
+    uint64_t last_rotation_ns{0};
+    uint64_t max_rotation_ns{0};
+    // time spent waiting for writers still inside the window being sealed
+    uint64_t last_drain_ns{0};
+    uint64_t max_drain_ns{0};
+    // writers that raced a rotation and moved on to the new window
+    uint64_t writer_retries{0};
+    // time spent waiting for threads to merge their local tables before the epoch moved on
+    uint64_t last_flush_ns{0};
+    uint64_t max_flush_ns{0};
+    // rotations that stopped waiting after FLUSH_TIMEOUT, some samples land a window late
+    uint64_t flush_timeouts{0};
+};
+
+// A buffering thread's side of the flush handshake in BucketRing::rotate. The thread raises
+// pending while its local table holds samples not merged yet, and once it has merged for a
+// flush request it stores that request in acked.
+struct FlushTicket
+{
+    std::atomic<bool>     pending{false};
+    std::atomic<uint64_t> acked{0};
+};
+
+// Ring of time windows, the open one takes writes and the others are sealed and read only.
+// Rotation is an epoch handoff: writers announce themselves on the window they write to and
+// re-check the epoch, the rotator advances the epoch and then waits for the announced writers
+// of the closing window to leave. Writers never wait, one that raced a rotation just retries on
+// the new window, and once rotate() returns the closed window no longer changes.
+// Threads that buffer samples in a LocalTable attach a FlushTicket. Before the epoch moves,
+// rotate() raises a flush request and waits, at most FLUSH_TIMEOUT, until every thread still
+// holding samples has merged them, so a window gets the samples that arrived while it was open.
+// Queries should read immutable Snapshots of the sealed windows, get_metric() shares the shard
+// locks with the writers. A window's snapshot is built on first request and cached; ranges over
+// the last k sealed windows are configured up front and kept as RangeAggregates, which add the
+// window just sealed and take back the one leaving at every rotation, so their cost does not grow
+// with k and k is not bounded by the ring. With ranges the rotation builds the window's snapshot
+// itself and keeps the last k + 1 of them; a range's own snapshot is again built on request.
 template <std::size_t RING_SIZE, std::size_t SHARDS_PER_BUCKET> class BucketRing
 {
   public:
-    static_assert(RING_SIZE > 0, "ring size must be positive number");
+    static_assert(RING_SIZE > 1, "ring needs an open and at least one sealed window");
     static_assert(SHARDS_PER_BUCKET > 0, "Num of shards must be positive number");
     static_assert((SHARDS_PER_BUCKET & (SHARDS_PER_BUCKET - 1)) == 0,
                   "Num of shards must be power of two");
 
+    // how long a rotation waits for buffering threads to merge, they answer from their loop
+    static constexpr auto FLUSH_TIMEOUT = std::chrono::milliseconds(250);
+
+    // rotations a name stays interned after its last sample: every window it can be in is
+    // reused by then, with two to spare for a LocalTable merged after a flush timed out
+    static constexpr std::size_t NAME_EXPIRY = RING_SIZE + 2;
+
     BucketRing() = default;
 
+    // the limits apply to every window separately; range(k) serves each k in range_spans, a
+    // span of 1 is the last window's snapshot
+    explicit BucketRing(CardinalityLimits limits, std::vector<std::size_t> range_spans = {})
+        : guard_(live_names(std::move(limits)), names_)
+    {
+        if (guard_.enabled())
+        {
+            for (auto& window : windows_)
+            {
+                window.bucket.set_guard(&guard_);
+            }
+            names_.set_gate(&gate_);
+        }
+
+        for (std::size_t span : range_spans)
+        {
+            if (span == 0)
+            {
+                std::cerr << "---> a range must cover at least one window\n";
+                throw std::runtime_error("range span of 0");
+            }
+            if (span == 1 || find_range(span) != nullptr)
+            {
+                continue;
+            }
+            ranges_.push_back(std::make_unique<Range>(span));
+            max_span_ = std::max(max_span_, span);
+        }
+    }
+
+    // seal the open window and open the oldest one, from a single scheduling thread
     void rotate()
     {
-        current_bucket_ = (current_bucket_ + 1) % RING_SIZE;
-        buckets_[current_bucket_].clear();
+        std::lock_guard lock(rotate_mutex_);
+        auto            start = Clock::now();
+
+        flush();
+        auto flushed = Clock::now();
+
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+        Window&  next  = windows_[(epoch + 1) % RING_SIZE];
+
+        {
+            // a snapshot being built on request may still read it
+            std::lock_guard seal_lock(seal_mutex_);
+
+            // nobody can be writing to it, it was sealed RING_SIZE - 1 rotations ago
+            next.bucket.clear();
+
+            // pairs with the announce and re-check in write()
+            epoch_.store(epoch + 1, std::memory_order_seq_cst);
+        }
+
+        auto    drain_start = Clock::now();
+        Window& closed      = windows_[epoch % RING_SIZE];
+        while (closed.writers.load(std::memory_order_seq_cst) != 0)
+        {
+            std::this_thread::yield();
+        }
+        auto drained = Clock::now();
+
+        seal(epoch);
+        sealed_.store(epoch + 1, std::memory_order_release);
+
+        // snapshots and ranges copy their names, only the windows and LocalTables point here
+        names_.expire(epoch + 1, NAME_EXPIRY);
+        auto end = Clock::now();
+
+        record(last_flush_ns_, max_flush_ns_, flushed - start);
+        record(last_drain_ns_, max_drain_ns_, drained - drain_start);
+        record(last_rotation_ns_, max_rotation_ns_, end - start);
+        rotations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // ticket's thread merges whenever flush_requested() differs from its ack; it must be
+    // detached before the ticket goes away
+    void attach(FlushTicket& ticket)
+    {
+        std::lock_guard lock(tickets_mutex_);
+        ticket.acked.store(flush_requested(), std::memory_order_relaxed);
+        tickets_.push_back(&ticket);
+    }
+
+    void detach(FlushTicket& ticket)
+    {
+        std::lock_guard lock(tickets_mutex_);
+        std::erase(tickets_, &ticket);
+    }
+
+    // the latest flush request, read by the attached threads on every loop iteration
+    [[nodiscard]] uint64_t flush_requested() const noexcept
+    {
+        return flush_requests_.load(std::memory_order_relaxed);
     }
 
     template <MetricTypeConcept T> void store(std::string_view name, uint64_t delta)
     {
-        uint64_t key = hash_fnv1a(name.data(), name.length());
-        buckets_[current_bucket_].template add_metric<T>(key, delta);
+        auto interned = names_.intern_checked(name, NameTable::hash_of(name), metric_index<T>());
+        if (!interned.has_value())
+        {
+            return; // refused by the cardinality guard, and counted there
+        }
+        write([interned, delta](auto& bucket)
+              { bucket.template add_metric<T>(interned->key, interned->name, delta); });
     }
 
+    // flush a worker's local aggregates into the open window
+    void merge(const LocalTable& table)
+    {
+        write([&table](auto& bucket) { bucket.merge(table); });
+    }
+
+    // newest value first: the open window, then the sealed ones
     template <MetricTypeConcept T>
-    [[nodiscard]] std::shared_ptr<MetricValue> get_metric(std::string_view name) const
+    [[nodiscard]] std::optional<MetricValue> get_metric(std::string_view name) const
     {
-        uint64_t key = hash_fnv1a(name.data(), name.length());
+        auto key = names_.find(name);
+        if (!key.has_value())
+        {
+            return std::nullopt;
+        }
 
+        uint64_t epoch = epoch_.load(std::memory_order_acquire);
         for (std::size_t offset = 0; offset < RING_SIZE; ++offset)
         {
-            // Walk backwards from current_bucket_
-            std::size_t idx = (current_bucket_ + RING_SIZE - offset) % RING_SIZE;
+            // Walk backwards from the open window
+            std::size_t idx = (epoch + RING_SIZE - offset) % RING_SIZE;
 
-            auto ptr = buckets_[idx].template get_metric<T>(key);
-            if (ptr != nullptr)
+            auto value = windows_[idx].bucket.template get_metric<T>(*key);
+            if (value.has_value())
             {
-                return ptr;
+                return value;
             }
         }
 
-        return nullptr;
+        return std::nullopt;
+    }
+
+    // the most recently sealed window only, nullopt before the first rotation; stable until
+    // RING_SIZE - 1 further rotations reuse the window
+    template <MetricTypeConcept T>
+    [[nodiscard]] std::optional<MetricValue> get_sealed_metric(std::string_view name) const
+    {
+        uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        auto     key   = names_.find(name);
+        if (epoch == 0 || !key.has_value())
+        {
+            return std::nullopt;
+        }
+
+        return windows_[(epoch - 1) % RING_SIZE].bucket.template get_metric<T>(*key);
+    }
+
+    // the sealed window age rotations back (0 = the last one sealed), nullptr if that window was
+    // never sealed or has been reused since. The first request builds it under the shard locks,
+    // later ones share the copy without taking any lock
+    [[nodiscard]] std::shared_ptr<const Snapshot> snapshot(std::size_t age = 0) const
+    {
+        uint64_t sealed = sealed_.load(std::memory_order_acquire);
+        if (age + 1 > sealed || age + 1 >= RING_SIZE)
+        {
+            return nullptr;
+        }
+
+        uint64_t window   = sealed - 1 - age;
+        auto&    cached   = snapshots_[window % RING_SIZE];
+        auto     snapshot = cached.load(std::memory_order_acquire);
+        if (snapshot != nullptr && snapshot->epoch() == window)
+        {
+            return snapshot;
+        }
+
+        std::lock_guard lock(seal_mutex_);
+        snapshot = cached.load(std::memory_order_relaxed);
+        if (snapshot != nullptr && snapshot->epoch() == window)
+        {
+            return snapshot; // built by another reader meanwhile
+        }
+        if (epoch_.load(std::memory_order_relaxed) >= window + RING_SIZE)
+        {
+            return nullptr; // raced the rotations that reused the window
+        }
+
+        snapshot = build(window);
+        cached.store(snapshot, std::memory_order_release);
+        return snapshot;
+    }
+
+    // the last span sealed windows merged into one, for span 1 or a span the ring was built
+    // with; nullptr for other spans and until span windows have been sealed
+    [[nodiscard]] std::shared_ptr<const Snapshot> range(std::size_t span) const
+    {
+        if (span == 1)
+        {
+            return snapshot(0);
+        }
+
+        Range* range = find_range(span);
+        if (range == nullptr)
+        {
+            return nullptr;
+        }
+
+        auto snapshot = range->published.load(std::memory_order_acquire);
+        if (snapshot != nullptr)
+        {
+            return snapshot;
+        }
+
+        std::lock_guard lock(seal_mutex_);
+        snapshot = range->published.load(std::memory_order_relaxed);
+        if (snapshot == nullptr)
+        {
+            snapshot = range->aggregate.snapshot();
+            range->published.store(snapshot, std::memory_order_release);
+        }
+        return snapshot;
     }
 
+    // number of rotations so far
+    [[nodiscard]] uint64_t epoch() const noexcept { return epoch_.load(std::memory_order_acquire); }
+
+    [[nodiscard]] RotationStats rotation_stats() const noexcept
+    {
+        return {rotations_.load(std::memory_order_relaxed),
+                last_rotation_ns_.load(std::memory_order_relaxed),
+                max_rotation_ns_.load(std::memory_order_relaxed),
+                last_drain_ns_.load(std::memory_order_relaxed),
+                max_drain_ns_.load(std::memory_order_relaxed),
+                writer_retries_.load(std::memory_order_relaxed),
+                last_flush_ns_.load(std::memory_order_relaxed),
+                max_flush_ns_.load(std::memory_order_relaxed),
+                flush_timeouts_.load(std::memory_order_relaxed)};
+    }
+
+    // names rejected or folded per limit since start, empty without limits
+    [[nodiscard]] std::vector<CardinalityStats> cardinality_stats() const
+    {
+        return guard_.stats();
+    }
+
+    // names map to metric keys across every window, until NAME_EXPIRY rotations without a sample
+    // and the expiry sweep's next visit
+    [[nodiscard]] NameTable& names() noexcept { return names_; }
+
   private:
-    std::size_t                                      current_bucket_{0};
-    std::array<Bucket<SHARDS_PER_BUCKET>, RING_SIZE> buckets_;
+    using Clock = std::chrono::steady_clock;
+
+    // checks names new to the NameTable against the open window's counts
+    class Gate final : public NameTable::Gate
+    {
+      public:
+        explicit Gate(BucketRing& ring) : ring_(ring) {}
+
+        NameTable::Verdict check(std::string_view name, std::size_t interned,
+                                 std::size_t type) noexcept override
+        {
+            uint64_t    epoch  = ring_.epoch_.load(std::memory_order_acquire);
+            const auto& counts = ring_.windows_[epoch % RING_SIZE].bucket.cardinality_counts();
+
+            std::size_t slot = ring_.guard_.check(name, interned, counts);
+            if (slot == CardinalityGuard::ADMITTED)
+            {
+                return {};
+            }
+            return {false, ring_.guard_.refuse(slot, type), slot};
+        }
+
+      private:
+        BucketRing& ring_;
+    };
+
+    struct Range
+    {
+        explicit Range(std::size_t span) : aggregate(span) {}
+
+        RangeAggregate aggregate;
+        // built from aggregate on the first range() after a rotation
+        std::atomic<std::shared_ptr<const Snapshot>> published;
+    };
+
+    struct Window
+    {
+        Bucket<SHARDS_PER_BUCKET> bucket;
+        // writers currently inside bucket, on its own line so announcing does not hit the shards
+        alignas(64) std::atomic<uint32_t> writers{0};
+    };
+
+    template <typename F> void write(F&& func)
+    {
+        while (true)
+        {
+            uint64_t epoch  = epoch_.load(std::memory_order_acquire);
+            Window&  window = windows_[epoch % RING_SIZE];
+
+            // announce, then make sure the window did not close in between; with both sides
+            // seq_cst either this sees the new epoch or the rotator sees the announcement
+            window.writers.fetch_add(1, std::memory_order_seq_cst);
+            if (epoch_.load(std::memory_order_seq_cst) == epoch)
+            {
+                func(window.bucket);
+                window.writers.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+
+            window.writers.fetch_sub(1, std::memory_order_release);
+            writer_retries_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // asks the attached threads to merge and waits for those that held samples when asked;
+    // samples a thread buffers after that go to the next window
+    void flush()
+    {
+        std::lock_guard lock(tickets_mutex_);
+        uint64_t        request  = flush_requests_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        auto            deadline = Clock::now() + FLUSH_TIMEOUT;
+
+        for (const FlushTicket* ticket : tickets_)
+        {
+            while (ticket->pending.load(std::memory_order_seq_cst) &&
+                   ticket->acked.load(std::memory_order_acquire) < request)
+            {
+                if (Clock::now() >= deadline)
+                {
+                    flush_timeouts_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // copy of the sealed window of that epoch, the shards hold the names so no NameTable lock
+    std::shared_ptr<Snapshot> build(uint64_t window) const
+    {
+        const auto& bucket   = windows_[window % RING_SIZE].bucket;
+        auto        snapshot = std::make_shared<Snapshot>(window, bucket.size());
+        bucket.for_each([&snapshot](uint64_t key, std::string_view name, const auto& metric)
+                        { snapshot->insert(key, name, MetricValue(metric)); });
+        return snapshot;
+    }
+
+    // without ranges the window's snapshot waits for the first request, with them every window
+    // is copied once here and each range adds it and takes back the one leaving
+    void seal(uint64_t epoch)
+    {
+        if (ranges_.empty())
+        {
+            return;
+        }
+
+        std::lock_guard lock(seal_mutex_);
+        auto            snapshot = build(epoch);
+        snapshots_[epoch % RING_SIZE].store(snapshot, std::memory_order_release);
+
+        history_.push_back(std::move(snapshot));
+        if (history_.size() > max_span_ + 1)
+        {
+            history_.erase(history_.begin());
+        }
+        for (const auto& range : ranges_)
+        {
+            range->aggregate.advance(history_);
+            range->published.store(nullptr, std::memory_order_release);
+        }
+    }
+
+    // by default as many names may be interned as the windows a name can stay interned for can
+    // hold: the open window, the NAME_EXPIRY before it and the sweep that finds it expired
+    static CardinalityLimits live_names(CardinalityLimits limits)
+    {
+        if (limits.max_interned == 0)
+        {
+            limits.max_interned = limits.max_names * (NAME_EXPIRY + NameTable::EXPIRE_SWEEP + 1);
+        }
+        return limits;
+    }
+
+    [[nodiscard]] Range* find_range(std::size_t span) const noexcept
+    {
+        for (const auto& range : ranges_)
+        {
+            if (range->aggregate.span() == span)
+            {
+                return range.get();
+            }
+        }
+        return nullptr;
+    }
+
+    static void record(std::atomic<uint64_t>& last, std::atomic<uint64_t>& max,
+                       Clock::duration elapsed)
+    {
+        auto ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        last.store(ns, std::memory_order_relaxed);
+        if (ns > max.load(std::memory_order_relaxed))
+        {
+            max.store(ns, std::memory_order_relaxed); // only the rotator writes
+        }
+    }
+
+    NameTable                         names_;
+    CardinalityGuard                  guard_; // interns into names_
+    Gate                              gate_{*this};
+    std::array<Window, RING_SIZE>     windows_;
+    alignas(64) std::atomic<uint64_t> epoch_{0};
+    std::mutex                        rotate_mutex_;
+    alignas(64) std::atomic<uint64_t> flush_requests_{0};
+    std::mutex                        tickets_mutex_;
+    std::vector<FlushTicket*>         tickets_;
+
+    // windows below sealed_ are drained and no longer change
+    alignas(64) std::atomic<uint64_t> sealed_{0};
+    // serialises building snapshots with clearing a window and advancing the ranges
+    mutable std::mutex                seal_mutex_;
+    // indexed like windows_, by the epoch that sealed the window
+    mutable std::array<std::atomic<std::shared_ptr<const Snapshot>>, RING_SIZE> snapshots_;
+
+    std::vector<std::unique_ptr<Range>> ranges_;
+    std::size_t                         max_span_{0};
+    // the last max_span_ + 1 windows' snapshots, oldest first; only kept with ranges
+    std::vector<std::shared_ptr<const Snapshot>> history_;
+
+    std::atomic<uint64_t> rotations_{0};
+    std::atomic<uint64_t> last_rotation_ns_{0};
+    std::atomic<uint64_t> max_rotation_ns_{0};
+    std::atomic<uint64_t> last_drain_ns_{0};
+    std::atomic<uint64_t> max_drain_ns_{0};
+    std::atomic<uint64_t> writer_retries_{0};
+    std::atomic<uint64_t> last_flush_ns_{0};
+    std::atomic<uint64_t> max_flush_ns_{0};
+    std::atomic<uint64_t> flush_timeouts_{0};
 };
+
+constexpr std::size_t DEFAULT_RING_SIZE         = 6;
+constexpr std::size_t DEFAULT_SHARDS_PER_BUCKET = 64;
+
+using MetricRing = BucketRing<DEFAULT_RING_SIZE, DEFAULT_SHARDS_PER_BUCKET>;
 } // namespace metric_collector::aggregation
 
 #endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "cardinality_guard.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace metric_collector::aggregation
+{
+namespace
+{
+constexpr std::string_view TYPE_SUFFIXES[] = {"counter", "gauge", "timer", "set"};
+static_assert(std::size(TYPE_SUFFIXES) == std::variant_size_v<MetricVariant>);
+} // namespace
+
+CardinalityGuard::CardinalityGuard(CardinalityLimits limits, NameTable& names)
+    : action_(limits.action), max_interned_(limits.max_interned)
+{
+    if (limits.max_names == 0 && limits.prefixes.empty() && max_interned_ == 0)
+    {
+        return; // nothing to enforce, enabled() stays false
+    }
+
+    for (const auto& prefix : limits.prefixes)
+    {
+        if (prefix.max_names == 0)
+        {
+            std::cerr << "---> the limit of prefix '" << prefix.prefix << "' must be at least 1\n";
+            throw std::runtime_error("prefix limit of 0");
+        }
+    }
+
+    limits_ = std::vector<Limit>(limits.prefixes.size() + 1);
+    limits_[0].max_names = limits.max_names;
+    for (std::size_t i = 0; i < limits.prefixes.size(); i++)
+    {
+        limits_[i + 1].prefix    = std::move(limits.prefixes[i].prefix);
+        limits_[i + 1].max_names = limits.prefixes[i].max_names;
+    }
+
+    for (auto& limit : limits_)
+    {
+        for (std::size_t type = 0; type < NUM_TYPES; type++)
+        {
+            auto name = limit.prefix + "cardinality_overflow." + std::string(TYPE_SUFFIXES[type]);
+            limit.overflow[type] = names.intern(name);
+        }
+    }
+}
+
+std::size_t CardinalityGuard::admit(std::string_view name, WindowCounts& counts) noexcept
+{
+    // fetch_add hands out distinct tickets, so racing inserts never overshoot a limit
+    std::size_t global = limits_[0].max_names;
+    if (global != 0 && counts[0].fetch_add(1, std::memory_order_relaxed) >= global)
+    {
+        counts[0].fetch_sub(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    std::size_t slot = match(name);
+    if (slot != 0 &&
+        counts[slot].fetch_add(1, std::memory_order_relaxed) >= limits_[slot].max_names)
+    {
+        counts[slot].fetch_sub(1, std::memory_order_relaxed);
+        if (global != 0)
+        {
+            counts[0].fetch_sub(1, std::memory_order_relaxed);
+        }
+        return slot;
+    }
+    return ADMITTED;
+}
+
+std::size_t CardinalityGuard::check(std::string_view name, std::size_t interned,
+                                    const WindowCounts& counts) const noexcept
+{
+    std::size_t slot = match(name);
+    if (max_interned_ != 0 && interned >= max_interned_)
+    {
+        return slot;
+    }
+
+    std::size_t global = limits_[0].max_names;
+    if (global != 0 && counts.load(0) >= global)
+    {
+        return 0;
+    }
+    if (slot != 0 && counts.load(slot) >= limits_[slot].max_names)
+    {
+        return slot;
+    }
+    return ADMITTED;
+}
+
+std::optional<NameTable::Interned> CardinalityGuard::refuse(std::size_t slot,
+                                                            std::size_t type) noexcept
+{
+    if (action_ == OverflowAction::Reject)
+    {
+        count_rejected(slot);
+        return std::nullopt;
+    }
+    count_folded(slot);
+    return limits_[slot].overflow[type];
+}
+
+bool CardinalityGuard::is_overflow(uint64_t key) const noexcept
+{
+    for (const auto& limit : limits_)
+    {
+        for (const auto& overflow : limit.overflow)
+        {
+            if (overflow.key == key)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::size_t CardinalityGuard::match(std::string_view name) const noexcept
+{
+    std::size_t best     = 0;
+    std::size_t best_len = 0;
+    for (std::size_t slot = 1; slot < limits_.size(); slot++)
+    {
+        const auto& prefix = limits_[slot].prefix;
+        if (prefix.size() > best_len && name.starts_with(prefix))
+        {
+            best     = slot;
+            best_len = prefix.size();
+        }
+    }
+    return best;
+}
+
+std::vector<CardinalityStats> CardinalityGuard::stats() const
+{
+    std::vector<CardinalityStats> stats;
+    stats.reserve(limits_.size());
+    for (const auto& limit : limits_)
+    {
+        stats.push_back({limit.prefix, limit.max_names,
+                         limit.rejected.load(std::memory_order_relaxed),
+                         limit.folded.load(std::memory_order_relaxed)});
+    }
+    return stats;
+}
+} // namespace metric_collector::aggregation
@@ -0,0 +1,169 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_CARDINALITY_GUARD_HPP
+#define METRIC_COLLECTOR_AGGREGATION_CARDINALITY_GUARD_HPP
+
+#include "metrics.hpp"
+#include "name_table.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace metric_collector::aggregation
+{
+// What happens to a name that would take a window over a limit.
+enum class OverflowAction : uint8_t
+{
+    Reject, // its samples are dropped
+    Fold    // its samples go to the limit's overflow metric, <prefix>cardinality_overflow.<type>
+};
+
+struct PrefixLimit
+{
+    std::string prefix;
+    std::size_t max_names;
+};
+
+// Distinct names a single window may hold. 0 means no global limit; a name also counts against
+// the longest configured prefix it starts with, if any. A prefix limit is at least 1, a
+// CardinalityGuard refuses 0 rather than guess between no limit and blocking the prefix.
+// max_interned bounds the names interned at once. Names expire a few rotations after their last
+// sample (see BucketRing::NAME_EXPIRY and NameTable::EXPIRE_SWEEP), so it caps the names in use
+// rather than every name ever seen; once it is reached new names are refused like names over the
+// global limit. 0 lets a BucketRing allow max_names for every window a name stays interned, and
+// sets no bound without a global limit.
+struct CardinalityLimits
+{
+    std::size_t              max_names{0};
+    std::vector<PrefixLimit> prefixes;
+    OverflowAction           action{OverflowAction::Reject};
+    std::size_t              max_interned{0};
+};
+
+// Samples turned away by one limit since start, the global one has an empty prefix.
+struct CardinalityStats
+{
+    std::string prefix;
+    std::size_t max_names;
+    uint64_t    rejected;
+    uint64_t    folded;
+};
+
+// Enforces CardinalityLimits on the insert path of a window. It is only consulted when a key is
+// new to the window's shard, i.e. a distinct name, so a plain counter per limit and window is
+// an exact distinct count and the hot path for known names never sees the guard.
+// Names the NameTable has not seen yet are checked earlier with check(), against the open
+// window's counts and max_interned, so a refused name never takes an entry.
+class CardinalityGuard
+{
+  public:
+    static constexpr std::size_t ADMITTED = std::numeric_limits<std::size_t>::max();
+
+    // distinct names admitted into one window, per limit; reset when the window is reused
+    class WindowCounts
+    {
+      public:
+        void resize(std::size_t slots)
+        {
+            counts_ = std::make_unique<std::atomic<uint64_t>[]>(slots);
+            slots_  = slots;
+        }
+
+        void reset() noexcept
+        {
+            for (std::size_t i = 0; i < slots_; i++)
+            {
+                counts_[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        std::atomic<uint64_t>& operator[](std::size_t slot) noexcept { return counts_[slot]; }
+
+        [[nodiscard]] uint64_t load(std::size_t slot) const noexcept
+        {
+            return counts_[slot].load(std::memory_order_relaxed);
+        }
+
+      private:
+        std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+        std::size_t                              slots_{0};
+    };
+
+    CardinalityGuard() = default;
+
+    // interns the overflow names up front so folding never takes the NameTable locks; throws on
+    // a prefix limit of 0
+    CardinalityGuard(CardinalityLimits limits, NameTable& names);
+
+    CardinalityGuard(const CardinalityGuard&)            = delete;
+    CardinalityGuard& operator=(const CardinalityGuard&) = delete;
+
+    [[nodiscard]] bool enabled() const noexcept { return !limits_.empty(); }
+
+    // slot 0 is the global limit, the prefixes follow
+    [[nodiscard]] std::size_t slots() const noexcept { return limits_.size(); }
+
+    // counts name into the window, or returns the slot of the limit it would exceed
+    std::size_t admit(std::string_view name, WindowCounts& counts) noexcept;
+
+    // for a name not interned yet: ADMITTED if admit() would take it now and the table has room
+    // beyond interned names, otherwise the slot of the limit it hits; counts nothing
+    [[nodiscard]] std::size_t check(std::string_view name, std::size_t interned,
+                                    const WindowCounts& counts) const noexcept;
+
+    // counts a sample of a name check() refused and returns where its samples go, nullopt to
+    // drop them
+    std::optional<NameTable::Interned> refuse(std::size_t slot, std::size_t type) noexcept;
+
+    [[nodiscard]] OverflowAction action() const noexcept { return action_; }
+
+    template <MetricTypeConcept T>
+    [[nodiscard]] NameTable::Interned overflow(std::size_t slot) const noexcept
+    {
+        return limits_[slot].overflow[metric_index<T>()];
+    }
+
+    // overflow metrics are exempt from every limit, they absorb what the limits turn away
+    [[nodiscard]] bool is_overflow(uint64_t key) const noexcept;
+
+    // every count is in samples, whichever path turned them away
+    void count_rejected(std::size_t slot, uint64_t samples = 1) noexcept
+    {
+        limits_[slot].rejected.fetch_add(samples, std::memory_order_relaxed);
+    }
+    void count_folded(std::size_t slot, uint64_t samples = 1) noexcept
+    {
+        limits_[slot].folded.fetch_add(samples, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::vector<CardinalityStats> stats() const;
+
+  private:
+    static constexpr std::size_t NUM_TYPES = std::variant_size_v<MetricVariant>;
+
+    struct Limit
+    {
+        std::string                                prefix;
+        std::size_t                                max_names{0}; // 0: unlimited global slot
+        std::array<NameTable::Interned, NUM_TYPES> overflow{};
+        std::atomic<uint64_t>                      rejected{0};
+        std::atomic<uint64_t>                      folded{0};
+    };
+
+    // slot of the longest prefix name starts with, 0 if none
+    [[nodiscard]] std::size_t match(std::string_view name) const noexcept;
+
+    std::vector<Limit> limits_; // sized once, atomics never move
+    OverflowAction     action_{OverflowAction::Reject};
+    std::size_t        max_interned_{0};
+};
+} // namespace metric_collector::aggregation
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_FLAT_INDEX_HPP
+#define METRIC_COLLECTOR_AGGREGATION_FLAT_INDEX_HPP
+
+#include "flat_map.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace metric_collector::aggregation
+{
+// FlatMap's probing for owners that keep the keys themselves, e.g. next to the values in dense
+// arrays. A slot is only a 32-bit reference into the owner's storage and key_of(ref) resolves it
+// back to its key when a tag matches or the index grows, so a slot costs 5 bytes instead of
+// FlatMap's key plus value. Same rules as FlatMap: no erase, only clear().
+class FlatIndex : public FlatGroups
+{
+  public:
+    using Ref = uint32_t;
+
+    FlatIndex() = default;
+    ~FlatIndex() { deallocate(); }
+
+    FlatIndex(const FlatIndex&)            = delete;
+    FlatIndex& operator=(const FlatIndex&) = delete;
+
+    template <typename KeyOf>
+    [[nodiscard]] const Ref* find(uint64_t key, const KeyOf& key_of) const noexcept
+    {
+        if (size_ == 0)
+        {
+            return nullptr;
+        }
+
+        uint64_t hash = mix(key);
+        uint8_t  tag  = tag_of(hash);
+
+        std::size_t group = hash & group_mask_;
+        for (std::size_t step = 1;; group = (group + step++) & group_mask_)
+        {
+            const uint8_t* ctrl = ctrl_ + group * GROUP_SIZE;
+
+            for (uint32_t bits = match(ctrl, tag); bits != 0; bits &= bits - 1)
+            {
+                const Ref& ref = refs_[group * GROUP_SIZE + std::countr_zero(bits)];
+                if (key_of(ref) == key)
+                {
+                    return &ref;
+                }
+            }
+
+            if (match(ctrl, EMPTY) != 0)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    // key must not be in the index yet; growing resolves every other reference through key_of
+    template <typename KeyOf> void insert(uint64_t key, Ref ref, const KeyOf& key_of)
+    {
+        if ((size_ + 1) * 8 > capacity() * 7)
+        {
+            rehash(capacity() == 0 ? GROUP_SIZE : capacity() * 2, key_of);
+        }
+
+        insert_slot(key) = ref;
+        ++size_;
+    }
+
+    // drops every entry but keeps the allocation for the next round
+    void clear() noexcept
+    {
+        if (ctrl_ != nullptr)
+        {
+            std::memset(ctrl_, EMPTY, capacity());
+        }
+        size_ = 0;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    [[nodiscard]] std::size_t capacity() const noexcept
+    {
+        return ctrl_ == nullptr ? 0 : (group_mask_ + 1) * GROUP_SIZE;
+    }
+
+    [[nodiscard]] std::size_t memory_usage() const noexcept
+    {
+        return capacity() * (sizeof(Ref) + 1);
+    }
+
+  private:
+    Ref& insert_slot(uint64_t key) noexcept
+    {
+        uint64_t hash = mix(key);
+
+        std::size_t group = hash & group_mask_;
+        for (std::size_t step = 1;; group = (group + step++) & group_mask_)
+        {
+            uint32_t empty = match(ctrl_ + group * GROUP_SIZE, EMPTY);
+            if (empty != 0)
+            {
+                std::size_t idx = group * GROUP_SIZE + std::countr_zero(empty);
+                ctrl_[idx]      = tag_of(hash);
+                return refs_[idx];
+            }
+        }
+    }
+
+    template <typename KeyOf> void rehash(std::size_t new_capacity, const KeyOf& key_of)
+    {
+        FlatIndex next;
+        next.allocate(new_capacity);
+
+        for (std::size_t i = 0; i < capacity(); i++)
+        {
+            if (ctrl_[i] != EMPTY)
+            {
+                next.insert_slot(key_of(refs_[i])) = refs_[i];
+            }
+        }
+
+        std::swap(ctrl_, next.ctrl_);
+        std::swap(refs_, next.refs_);
+        std::swap(group_mask_, next.group_mask_);
+    }
+
+    void allocate(std::size_t capacity)
+    {
+        ctrl_ = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t{GROUP_SIZE}));
+        refs_ = static_cast<Ref*>(::operator new(capacity * sizeof(Ref)));
+        std::memset(ctrl_, EMPTY, capacity);
+        group_mask_ = capacity / GROUP_SIZE - 1;
+    }
+
+    void deallocate() noexcept
+    {
+        if (ctrl_ == nullptr)
+        {
+            return;
+        }
+
+        ::operator delete(ctrl_, std::align_val_t{GROUP_SIZE});
+        ::operator delete(refs_);
+        ctrl_ = nullptr;
+        refs_ = nullptr;
+    }
+
+    uint8_t*    ctrl_{nullptr};
+    Ref*        refs_{nullptr};
+    std::size_t group_mask_{0};
+    std::size_t size_{0};
+};
+} // namespace metric_collector::aggregation
+
+#endif
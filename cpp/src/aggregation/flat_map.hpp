@@ -0,0 +1,297 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_FLAT_MAP_HPP
+#define METRIC_COLLECTOR_AGGREGATION_FLAT_MAP_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace metric_collector::aggregation
+{
+// Control byte groups shared by FlatMap and FlatIndex.
+class FlatGroups
+{
+  public:
+    static constexpr std::size_t GROUP_SIZE = 16;
+
+  protected:
+    static constexpr uint8_t EMPTY = 0x80;
+
+    // keys are hashes but the owning Bucket already consumed their low bits to pick a shard,
+    // so remix before using them for placement
+    static uint64_t mix(uint64_t key) noexcept
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    static uint8_t tag_of(uint64_t hash) noexcept { return static_cast<uint8_t>(hash >> 57); }
+
+    // bitmask of the slots in a group whose control byte equals value
+    static uint32_t match(const uint8_t* ctrl, uint8_t value) noexcept
+    {
+#if defined(__SSE2__)
+        __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+        __m128i probe = _mm_set1_epi8(static_cast<char>(value));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, probe)));
+#else
+        uint32_t bits = 0;
+        for (std::size_t i = 0; i < GROUP_SIZE; i++)
+        {
+            bits |= static_cast<uint32_t>(ctrl[i] == value) << i;
+        }
+        return bits;
+#endif
+    }
+};
+
+// Open addressing map for 64-bit pre-hashed keys with values stored inline. Slots are probed a
+// group of 16 at a time: every slot has a control byte holding 7 bits of the hash (or EMPTY), so
+// one SIMD compare finds the candidate slots of a group before any key is touched.
+// Keys are never erased one by one, only the whole map is cleared, so no tombstones are needed
+// and a probe stops at the first group that still has an empty slot.
+// Pointers returned by find()/try_emplace() are invalidated by the next insert.
+template <typename V> class FlatMap : public FlatGroups
+{
+  public:
+    FlatMap() = default;
+    explicit FlatMap(std::size_t expected) { reserve(expected); }
+
+    ~FlatMap()
+    {
+        destroy_values();
+        deallocate();
+    }
+
+    FlatMap(const FlatMap&)            = delete;
+    FlatMap& operator=(const FlatMap&) = delete;
+
+    FlatMap(FlatMap&& other) noexcept { swap(other); }
+    FlatMap& operator=(FlatMap&& other) noexcept
+    {
+        FlatMap tmp(std::move(other));
+        swap(tmp);
+        return *this;
+    }
+
+    [[nodiscard]] V* find(uint64_t key) noexcept
+    {
+        return const_cast<V*>(std::as_const(*this).find(key));
+    }
+
+    [[nodiscard]] const V* find(uint64_t key) const noexcept
+    {
+        if (size_ == 0)
+        {
+            return nullptr;
+        }
+
+        uint64_t hash = mix(key);
+        uint8_t  tag  = tag_of(hash);
+
+        std::size_t group = hash & group_mask_;
+        for (std::size_t step = 1;; group = (group + step++) & group_mask_)
+        {
+            const uint8_t* ctrl = ctrl_ + group * GROUP_SIZE;
+
+            for (uint32_t bits = match(ctrl, tag); bits != 0; bits &= bits - 1)
+            {
+                const Slot& slot = slots_[group * GROUP_SIZE + std::countr_zero(bits)];
+                if (slot.key == key)
+                {
+                    return slot.value();
+                }
+            }
+
+            if (match(ctrl, EMPTY) != 0)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    // returns the value for key, constructing it from args if absent
+    template <typename... Args> std::pair<V*, bool> try_emplace(uint64_t key, Args&&... args)
+    {
+        if (V* existing = find(key))
+        {
+            return {existing, false};
+        }
+
+        if ((size_ + 1) * 8 > capacity() * 7)
+        {
+            rehash(capacity() == 0 ? GROUP_SIZE : capacity() * 2);
+        }
+
+        Slot& slot = insert_slot(key);
+        ::new (slot.storage) V(std::forward<Args>(args)...);
+        ++size_;
+        return {slot.value(), true};
+    }
+
+    // drops every entry but keeps the allocation for the next round
+    void clear() noexcept
+    {
+        destroy_values();
+        if (ctrl_ != nullptr)
+        {
+            std::memset(ctrl_, EMPTY, capacity());
+        }
+        size_ = 0;
+    }
+
+    void reserve(std::size_t expected)
+    {
+        std::size_t needed = std::bit_ceil((expected * 8 + 6) / 7);
+        if (needed > capacity())
+        {
+            rehash(needed < GROUP_SIZE ? GROUP_SIZE : needed);
+        }
+    }
+
+    template <typename F> void for_each(F&& func) const
+    {
+        for (std::size_t i = 0; i < capacity(); i++)
+        {
+            if (ctrl_[i] != EMPTY)
+            {
+                func(slots_[i].key, *slots_[i].value());
+            }
+        }
+    }
+
+    // func may change the values but not insert
+    template <typename F> void for_each(F&& func)
+    {
+        for (std::size_t i = 0; i < capacity(); i++)
+        {
+            if (ctrl_[i] != EMPTY)
+            {
+                func(slots_[i].key, *slots_[i].value());
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    [[nodiscard]] bool        empty() const noexcept { return size_ == 0; }
+    [[nodiscard]] std::size_t capacity() const noexcept
+    {
+        return ctrl_ == nullptr ? 0 : (group_mask_ + 1) * GROUP_SIZE;
+    }
+
+    // bytes held by control bytes and slots, excluding anything the values own
+    [[nodiscard]] std::size_t memory_usage() const noexcept
+    {
+        return capacity() * (sizeof(Slot) + 1);
+    }
+
+  private:
+    struct Slot
+    {
+        uint64_t             key;
+        alignas(V) std::byte storage[sizeof(V)];
+
+        V*       value() noexcept { return std::launder(reinterpret_cast<V*>(storage)); }
+        const V* value() const noexcept
+        {
+            return std::launder(reinterpret_cast<const V*>(storage));
+        }
+    };
+
+    Slot& insert_slot(uint64_t key) noexcept
+    {
+        uint64_t hash = mix(key);
+
+        std::size_t group = hash & group_mask_;
+        for (std::size_t step = 1;; group = (group + step++) & group_mask_)
+        {
+            uint32_t empty = match(ctrl_ + group * GROUP_SIZE, EMPTY);
+            if (empty != 0)
+            {
+                std::size_t idx = group * GROUP_SIZE + std::countr_zero(empty);
+                ctrl_[idx]      = tag_of(hash);
+                slots_[idx].key = key;
+                return slots_[idx];
+            }
+        }
+    }
+
+    void rehash(std::size_t new_capacity)
+    {
+        FlatMap next;
+        next.allocate(new_capacity);
+
+        for (std::size_t i = 0; i < capacity(); i++)
+        {
+            if (ctrl_[i] != EMPTY)
+            {
+                Slot& slot = next.insert_slot(slots_[i].key);
+                ::new (slot.storage) V(std::move(*slots_[i].value()));
+                next.size_++;
+            }
+        }
+
+        swap(next);
+    }
+
+    void allocate(std::size_t capacity)
+    {
+        ctrl_  = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t{GROUP_SIZE}));
+        slots_ = static_cast<Slot*>(::operator new(capacity * sizeof(Slot),
+                                                   std::align_val_t{alignof(Slot)}));
+        std::memset(ctrl_, EMPTY, capacity);
+        group_mask_ = capacity / GROUP_SIZE - 1;
+    }
+
+    void deallocate() noexcept
+    {
+        if (ctrl_ == nullptr)
+        {
+            return;
+        }
+
+        ::operator delete(ctrl_, std::align_val_t{GROUP_SIZE});
+        ::operator delete(slots_, std::align_val_t{alignof(Slot)});
+        ctrl_  = nullptr;
+        slots_ = nullptr;
+    }
+
+    void destroy_values() noexcept
+    {
+        if constexpr (!std::is_trivially_destructible_v<V>)
+        {
+            for (std::size_t i = 0; i < capacity(); i++)
+            {
+                if (ctrl_[i] != EMPTY)
+                {
+                    slots_[i].value()->~V();
+                }
+            }
+        }
+    }
+
+    void swap(FlatMap& other) noexcept
+    {
+        std::swap(ctrl_, other.ctrl_);
+        std::swap(slots_, other.slots_);
+        std::swap(group_mask_, other.group_mask_);
+        std::swap(size_, other.size_);
+    }
+
+    uint8_t*    ctrl_{nullptr};
+    Slot*       slots_{nullptr};
+    std::size_t group_mask_{0};
+    std::size_t size_{0};
+};
+} // namespace metric_collector::aggregation
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef METRIC_COLLECTOR_AGGREGATION_HASH_HPP
 #define METRIC_COLLECTOR_AGGREGATION_HASH_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 namespace metric_collector::aggregation
 {
@@ -20,6 +22,100 @@ constexpr uint64_t FNV_PRIME  = 1099511628211ULL;
     return hash;
 }
 
+namespace detail
+{
+constexpr uint64_t WY_P0 = 0xa0761d6478bd642fULL;
+constexpr uint64_t WY_P1 = 0xe7037ed1a0b428dbULL;
+constexpr uint64_t WY_P2 = 0x8ebc6af09c88c6e3ULL;
+constexpr uint64_t WY_P3 = 0x589965cc75374cc3ULL;
+
+// 64x64 -> 128 bit multiply folded back to 64 bits
+inline uint64_t wy_mix(uint64_t a, uint64_t b) noexcept
+{
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+inline uint64_t read64(const unsigned char* p) noexcept
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t read32(const unsigned char* p) noexcept
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+} // namespace detail
+
+// wyhash: consumes 16 to 48 bytes per step instead of one, names of up to 16 bytes take two
+// overlapping loads and two multiplies. Used for everything on the ingestion path.
+[[nodiscard]] inline uint64_t hash_bytes(const char* data, std::size_t len,
+                                         uint64_t seed = 0) noexcept
+{
+    using namespace detail;
+
+    const auto* p = reinterpret_cast<const unsigned char*>(data);
+    uint64_t    a = 0;
+    uint64_t    b = 0;
+
+    seed ^= wy_mix(seed ^ WY_P0, WY_P1);
+
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            std::size_t mid = (len >> 3) << 2;
+            a               = (read32(p) << 32) | read32(p + mid);
+            b               = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+        }
+        else if (len > 0)
+        {
+            a = (uint64_t{p[0]} << 16) | (uint64_t{p[len >> 1]} << 8) | p[len - 1];
+        }
+    }
+    else
+    {
+        std::size_t left = len;
+        if (left > 48)
+        {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do
+            {
+                seed = wy_mix(read64(p) ^ WY_P1, read64(p + 8) ^ seed);
+                see1 = wy_mix(read64(p + 16) ^ WY_P2, read64(p + 24) ^ see1);
+                see2 = wy_mix(read64(p + 32) ^ WY_P3, read64(p + 40) ^ see2);
+                p += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while (left > 16)
+        {
+            seed = wy_mix(read64(p) ^ WY_P1, read64(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+
+        a = read64(p + left - 16);
+        b = read64(p + left - 8);
+    }
+
+    a ^= WY_P1;
+    b ^= seed;
+
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    a                   = static_cast<uint64_t>(product);
+    b                   = static_cast<uint64_t>(product >> 64);
+
+    return detail::wy_mix(a ^ WY_P0 ^ len, b ^ WY_P1);
+}
+
 } // namespace metric_collector::aggregation
 
 #endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_HYPERLOGLOG_HPP
+#define METRIC_COLLECTOR_AGGREGATION_HYPERLOGLOG_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace metric_collector::aggregation
+{
+// HyperLogLog distinct counter with 2^PRECISION one byte registers (~1.6% standard error).
+// Small sets keep a sorted sparse list of (register, rank) pairs and switch to the dense
+// registers once the list would outgrow half of them, so memory stays under DENSE_BYTES no
+// matter the cardinality. Dense merges take the bytewise max 16 registers at a time with SSE2,
+// one at a time without.
+// Both come from the memory resource given at construction (a window's arena) or the default one.
+// Not thread safe, owners serialise access.
+class HyperLogLog
+{
+  public:
+    static constexpr unsigned    PRECISION   = 12;
+    static constexpr std::size_t NUM_REGS    = std::size_t{1} << PRECISION;
+    static constexpr std::size_t DENSE_BYTES = NUM_REGS;
+    static constexpr std::size_t SPARSE_MAX  = DENSE_BYTES / 2 / sizeof(uint32_t);
+
+    HyperLogLog() = default;
+    explicit HyperLogLog(std::pmr::memory_resource* resource) : sparse_(resource) {}
+
+    // copies allocate from the default resource, whatever the original's
+    HyperLogLog(const HyperLogLog& other) : sparse_(other.sparse_)
+    {
+        if (other.dense_ != nullptr)
+        {
+            allocate_dense();
+            std::copy_n(other.dense_, NUM_REGS, dense_);
+        }
+    }
+    HyperLogLog& operator=(const HyperLogLog& other)
+    {
+        if (this != &other)
+        {
+            sparse_ = other.sparse_;
+            if (other.dense_ == nullptr)
+            {
+                release_dense();
+            }
+            else
+            {
+                allocate_dense();
+                std::copy_n(other.dense_, NUM_REGS, dense_);
+            }
+        }
+        return *this;
+    }
+    HyperLogLog(HyperLogLog&& other) noexcept
+        : sparse_(std::move(other.sparse_)), dense_(std::exchange(other.dense_, nullptr))
+    {
+    }
+    // registers only change hands within one resource, otherwise they are copied
+    HyperLogLog& operator=(HyperLogLog&& other)
+    {
+        if (*resource() != *other.resource())
+        {
+            return *this = std::as_const(other);
+        }
+        sparse_ = std::move(other.sparse_);
+        std::swap(dense_, other.dense_);
+        return *this;
+    }
+    ~HyperLogLog() { release_dense(); }
+
+    // hash is any 64 bit hash of the element, it is remixed so weak hashes and raw integers work
+    void add(uint64_t hash)
+    {
+        hash = mix(hash);
+
+        auto idx  = static_cast<uint32_t>(hash >> (64 - PRECISION));
+        auto rank = static_cast<uint8_t>(std::countl_zero((hash << PRECISION) | GUARD_BIT) + 1);
+
+        update(idx, rank);
+    }
+
+    void merge(const HyperLogLog& other)
+    {
+        if (other.dense_ != nullptr)
+        {
+            densify();
+
+#if defined(__SSE2__)
+            // registers hold at most 64 - PRECISION + 1, so the unsigned byte max is exact
+            for (std::size_t i = 0; i < NUM_REGS; i += 16)
+            {
+                auto* dst = reinterpret_cast<__m128i*>(dense_ + i);
+                auto* src = reinterpret_cast<const __m128i*>(other.dense_ + i);
+                _mm_storeu_si128(dst, _mm_max_epu8(_mm_loadu_si128(dst), _mm_loadu_si128(src)));
+            }
+#else
+            for (std::size_t i = 0; i < NUM_REGS; i++)
+            {
+                dense_[i] = std::max(dense_[i], other.dense_[i]);
+            }
+#endif
+            return;
+        }
+
+        for (uint32_t entry : other.sparse_)
+        {
+            update(entry >> 8, static_cast<uint8_t>(entry & 0xFF));
+        }
+    }
+
+    // estimated number of distinct elements added
+    [[nodiscard]] uint64_t count() const noexcept
+    {
+        double      sum   = 0.0;
+        std::size_t zeros = 0;
+
+        if (dense_ != nullptr)
+        {
+            for (std::size_t i = 0; i < NUM_REGS; i++)
+            {
+                zeros += dense_[i] == 0 ? 1 : 0;
+                sum += INVERSE_POW2[dense_[i]];
+            }
+        }
+        else
+        {
+            zeros = NUM_REGS - sparse_.size();
+            sum   = static_cast<double>(zeros);
+            for (uint32_t entry : sparse_)
+            {
+                sum += INVERSE_POW2[entry & 0xFF];
+            }
+        }
+
+        constexpr double m     = static_cast<double>(NUM_REGS);
+        constexpr double alpha = 0.7213 / (1.0 + 1.079 / m);
+
+        double estimate = alpha * m * m / sum;
+        if (estimate <= 2.5 * m && zeros != 0)
+        {
+            // linear counting is far more accurate while registers are still empty
+            estimate = m * std::log(m / static_cast<double>(zeros));
+        }
+        return static_cast<uint64_t>(std::llround(estimate));
+    }
+
+    [[nodiscard]] bool        dense() const noexcept { return dense_ != nullptr; }
+    [[nodiscard]] std::size_t memory_usage() const noexcept
+    {
+        return dense_ != nullptr ? DENSE_BYTES : sparse_.capacity() * sizeof(uint32_t);
+    }
+
+  private:
+    static constexpr uint64_t GUARD_BIT = uint64_t{1} << (PRECISION - 1);
+
+    // 2^-rank for every possible register value
+    static constexpr std::array<double, 66 - PRECISION> INVERSE_POW2 = []
+    {
+        std::array<double, 66 - PRECISION> table{};
+        double                             value = 1.0;
+        for (auto& entry : table)
+        {
+            entry = value;
+            value /= 2.0;
+        }
+        return table;
+    }();
+
+    static uint64_t mix(uint64_t hash) noexcept
+    {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    void update(uint32_t idx, uint8_t rank)
+    {
+        if (dense_ != nullptr)
+        {
+            dense_[idx] = std::max(dense_[idx], rank);
+            return;
+        }
+
+        // sparse entries are register << 8 | rank, ordered by register
+        uint32_t entry = (idx << 8) | rank;
+        auto     it    = std::lower_bound(sparse_.begin(), sparse_.end(), idx << 8);
+        if (it != sparse_.end() && (*it >> 8) == idx)
+        {
+            *it = std::max(*it, entry);
+            return;
+        }
+
+        if (sparse_.size() == SPARSE_MAX)
+        {
+            densify();
+            dense_[idx] = rank;
+            return;
+        }
+        sparse_.insert(it, entry);
+    }
+
+    void densify()
+    {
+        if (dense_ != nullptr)
+        {
+            return;
+        }
+
+        allocate_dense();
+        for (uint32_t entry : sparse_)
+        {
+            dense_[entry >> 8] = static_cast<uint8_t>(entry & 0xFF);
+        }
+        std::pmr::vector<uint32_t>(resource()).swap(sparse_);
+    }
+
+    [[nodiscard]] std::pmr::memory_resource* resource() const noexcept
+    {
+        return sparse_.get_allocator().resource();
+    }
+
+    void allocate_dense()
+    {
+        if (dense_ == nullptr)
+        {
+            dense_ = static_cast<uint8_t*>(resource()->allocate(NUM_REGS, 16));
+            std::fill_n(dense_, NUM_REGS, 0);
+        }
+    }
+
+    void release_dense() noexcept
+    {
+        if (dense_ != nullptr)
+        {
+            resource()->deallocate(dense_, NUM_REGS, 16);
+            dense_ = nullptr;
+        }
+    }
+
+    // the sparse list's allocator carries the memory resource for both representations
+    std::pmr::vector<uint32_t> sparse_;
+    uint8_t*                   dense_{nullptr};
+};
+} // namespace metric_collector::aggregation
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_LOCAL_TABLE_HPP
+#define METRIC_COLLECTOR_AGGREGATION_LOCAL_TABLE_HPP
+
+#include "flat_map.hpp"
+#include "metrics.hpp"
+#include "name_table.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace metric_collector::aggregation
+{
+// Single-writer counterparts of the shared metrics. They are owned by exactly one worker thread
+// so they need neither atomics nor locks, and are merged into a Bucket periodically.
+class LocalCounter
+{
+  public:
+    using shared_type = Counter;
+
+    void               increment(uint64_t value = 1) noexcept { value_ += value; }
+    [[nodiscard]] auto get() const noexcept { return value_; }
+
+  private:
+    uint64_t value_{0};
+};
+
+class LocalGauge
+{
+  public:
+    using shared_type = Gauge;
+
+    void               set(uint64_t value = 1) noexcept { value_ = value; }
+    [[nodiscard]] auto get() const noexcept { return value_; }
+
+  private:
+    uint64_t value_{0};
+};
+
+class LocalTimer
+{
+  public:
+    using shared_type = Timer;
+
+    void                       record(uint64_t value) { timer_.record(value); }
+    [[nodiscard]] const Timer& get() const noexcept { return timer_; }
+
+  private:
+    Timer timer_; // Timer has no atomics, this only gives it the local interface
+};
+
+class LocalSet
+{
+  public:
+    using shared_type = Set;
+
+    void                     add(uint64_t hash) { set_.add(hash); }
+    [[nodiscard]] const Set& get() const noexcept { return set_; }
+
+  private:
+    Set set_;
+};
+
+using LocalVariant = std::variant<LocalCounter, LocalGauge, LocalTimer, LocalSet>;
+
+template <MetricTypeConcept T> struct LocalSelector;
+
+template <> struct LocalSelector<Counter>
+{
+    using type = LocalCounter;
+};
+
+template <> struct LocalSelector<Gauge>
+{
+    using type = LocalGauge;
+};
+
+template <> struct LocalSelector<Timer>
+{
+    using type = LocalTimer;
+};
+
+template <> struct LocalSelector<Set>
+{
+    using type = LocalSet;
+};
+
+// A worker's metrics for the current interval. Entries are keyed by the name's hash, so the hot
+// path is one probe plus a compare against the interned name; the NameTable is only consulted
+// (and locked) the first time an interval sees a name. Entries carry the interned key, which is
+// what Bucket stores them under. A name the gate refuses is remembered for the interval too, so
+// its later samples are dropped or sent to the overflow metric without asking the NameTable
+// again; they are counted here and handed to the guard with the merge.
+class LocalTable
+{
+  public:
+    explicit LocalTable(NameTable& names) : names_(names) {}
+
+    LocalTable(const LocalTable&)            = delete;
+    LocalTable& operator=(const LocalTable&) = delete;
+
+    // false if the name already holds another type this interval, the sample is dropped. A
+    // name the NameTable's gate refuses is dropped or stored under the name the gate picked,
+    // counted per sample: the gate counts the first, the merge the rest
+    template <MetricTypeConcept T> bool add(std::string_view name, uint64_t delta)
+    {
+        using local_type = typename LocalSelector<T>::type;
+
+        Entry* found = entry<local_type>(name, metric_index<T>());
+        if (found == nullptr)
+        {
+            return true;
+        }
+
+        auto* local = std::get_if<local_type>(&found->value);
+        if (local == nullptr)
+        {
+            return false;
+        }
+        found->samples++;
+
+        if constexpr (std::same_as<T, Counter>)
+        {
+            local->increment(delta);
+        }
+        else if constexpr (std::same_as<T, Gauge>)
+        {
+            local->set(delta);
+        }
+        else if constexpr (std::same_as<T, Timer>)
+        {
+            local->record(delta);
+        }
+        else if constexpr (std::same_as<T, Set>)
+        {
+            local->add(delta);
+        }
+        return true;
+    }
+
+    // func(key, name, value, samples) with the interned key and name
+    template <typename F> void for_each(F&& func) const
+    {
+        metrics_.for_each([&func](uint64_t /*hash*/, const Entry& entry)
+                          { func(entry.key, entry.name, entry.value, entry.samples); });
+        for (const auto& entry : collided_)
+        {
+            func(entry.key, entry.name, entry.value, entry.samples);
+        }
+    }
+
+    // func(limit, folded, samples) for the names the gate refused this interval, with the
+    // samples that came after the one the gate counted
+    template <typename F> void for_each_refused(F&& func) const
+    {
+        refused_.for_each(
+            [&func](uint64_t /*hash*/, const Refused& refused)
+            {
+                if (refused.samples != 0)
+                {
+                    func(refused.limit, refused.instead.has_value(), refused.samples);
+                }
+            });
+    }
+
+    // keeps the table's capacity so the next interval does not allocate again
+    void clear()
+    {
+        metrics_.clear();
+        collided_.clear();
+        refused_.clear();
+        refused_names_.release();
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0 && refused_.empty(); }
+    // metrics held, refused names excluded
+    [[nodiscard]] std::size_t size() const noexcept { return metrics_.size() + collided_.size(); }
+
+  private:
+    struct Entry
+    {
+        template <typename Local>
+        Entry(NameTable::Interned interned, std::in_place_type_t<Local> type)
+            : key(interned.key), name(interned.name), value(type)
+        {
+        }
+
+        uint64_t         key;
+        std::string_view name; // points into the NameTable
+        LocalVariant     value;
+        uint64_t         samples{0};
+    };
+
+    // a name the gate refused, and the type it was refused for
+    struct Refused
+    {
+        std::string_view                   name; // copied into refused_names_
+        std::size_t                        type;
+        std::size_t                        limit;
+        std::optional<NameTable::Interned> instead; // the overflow metric, nullopt if dropped
+        uint64_t                           samples{0};
+    };
+
+    // nullptr if the gate dropped the name
+    template <typename Local> Entry* entry(std::string_view name, std::size_t type)
+    {
+        uint64_t hash = NameTable::hash_of(name);
+
+        Entry* found = metrics_.find(hash);
+        if (found != nullptr && found->name == name)
+        {
+            return found;
+        }
+
+        if (found != nullptr)
+        {
+            // another name of this interval has the same hash, keep this one aside
+            for (auto& other : collided_)
+            {
+                if (other.name == name)
+                {
+                    return &other;
+                }
+            }
+        }
+
+        Refused* refused = refused_.find(hash);
+        if (refused != nullptr && refused->name == name && refused->type == type)
+        {
+            refused->samples++;
+            return refused->instead.has_value() ? entry<Local>(refused->instead->name, type)
+                                                : nullptr;
+        }
+
+        NameTable::Verdict verdict;
+        auto               interned = names_.intern_checked(name, hash, type, &verdict);
+        if (!verdict.admit)
+        {
+            if (refused == nullptr)
+            {
+                // a name refused for another type, or colliding with one, just asks again
+                refused_.try_emplace(hash, Refused{copy(name), type, verdict.limit,
+                                                   verdict.instead, 0});
+            }
+            return interned.has_value() ? entry<Local>(interned->name, type) : nullptr;
+        }
+
+        if (found == nullptr)
+        {
+            return &*metrics_.try_emplace(hash, *interned, std::in_place_type<Local>).first;
+        }
+        return &collided_.emplace_back(*interned, std::in_place_type<Local>);
+    }
+
+    std::string_view copy(std::string_view name)
+    {
+        auto* bytes = static_cast<char*>(refused_names_.allocate(name.size(), 1));
+        std::memcpy(bytes, name.data(), name.size());
+        return {bytes, name.size()};
+    }
+
+    NameTable&                          names_;
+    FlatMap<Entry>                      metrics_;
+    std::vector<Entry>                  collided_;
+    FlatMap<Refused>                    refused_;
+    std::pmr::monotonic_buffer_resource refused_names_;
+};
+} // namespace metric_collector::aggregation
+
+#endif
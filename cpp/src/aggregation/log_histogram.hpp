@@ -0,0 +1,244 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_LOG_HISTOGRAM_HPP
+#define METRIC_COLLECTOR_AGGREGATION_LOG_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <utility>
+
+namespace metric_collector::aggregation
+{
+// Fixed-size log-linear histogram (HDR histogram layout). Values below LINEAR_LIMIT get a bucket
+// each, above that every power of two is split into SUB_BUCKETS equal buckets, so a bucket is at
+// most 1/SUB_BUCKETS of its lower bound wide and the midpoint estimate is within ~3% of any value
+// in it. Histograms merge by adding counts bucket by bucket, and subtract the same way.
+// Buckets are allocated on the first add() so metrics that never see a sample stay small, from
+// the memory resource given at construction (a window's arena) or the default one.
+// Not thread safe, owners serialise access.
+class LogHistogram
+{
+  public:
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr uint64_t SUB_BUCKETS     = uint64_t{1} << SUB_BUCKET_BITS;
+    static constexpr unsigned LINEAR_BITS     = SUB_BUCKET_BITS + 1;
+    static constexpr uint64_t LINEAR_LIMIT    = uint64_t{1} << LINEAR_BITS;
+    // values from 2^MAX_BITS up share the last bucket
+    static constexpr unsigned MAX_BITS = 32;
+
+    static constexpr std::size_t NUM_BUCKETS =
+        LINEAR_LIMIT + (MAX_BITS - LINEAR_BITS) * SUB_BUCKETS;
+
+    LogHistogram() = default;
+    explicit LogHistogram(std::pmr::memory_resource* resource) : resource_(resource) {}
+
+    // copies allocate from the default resource, whatever the original's
+    LogHistogram(const LogHistogram& other) : total_(other.total_)
+    {
+        if (other.counts_ != nullptr)
+        {
+            allocate();
+            std::copy_n(other.counts_, NUM_BUCKETS, counts_);
+        }
+    }
+    LogHistogram& operator=(const LogHistogram& other)
+    {
+        if (this != &other)
+        {
+            if (other.counts_ == nullptr)
+            {
+                release();
+            }
+            else
+            {
+                allocate();
+                std::copy_n(other.counts_, NUM_BUCKETS, counts_);
+            }
+            total_ = other.total_;
+        }
+        return *this;
+    }
+    LogHistogram(LogHistogram&& other) noexcept
+        : counts_(std::exchange(other.counts_, nullptr)),
+          resource_(other.resource_),
+          total_(other.total_)
+    {
+    }
+    // buckets only change hands within one resource, otherwise they are copied
+    LogHistogram& operator=(LogHistogram&& other)
+    {
+        if (*resource_ != *other.resource_)
+        {
+            return *this = std::as_const(other);
+        }
+        std::swap(counts_, other.counts_);
+        total_ = other.total_;
+        return *this;
+    }
+    ~LogHistogram() { release(); }
+
+    void add(uint64_t value, uint64_t count = 1)
+    {
+        allocate();
+        counts_[bucket_index(value)] += count;
+        total_ += count;
+    }
+
+    void merge(const LogHistogram& other)
+    {
+        if (other.counts_ == nullptr)
+        {
+            return;
+        }
+
+        allocate();
+        for (std::size_t i = 0; i < NUM_BUCKETS; i++)
+        {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+    }
+
+    // other must have been merged into this one before
+    void subtract(const LogHistogram& other)
+    {
+        if (other.counts_ == nullptr || counts_ == nullptr)
+        {
+            return;
+        }
+
+        for (std::size_t i = 0; i < NUM_BUCKETS; i++)
+        {
+            counts_[i] -= other.counts_[i];
+        }
+        total_ -= other.total_;
+    }
+
+    // lower bound of the lowest bucket holding a sample, 0 when empty
+    [[nodiscard]] uint64_t lowest() const noexcept
+    {
+        for (std::size_t i = 0; i < NUM_BUCKETS && total_ != 0; i++)
+        {
+            if (counts_[i] != 0)
+            {
+                return bucket_lower(i);
+            }
+        }
+        return 0;
+    }
+
+    // upper bound of the highest bucket holding a sample, 0 when empty
+    [[nodiscard]] uint64_t highest() const noexcept
+    {
+        for (std::size_t i = NUM_BUCKETS; i > 0 && total_ != 0; i--)
+        {
+            if (counts_[i - 1] != 0)
+            {
+                return i == NUM_BUCKETS ? std::numeric_limits<uint64_t>::max()
+                                        : bucket_lower(i - 1) + bucket_width(i - 1) - 1;
+            }
+        }
+        return 0;
+    }
+
+    // estimate of the value at quantile q in [0, 1], 0 when empty
+    [[nodiscard]] uint64_t quantile(double q) const noexcept
+    {
+        if (total_ == 0)
+        {
+            return 0;
+        }
+
+        q         = std::clamp(q, 0.0, 1.0);
+        auto rank = static_cast<uint64_t>(q * static_cast<double>(total_ - 1));
+
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < NUM_BUCKETS; i++)
+        {
+            seen += counts_[i];
+            if (seen > rank)
+            {
+                return bucket_lower(i) + bucket_width(i) / 2;
+            }
+        }
+        return bucket_lower(NUM_BUCKETS - 1);
+    }
+
+    [[nodiscard]] uint64_t total() const noexcept { return total_; }
+
+    static constexpr std::size_t bucket_index(uint64_t value) noexcept
+    {
+        if (value < LINEAR_LIMIT)
+        {
+            return static_cast<std::size_t>(value);
+        }
+        if (value >= (uint64_t{1} << MAX_BITS))
+        {
+            return NUM_BUCKETS - 1;
+        }
+
+        unsigned exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+        uint64_t sub      = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+
+        return LINEAR_LIMIT + (exponent - LINEAR_BITS) * SUB_BUCKETS + sub;
+    }
+
+    static constexpr uint64_t bucket_lower(std::size_t idx) noexcept
+    {
+        if (idx < LINEAR_LIMIT)
+        {
+            return idx;
+        }
+
+        auto exponent = static_cast<unsigned>((idx - LINEAR_LIMIT) / SUB_BUCKETS) + LINEAR_BITS;
+        auto sub      = (idx - LINEAR_LIMIT) % SUB_BUCKETS;
+
+        return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+    }
+
+    static constexpr uint64_t bucket_width(std::size_t idx) noexcept
+    {
+        if (idx < LINEAR_LIMIT)
+        {
+            return 1;
+        }
+
+        auto exponent = static_cast<unsigned>((idx - LINEAR_LIMIT) / SUB_BUCKETS) + LINEAR_BITS;
+        return uint64_t{1} << (exponent - SUB_BUCKET_BITS);
+    }
+
+  private:
+    void allocate()
+    {
+        if (counts_ == nullptr)
+        {
+            counts_ = static_cast<uint64_t*>(
+                resource_->allocate(NUM_BUCKETS * sizeof(uint64_t), alignof(uint64_t)));
+            std::fill_n(counts_, NUM_BUCKETS, 0);
+        }
+    }
+
+    void release() noexcept
+    {
+        if (counts_ != nullptr)
+        {
+            resource_->deallocate(counts_, NUM_BUCKETS * sizeof(uint64_t), alignof(uint64_t));
+            counts_ = nullptr;
+        }
+    }
+
+    // as wide as total_: a range merges a key's samples over any number of windows
+    uint64_t*                  counts_{nullptr};
+    std::pmr::memory_resource* resource_{std::pmr::get_default_resource()};
+    uint64_t                   total_{0};
+};
+
+static_assert(LogHistogram::bucket_index(LogHistogram::LINEAR_LIMIT - 1) ==
+              LogHistogram::LINEAR_LIMIT - 1);
+static_assert(LogHistogram::bucket_index((uint64_t{1} << LogHistogram::MAX_BITS) - 1) ==
+              LogHistogram::NUM_BUCKETS - 1);
+} // namespace metric_collector::aggregation
+
+#endif
@@ -1,9 +1,17 @@
 #ifndef METRIC_COLLECTOR_AGGREGATION_METRICS_HPP
 #define METRIC_COLLECTOR_AGGREGATION_METRICS_HPP
 
+#include "hyperloglog.hpp"
+#include "log_histogram.hpp"
+
+#include <algorithm>
 #include <atomic>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <memory_resource>
+#include <string_view>
 #include <variant>
 
 namespace metric_collector::aggregation
@@ -13,6 +21,7 @@ enum class MetricType : uint8_t
     Counter,
     Gauge,
     Timer,
+    Set,
     Invalid
 };
 
@@ -30,17 +39,33 @@ inline constexpr MetricType StringToMetricType(std::string_view value)
     {
         return MetricType::Timer;
     }
+    if (value == "s")
+    {
+        return MetricType::Set;
+    }
 
     return MetricType::Invalid;
 }
 
+// Copies take a relaxed snapshot; they exist so values can live inline in a relocating table and
+// be handed out by value to readers.
 class Counter
 {
   public:
+    Counter() = default;
+    Counter(const Counter& other) noexcept : value_(other.value_.load(std::memory_order_relaxed)) {}
+    Counter& operator=(const Counter& other) noexcept
+    {
+        value_.store(other.value_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
     void increment(uint64_t value = 1) noexcept
     {
         value_.fetch_add(value, std::memory_order_relaxed);
     }
+    // takes back increments counted earlier, e.g. a window leaving a range
+    void decrement(uint64_t value) noexcept { value_.fetch_sub(value, std::memory_order_relaxed); }
     [[nodiscard]] auto get() const noexcept { return value_.load(std::memory_order_relaxed); }
 
   private:
@@ -51,6 +76,12 @@ class Gauge
 {
   public:
     Gauge() = default;
+    Gauge(const Gauge& other) noexcept : value_(other.value_.load(std::memory_order_relaxed)) {}
+    Gauge& operator=(const Gauge& other) noexcept
+    {
+        value_.store(other.value_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
 
     void set(uint64_t value = 1) noexcept { value_.store(value, std::memory_order_relaxed); }
     [[nodiscard]] auto get() const noexcept { return value_.load(std::memory_order_relaxed); }
@@ -59,60 +90,125 @@ class Gauge
     std::atomic<uint64_t> value_{0};
 };
 
+// Unlike Counter and Gauge a Timer is not atomic: it is only written inside Shard::store (or by
+// the thread owning a LocalTimer), so plain fields and a histogram update replace the RMWs.
 class Timer
 {
   public:
     Timer() = default;
+    explicit Timer(std::pmr::memory_resource* resource) : histogram_(resource) {}
 
-    void record(uint64_t value) noexcept
+    void record(uint64_t value)
     {
-        count_.fetch_add(1, std::memory_order_relaxed);
-        sum_.fetch_add(value, std::memory_order_relaxed);
-
-        update_min(value);
-        update_max(value);
+        count_++;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        histogram_.add(value);
     }
 
-    [[nodiscard]] auto count() const noexcept { return count_.load(std::memory_order_relaxed); }
-    [[nodiscard]] auto sum() const noexcept { return sum_.load(std::memory_order_relaxed); }
-    [[nodiscard]] auto min() const noexcept { return min_.load(std::memory_order_relaxed); }
-    [[nodiscard]] auto max() const noexcept { return max_.load(std::memory_order_relaxed); }
+    // fold in samples aggregated elsewhere: another shard, worker or window
+    void merge(const Timer& other)
+    {
+        if (other.count_ == 0)
+        {
+            return;
+        }
 
-  private:
-    void update_atomic_min(uint64_t new_val) noexcept
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        histogram_.merge(other.histogram_);
+    }
+
+    // take back samples merged in earlier, e.g. a window leaving a range. The extremes cannot be
+    // taken back exactly, they narrow to the bounds of the buckets that still hold samples
+    void subtract(const Timer& other)
     {
-        uint64_t curr = min_.load(std::memory_order_relaxed);
-        while (new_val < curr &&
-               !min_.compare_exchange_weak(curr, new_val, std::memory_order_relaxed,
-                                           std::memory_order_relaxed))
+        if (other.count_ == 0)
+        {
+            return;
+        }
+
+        count_ -= other.count_;
+        sum_ -= other.sum_;
+        histogram_.subtract(other.histogram_);
+        if (count_ == 0)
         {
+            *this = Timer();
+            return;
         }
+        min_ = std::max(min_, histogram_.lowest());
+        max_ = std::min(max_, histogram_.highest());
     }
 
-    void update_atomic_max(uint64_t new_val) noexcept
+    // q in [0, 1], e.g. 0.99 for p99; the extremes are exact, the rest within ~3%
+    [[nodiscard]] uint64_t percentile(double q) const noexcept
     {
-        uint64_t curr = max_.load(std::memory_order_relaxed);
-        while (new_val > curr &&
-               !max_.compare_exchange_weak(curr, new_val, std::memory_order_relaxed,
-                                           std::memory_order_relaxed))
+        if (count_ == 0)
         {
+            return 0;
         }
+        if (q <= 0.0)
+        {
+            return min_;
+        }
+        if (q >= 1.0)
+        {
+            return max_;
+        }
+        return std::clamp(histogram_.quantile(q), min_, max_);
     }
 
-    void update_min(uint64_t value) noexcept { update_atomic_min(value); }
-    void update_max(uint64_t value) noexcept { update_atomic_max(value); }
+    [[nodiscard]] auto count() const noexcept { return count_; }
+    [[nodiscard]] auto sum() const noexcept { return sum_; }
+    [[nodiscard]] auto min() const noexcept { return min_; }
+    [[nodiscard]] auto max() const noexcept { return max_; }
 
-    std::atomic<uint64_t> count_{0};
-    std::atomic<uint64_t> sum_{0};
-    std::atomic<uint64_t> min_{std::numeric_limits<uint64_t>::max()};
-    std::atomic<uint64_t> max_{std::numeric_limits<uint64_t>::min()};
+  private:
+    uint64_t     count_{0};
+    uint64_t     sum_{0};
+    uint64_t     min_{std::numeric_limits<uint64_t>::max()};
+    uint64_t     max_{std::numeric_limits<uint64_t>::min()};
+    LogHistogram histogram_;
 };
 
-using MetricVariant = std::variant<Counter, Gauge, Timer>;
+// Distinct values seen, e.g. unique users. Elements arrive already hashed. Not atomic for the
+// same reason as Timer.
+class Set
+{
+  public:
+    Set() = default;
+    explicit Set(std::pmr::memory_resource* resource) : hll_(resource) {}
+
+    void add(uint64_t hash) { hll_.add(hash); }
+    void merge(const Set& other) { hll_.merge(other.hll_); }
+
+    [[nodiscard]] uint64_t count() const noexcept { return hll_.count(); }
+
+  private:
+    HyperLogLog hll_;
+};
+
+using MetricVariant = std::variant<Counter, Gauge, Timer, Set>;
 
 template <typename T>
-concept MetricTypeConcept =
-    std::same_as<T, Counter> || std::same_as<T, Gauge> || std::same_as<T, Timer>;
+concept MetricTypeConcept = std::same_as<T, Counter> || std::same_as<T, Gauge> ||
+                            std::same_as<T, Timer> || std::same_as<T, Set>;
+
+// position of T in MetricVariant, usable where the variant itself is not constexpr
+template <MetricTypeConcept T, std::size_t I = 0> constexpr std::size_t metric_index() noexcept
+{
+    if constexpr (std::same_as<std::variant_alternative_t<I, MetricVariant>, T>)
+    {
+        return I;
+    }
+    else
+    {
+        return metric_index<T, I + 1>();
+    }
+}
 
 struct MetricValue
 {
@@ -123,6 +219,11 @@ struct MetricValue
     {
     }
 
+    template <MetricTypeConcept T>
+    explicit MetricValue(const T& value) : metric(std::in_place_type<T>, value)
+    {
+    }
+
     MetricVariant metric;
 };
 
@@ -143,6 +244,11 @@ template <> struct MetricSelector<MetricType::Timer>
     using type = Timer;
 };
 
+template <> struct MetricSelector<MetricType::Set>
+{
+    using type = Set;
+};
+
 template <MetricType T> MetricValue create_metric()
 {
     using type = typename MetricSelector<T>::type;
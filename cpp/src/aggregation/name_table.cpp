@@ -0,0 +1,189 @@
+#include "name_table.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace metric_collector::aggregation
+{
+
+std::optional<NameTable::Interned> NameTable::lookup(std::string_view name, uint64_t hash,
+                                                     Gate* gate, std::size_t type,
+                                                     Verdict* refused, bool pin)
+{
+    Stripe&         stripe = stripes_[hash & STRIPE_MASK];
+    std::lock_guard lock(stripe.mutex);
+    uint32_t        seen   = pin ? Name::PINNED : stamp(epoch_.load(std::memory_order_relaxed));
+
+    // a name new to the table, or back after it expired, has to pass the gate
+    auto admit = [&](std::optional<Interned>& instead)
+    {
+        if (gate == nullptr)
+        {
+            return true;
+        }
+        auto verdict = gate->check(name, size(), type);
+        if (verdict.admit)
+        {
+            return true;
+        }
+        if (refused != nullptr)
+        {
+            *refused = verdict;
+        }
+        instead = verdict.instead;
+        return false;
+    };
+
+    uint64_t candidate = hash;
+    while (true)
+    {
+        Name* existing = stripe.names.find(candidate);
+        if (existing == nullptr)
+        {
+            std::optional<Interned> instead;
+            if (!admit(instead))
+            {
+                return instead;
+            }
+
+            auto copy = stripe.copy(name);
+            stripe.names.try_emplace(candidate,
+                                     Name{copy.data(), static_cast<uint32_t>(copy.size()), seen});
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return Interned{candidate, copy};
+        }
+
+        if (existing->view() == name)
+        {
+            if (!existing->live())
+            {
+                std::optional<Interned> instead;
+                if (!admit(instead))
+                {
+                    return instead;
+                }
+                existing->seen = seen;
+                stripe.dead--;
+                size_.fetch_add(1, std::memory_order_relaxed);
+            }
+            // most lookups of a name fall in the same epoch, only the first writes
+            else if (existing->seen != seen && existing->seen != Name::PINNED)
+            {
+                existing->seen = seen;
+            }
+            return Interned{candidate, existing->view()};
+        }
+
+        candidate = next_candidate(candidate); // hash collision
+    }
+}
+
+std::size_t NameTable::expire(uint64_t epoch, uint64_t keep)
+{
+    epoch_.store(epoch, std::memory_order_relaxed);
+    if (epoch <= keep)
+    {
+        return 0;
+    }
+
+    // dead and pinned names stamp above any epoch, so they are never counted twice
+    uint32_t    oldest  = stamp(epoch - keep);
+    std::size_t expired = 0;
+    for (std::size_t visited = 0; visited < STRIPES_PER_EXPIRE; visited++)
+    {
+        Stripe& stripe = stripes_[next_expire_];
+        next_expire_   = (next_expire_ + 1) % NUM_STRIPES;
+
+        std::lock_guard lock(stripe.mutex);
+        std::size_t     count = 0;
+        stripe.names.for_each(
+            [oldest, &count](uint64_t, Name& entry)
+            {
+                if (entry.seen < oldest)
+                {
+                    entry.seen = Name::DEAD;
+                    count++;
+                }
+            });
+        stripe.dead += count;
+        expired += count;
+
+        // FlatMap has no erase, a rebuild pays off once half the stripe is dead
+        if (stripe.dead * 2 > stripe.names.size())
+        {
+            stripe.compact();
+        }
+    }
+
+    size_.fetch_sub(expired, std::memory_order_relaxed);
+    return expired;
+}
+
+std::optional<uint64_t> NameTable::find(std::string_view name) const
+{
+    uint64_t        hash   = hash_of(name);
+    const Stripe&   stripe = stripes_[hash & STRIPE_MASK];
+    std::lock_guard lock(stripe.mutex);
+
+    uint64_t candidate = hash;
+    while (const Name* existing = stripe.names.find(candidate))
+    {
+        if (existing->view() == name)
+        {
+            return existing->live() ? std::optional(candidate) : std::nullopt;
+        }
+        candidate = next_candidate(candidate);
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string_view> NameTable::name(uint64_t key) const
+{
+    // every candidate keeps the stripe bits of the hash it came from
+    const Stripe&   stripe = stripes_[key & STRIPE_MASK];
+    std::lock_guard lock(stripe.mutex);
+
+    const Name* entry = stripe.names.find(key);
+    if (entry == nullptr || !entry->live())
+    {
+        return std::nullopt;
+    }
+    return entry->view();
+}
+
+std::string_view NameTable::Stripe::copy(std::string_view name)
+{
+    auto* dest = static_cast<char*>(pool.allocate(std::max<std::size_t>(name.size(), 1), 1));
+    std::memcpy(dest, name.data(), name.size());
+    return {dest, name.size()};
+}
+
+void NameTable::Stripe::release(std::string_view name)
+{
+    pool.deallocate(const_cast<char*>(name.data()), std::max<std::size_t>(name.size(), 1), 1);
+}
+
+void NameTable::Stripe::compact()
+{
+    // a name is only found past a colliding one by probing through it, so that one stays
+    auto dropped = [this](uint64_t key, const Name& entry)
+    { return !entry.live() && names.find(next_candidate(key)) == nullptr; };
+
+    std::size_t   kept_dead = 0;
+    FlatMap<Name> kept(names.size() - dead);
+    names.for_each(
+        [this, &dropped, &kept, &kept_dead](uint64_t key, const Name& entry)
+        {
+            if (dropped(key, entry))
+            {
+                release(entry.view());
+                return;
+            }
+            kept.try_emplace(key, entry);
+            kept_dead += entry.live() ? 0 : 1;
+        });
+    names = std::move(kept);
+    dead  = kept_dead;
+}
+
+} // namespace metric_collector::aggregation
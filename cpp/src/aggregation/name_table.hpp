@@ -0,0 +1,172 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_NAME_TABLE_HPP
+#define METRIC_COLLECTOR_AGGREGATION_NAME_TABLE_HPP
+
+#include "flat_map.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+namespace metric_collector::aggregation
+{
+// Interns metric names and hands out the key the metric is stored under. A key is the name's
+// hash unless another name got that hash first, then the next free candidate derived from it,
+// so two names never share a metric no matter how many keys there are. Names are copied into a
+// pool per stripe.
+// The table is striped by the low hash bits and every candidate key keeps them, so a stripe
+// owns a disjoint slice of the key space and only its own lock is needed to hand one out.
+// Every lookup stamps the name with the current epoch, and expire() marks the names no lookup
+// has stamped for a while dead, so the table counts the names in use rather than every name
+// ever seen. A dead name comes back on its next lookup like a new one; a stripe is rebuilt
+// without its dead names once they make up half of it, and views of a name stay valid until
+// then. expire() visits a few stripes per call, so its cost does not grow with the table.
+// Names taken with intern() never expire. The write paths also intern through a Gate that can
+// keep names out.
+class NameTable
+{
+  public:
+    static constexpr std::size_t NUM_STRIPES = 64;
+    // stripes one expire() call visits, round robin
+    static constexpr std::size_t STRIPES_PER_EXPIRE = 8;
+    // calls to expire() until every stripe has been visited
+    static constexpr std::size_t EXPIRE_SWEEP = NUM_STRIPES / STRIPES_PER_EXPIRE;
+
+    struct Interned
+    {
+        uint64_t         key;
+        std::string_view name; // the interned copy
+    };
+
+    // what becomes of a name the table has not seen yet
+    struct Verdict
+    {
+        bool                    admit{true};
+        std::optional<Interned> instead; // if refused, where its samples go; nullopt drops them
+        std::size_t             limit{0}; // if refused, the gate's own id of the limit it hit
+    };
+
+    // Decides on names before they take an entry. check() runs under a stripe lock
+    // with the number of names interned so far and the metric's variant index; it must not
+    // intern anything itself.
+    class Gate
+    {
+      public:
+        virtual ~Gate() = default;
+
+        virtual Verdict check(std::string_view name, std::size_t interned,
+                              std::size_t type) noexcept = 0;
+    };
+
+    NameTable() = default;
+
+    NameTable(const NameTable&)            = delete;
+    NameTable& operator=(const NameTable&) = delete;
+
+    // gate must outlive the table, set before the first write
+    void set_gate(Gate* gate) noexcept { gate_ = gate; }
+
+    // the name is kept for the table's lifetime
+    Interned intern(std::string_view name) { return intern(name, hash_of(name)); }
+
+    // hash must be hash_of(name), for callers that already computed it
+    Interned intern(std::string_view name, uint64_t hash)
+    {
+        return *lookup(name, hash, nullptr, 0, nullptr, true);
+    }
+
+    // as intern(), but a new name has to pass the gate: returns the name's own entry, the one
+    // the gate redirected it to, or nullopt if the gate dropped it. verdict, if given, receives
+    // the gate's verdict on a refused name
+    std::optional<Interned> intern_checked(std::string_view name, uint64_t hash, std::size_t type,
+                                           Verdict* verdict = nullptr)
+    {
+        return lookup(name, hash, gate_, type, verdict, false);
+    }
+
+    // from now on lookups stamp names with epoch, and in the next STRIPES_PER_EXPIRE stripes
+    // names last stamped more than keep epochs before it expire; returns how many. A name
+    // therefore expires between keep and keep + EXPIRE_SWEEP epochs after its last lookup. The
+    // caller makes sure no view of those is used past the stripe's next rebuild
+    std::size_t expire(uint64_t epoch, uint64_t keep);
+
+    [[nodiscard]] std::optional<uint64_t> find(std::string_view name) const;
+
+    // reverse lookup of a live name, the view is valid until the name expires
+    [[nodiscard]] std::optional<std::string_view> name(uint64_t key) const;
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t hash_of(std::string_view name) noexcept
+    {
+        return hash_bytes(name.data(), name.size());
+    }
+
+  private:
+    static constexpr uint64_t STRIPE_MASK = NUM_STRIPES - 1;
+
+    static_assert((NUM_STRIPES & STRIPE_MASK) == 0, "stripes must be a power of two");
+
+    // next key to try when candidate belongs to another name, stays in the same stripe
+    static uint64_t next_candidate(uint64_t candidate) noexcept
+    {
+        return (detail::wy_mix(candidate, detail::WY_P2) & ~STRIPE_MASK) |
+               (candidate & STRIPE_MASK);
+    }
+
+    // as small as the plain view was, the slots stay 24 bytes
+    struct Name
+    {
+        static constexpr uint32_t PINNED = UINT32_MAX;
+        static constexpr uint32_t DEAD   = UINT32_MAX - 1;
+
+        const char* data; // in the stripe's pool
+        uint32_t    size;
+        uint32_t    seen; // epoch of the last lookup, PINNED if it never expires, DEAD if it did
+
+        [[nodiscard]] std::string_view view() const noexcept { return {data, size}; }
+        [[nodiscard]] bool             live() const noexcept { return seen != DEAD; }
+    };
+    static_assert(sizeof(Name) == sizeof(std::string_view));
+
+    // epochs saturate below DEAD, 2^32 rotations outlast any process
+    static uint32_t stamp(uint64_t epoch) noexcept
+    {
+        return static_cast<uint32_t>(std::min<uint64_t>(epoch, Name::DEAD - 1));
+    }
+
+    struct alignas(64) Stripe
+    {
+        mutable std::mutex                     mutex;
+        FlatMap<Name>                          names; // key -> interned name
+        std::size_t                            dead{0};
+        std::pmr::unsynchronized_pool_resource pool;
+
+        std::string_view copy(std::string_view name);
+        void             release(std::string_view name);
+        // rebuilds names without the dead ones no probe has to pass
+        void             compact();
+    };
+
+    std::optional<Interned> lookup(std::string_view name, uint64_t hash, Gate* gate,
+                                   std::size_t type, Verdict* refused, bool pin);
+
+    std::array<Stripe, NUM_STRIPES> stripes_;
+    std::atomic<std::size_t>        size_{0};
+    std::atomic<uint64_t>           epoch_{0};
+    std::size_t                     next_expire_{0}; // stripe the next expire() starts at
+    Gate*                           gate_{nullptr};
+};
+} // namespace metric_collector::aggregation
+
+#endif
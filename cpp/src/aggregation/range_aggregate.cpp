@@ -0,0 +1,209 @@
+#include "range_aggregate.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+
+namespace metric_collector::aggregation
+{
+
+RangeAggregate::RangeAggregate(std::size_t span) : span_(span)
+{
+    if (span_ < 2)
+    {
+        std::cerr << "---> a range covers at least two windows, one is the window's snapshot\n";
+        throw std::runtime_error("range span below 2");
+    }
+}
+
+void RangeAggregate::advance(std::span<const std::shared_ptr<const Snapshot>> history)
+{
+    stale_sets_.clear();
+    if (added_ >= span_ && history.size() > span_)
+    {
+        subtract(*history[history.size() - 1 - span_]);
+    }
+
+    const Snapshot& sealed = *history.back();
+    add(sealed);
+    added_++;
+    epoch_ = sealed.epoch();
+
+    auto covered = history.last(std::min(span_, history.size()));
+    for (uint64_t key : stale_sets_)
+    {
+        if (Entry* entry = entries_.find(key))
+        {
+            rebuild(*entry, covered);
+        }
+    }
+
+    if (dead_ > entries_.size() - dead_)
+    {
+        compact();
+    }
+}
+
+std::shared_ptr<const Snapshot> RangeAggregate::snapshot() const
+{
+    if (added_ < span_)
+    {
+        return nullptr;
+    }
+
+    auto snapshot = std::make_shared<Snapshot>(epoch_, entries_.size() - dead_, span_);
+    entries_.for_each(
+        [&snapshot](uint64_t key, const Entry& entry)
+        {
+            if (entry.live)
+            {
+                snapshot->insert(key, entry.name, entry.value);
+            }
+        });
+    return snapshot;
+}
+
+void RangeAggregate::subtract(const Snapshot& leaving)
+{
+    uint64_t epoch = leaving.epoch();
+    leaving.for_each_keyed(
+        [this, epoch](uint64_t key, std::string_view /*name*/, const MetricValue& value)
+        {
+            Entry* entry = entries_.find(key);
+            // a value started after the leaving window when the name changed type
+            if (entry == nullptr || !entry->live || entry->since > epoch)
+            {
+                return;
+            }
+            if (entry->last == epoch)
+            {
+                entry->live = false; // no window left in the range has the name
+                dead_++;
+                return;
+            }
+
+            std::visit(
+                [this, key, &value](auto& metric)
+                {
+                    using T = std::decay_t<decltype(metric)>;
+
+                    const auto* other = std::get_if<T>(&value.metric);
+                    if (other == nullptr)
+                    {
+                        return;
+                    }
+                    if constexpr (std::same_as<T, Counter>)
+                    {
+                        metric.decrement(other->get());
+                    }
+                    else if constexpr (std::same_as<T, Timer>)
+                    {
+                        metric.subtract(*other);
+                    }
+                    else if constexpr (std::same_as<T, Set>)
+                    {
+                        stale_sets_.push_back(key);
+                    }
+                    // a gauge keeps its value, it came from a newer window
+                },
+                entry->value.metric);
+        });
+}
+
+void RangeAggregate::add(const Snapshot& sealed)
+{
+    uint64_t epoch = sealed.epoch();
+    sealed.for_each_keyed(
+        [this, epoch](uint64_t key, std::string_view name, const MetricValue& value)
+        {
+            Entry* entry = entries_.find(key);
+            if (entry == nullptr)
+            {
+                entries_.try_emplace(key, Entry{std::string(name), value, epoch, epoch, true});
+                return;
+            }
+
+            if (!entry->live)
+            {
+                entry->name.assign(name);
+                entry->value = value;
+                entry->since = epoch;
+                entry->live  = true;
+                dead_--;
+            }
+            else if (entry->value.metric.index() != value.metric.index())
+            {
+                entry->value = value; // the name changed type, the newer window wins
+                entry->since = epoch;
+            }
+            else
+            {
+                std::visit(
+                    [&value](auto& metric)
+                    {
+                        using T = std::decay_t<decltype(metric)>;
+
+                        const auto& other = std::get<T>(value.metric);
+                        if constexpr (std::same_as<T, Counter>)
+                        {
+                            metric.increment(other.get());
+                        }
+                        else if constexpr (std::same_as<T, Gauge>)
+                        {
+                            metric.set(other.get());
+                        }
+                        else
+                        {
+                            metric.merge(other);
+                        }
+                    },
+                    entry->value.metric);
+            }
+            entry->last = epoch;
+        });
+}
+
+void RangeAggregate::rebuild(Entry&                                           entry,
+                             std::span<const std::shared_ptr<const Snapshot>> covered)
+{
+    if (!entry.live || !std::holds_alternative<Set>(entry.value.metric))
+    {
+        return;
+    }
+
+    Set merged;
+    for (const auto& window : covered)
+    {
+        if (window->epoch() < entry.since)
+        {
+            continue;
+        }
+        if (const MetricValue* value = window->find(entry.name))
+        {
+            if (const auto* set = std::get_if<Set>(&value->metric))
+            {
+                merged.merge(*set);
+            }
+        }
+    }
+    entry.value = MetricValue(merged);
+}
+
+void RangeAggregate::compact()
+{
+    FlatMap<Entry> live(entries_.size() - dead_);
+    entries_.for_each(
+        [&live](uint64_t key, Entry& entry)
+        {
+            if (entry.live)
+            {
+                live.try_emplace(key, std::move(entry));
+            }
+        });
+    entries_ = std::move(live);
+    dead_    = 0;
+}
+
+} // namespace metric_collector::aggregation
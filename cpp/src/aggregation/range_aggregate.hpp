@@ -0,0 +1,65 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_RANGE_AGGREGATE_HPP
+#define METRIC_COLLECTOR_AGGREGATION_RANGE_AGGREGATE_HPP
+
+#include "flat_map.hpp"
+#include "metrics.hpp"
+#include "snapshot.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace metric_collector::aggregation
+{
+// Running merge of the last span sealed windows, one per range a BucketRing is configured with.
+// Every rotation adds the window just sealed and takes back the one leaving the range, so the
+// work follows the size of those two windows whatever the span. Counters subtract, timers take
+// back their counts and buckets (the extremes narrow to the bounds of the buckets left), gauges
+// keep the newest value in the range. A HyperLogLog cannot take members back, so a set losing a
+// window is merged again from the windows still covered.
+// Only the rotating thread touches it, readers get the Snapshot it builds.
+class RangeAggregate
+{
+  public:
+    explicit RangeAggregate(std::size_t span);
+
+    // history is oldest first and ends with the window just sealed; it must also hold the window
+    // leaving the range, if any, and the ones before the new window that stay in it
+    void advance(std::span<const std::shared_ptr<const Snapshot>> history);
+
+    // nullptr until span windows have been added
+    [[nodiscard]] std::shared_ptr<const Snapshot> snapshot() const;
+
+    [[nodiscard]] std::size_t span() const noexcept { return span_; }
+
+  private:
+    struct Entry
+    {
+        std::string name;
+        MetricValue value;
+        // first and last window folded into value
+        uint64_t    since;
+        uint64_t    last;
+        // dead entries stay as tombstones until compact(), FlatMap has no erase
+        bool        live;
+    };
+
+    void subtract(const Snapshot& leaving);
+    void add(const Snapshot& sealed);
+    static void rebuild(Entry& entry, std::span<const std::shared_ptr<const Snapshot>> covered);
+    void compact();
+
+    std::size_t           span_;
+    std::size_t           added_{0};
+    uint64_t              epoch_{0};
+    FlatMap<Entry>        entries_;
+    std::size_t           dead_{0};
+    // sets that lost a window in this advance()
+    std::vector<uint64_t> stale_sets_;
+};
+} // namespace metric_collector::aggregation
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_ROTATION_SCHEDULER_HPP
+#define METRIC_COLLECTOR_AGGREGATION_ROTATION_SCHEDULER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace metric_collector::aggregation
+{
+constexpr auto DEFAULT_WINDOW_INTERVAL = std::chrono::seconds(10);
+
+// Rotates a BucketRing on a fixed interval from its own thread. Deadlines are absolute, so a slow
+// rotation does not shift the windows that follow it. after_rotate, if set, runs on the same
+// thread right after every rotation, e.g. to export the window just sealed.
+template <typename Ring> class RotationScheduler
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit RotationScheduler(Ring& ring, Clock::duration interval = DEFAULT_WINDOW_INTERVAL,
+                               std::function<void()> after_rotate = {})
+        : ring_(ring), interval_(interval), after_rotate_(std::move(after_rotate))
+    {
+    }
+
+    ~RotationScheduler() { stop(); }
+
+    RotationScheduler(const RotationScheduler&)            = delete;
+    RotationScheduler& operator=(const RotationScheduler&) = delete;
+
+    void start()
+    {
+        std::lock_guard lock(mutex_);
+        if (thread_.joinable())
+        {
+            return; // already running
+        }
+
+        stopping_ = false;
+        thread_   = std::thread([this]() { run(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_all();
+
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    [[nodiscard]] Clock::duration interval() const noexcept { return interval_; }
+
+  private:
+    void run()
+    {
+        auto deadline = Clock::now() + interval_;
+
+        std::unique_lock lock(mutex_);
+        while (!wakeup_.wait_until(lock, deadline, [this] { return stopping_; }))
+        {
+            lock.unlock();
+            ring_.rotate();
+            if (after_rotate_)
+            {
+                after_rotate_();
+            }
+            lock.lock();
+
+            // skip deadlines that already passed instead of rotating in a burst
+            auto now = Clock::now();
+            do
+            {
+                deadline += interval_;
+            } while (deadline <= now);
+        }
+    }
+
+    Ring&                   ring_;
+    Clock::duration         interval_;
+    std::function<void()>   after_rotate_;
+    std::thread             thread_;
+    std::mutex              mutex_;
+    std::condition_variable wakeup_;
+    bool                    stopping_{false};
+};
+} // namespace metric_collector::aggregation
+
+#endif
@@ -0,0 +1,132 @@
+#include "self_stats.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace metric_collector::aggregation
+{
+struct SelfStats::Registry
+{
+    std::mutex                          mutex;
+    std::vector<std::unique_ptr<Block>> blocks;
+};
+
+SelfStats::Registry& SelfStats::registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+SelfStats::Block* SelfStats::attach()
+{
+    auto& reg = registry();
+
+    std::lock_guard lock(reg.mutex);
+    reg.blocks.push_back(std::make_unique<Block>());
+    reg.blocks.back()->name = "thread" + std::to_string(reg.blocks.size() - 1);
+    return reg.blocks.back().get();
+}
+
+void SelfStats::name_thread(std::string name)
+{
+    auto& block = local();
+
+    std::lock_guard lock(registry().mutex);
+    block.name = std::move(name);
+}
+
+SelfStatsSample SelfStats::read()
+{
+    SelfStatsSample sample;
+    auto&           reg = registry();
+
+    std::lock_guard lock(reg.mutex);
+    for (const auto& block : reg.blocks)
+    {
+        auto it = std::find_if(sample.begin(), sample.end(),
+                               [&block](const ThreadStatsSample& thread)
+                               { return thread.thread == block->name; });
+        if (it == sample.end())
+        {
+            it         = sample.emplace(sample.end());
+            it->thread = block->name;
+        }
+
+        for (std::size_t i = 0; i < SELF_COUNTERS; i++)
+        {
+            it->counters[i] += block->counters[i].load(std::memory_order_relaxed);
+        }
+#ifdef METRIC_COLLECTOR_SELF_STATS
+        for (std::size_t h = 0; h < SELF_HISTOGRAMS; h++)
+        {
+            auto& histogram = it->histograms[h];
+            for (std::size_t b = 0; b < SelfHistogramSample::BUCKETS; b++)
+            {
+                histogram.buckets[b] += block->buckets[h][b].load(std::memory_order_relaxed);
+            }
+            histogram.sum += block->sums[h].load(std::memory_order_relaxed);
+        }
+#endif
+    }
+
+    std::sort(sample.begin(), sample.end(),
+              [](const ThreadStatsSample& lhs, const ThreadStatsSample& rhs)
+              { return lhs.thread < rhs.thread; });
+    return sample;
+}
+
+uint64_t SelfStats::total(SelfCounter counter)
+{
+    auto& reg = registry();
+
+    std::lock_guard lock(reg.mutex);
+    uint64_t        sum = 0;
+    for (const auto& block : reg.blocks)
+    {
+        sum += block->counters[static_cast<std::size_t>(counter)].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+std::string_view SelfStats::name_of(SelfCounter counter) noexcept
+{
+    switch (counter)
+    {
+    case SelfCounter::PacketsReceived:
+        return "packets_received";
+    case SelfCounter::DatagramsTruncated:
+        return "datagrams_truncated";
+    case SelfCounter::LinesParsed:
+        return "lines_parsed";
+    case SelfCounter::ParseErrors:
+        return "parse_errors";
+    case SelfCounter::QueueDrops:
+        return "queue_drops";
+    case SelfCounter::LocalTypeMismatches:
+        return "local_type_mismatches";
+    case SelfCounter::WindowTypeMismatches:
+        return "window_type_mismatches";
+    case SelfCounter::WorkerParks:
+        return "worker_parks";
+    default:
+        return "unknown";
+    }
+}
+
+std::string_view SelfStats::name_of(SelfHistogram histogram) noexcept
+{
+    switch (histogram)
+    {
+    case SelfHistogram::RecvBatch:
+        return "recv_batch";
+    case SelfHistogram::QueueDepth:
+        return "queue_depth";
+    case SelfHistogram::ShardLockWaitNs:
+        return "shard_lock_wait_ns";
+    default:
+        return "unknown";
+    }
+}
+} // namespace metric_collector::aggregation
@@ -0,0 +1,156 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_SELF_STATS_HPP
+#define METRIC_COLLECTOR_AGGREGATION_SELF_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace metric_collector::aggregation
+{
+enum class SelfCounter : uint8_t
+{
+    PacketsReceived,      // datagrams taken off the sockets
+    DatagramsTruncated,   // datagrams longer than the receive buffer, cut at their last line
+    LinesParsed,          // lines that parsed into a metric
+    ParseErrors,          // non empty lines that did not
+    QueueDrops,           // packets a full worker queue turned away
+    LocalTypeMismatches,  // lines a local table dropped, their name holds another type
+    WindowTypeMismatches, // merged entries a window dropped, their name holds another type
+    WorkerParks,          // times a worker ran out of work and went to sleep
+    COUNT
+};
+
+enum class SelfHistogram : uint8_t
+{
+    RecvBatch,       // buffers per recvmmsg call or io_uring poll, a GRO buffer holds several
+    QueueDepth,      // packets in a worker's queue each time it pops some
+    ShardLockWaitNs, // time to take a shard lock, sampled
+    COUNT
+};
+
+constexpr std::size_t SELF_COUNTERS   = static_cast<std::size_t>(SelfCounter::COUNT);
+constexpr std::size_t SELF_HISTOGRAMS = static_cast<std::size_t>(SelfHistogram::COUNT);
+
+// Power of two buckets: bucket i holds the values of bit width i, up to 2^i - 1.
+struct SelfHistogramSample
+{
+    static constexpr std::size_t BUCKETS = 65;
+
+    std::array<uint64_t, BUCKETS> buckets{};
+    uint64_t                      sum{0};
+
+    [[nodiscard]] uint64_t count() const noexcept
+    {
+        uint64_t total = 0;
+        for (auto bucket : buckets)
+        {
+            total += bucket;
+        }
+        return total;
+    }
+};
+
+// One thread's stats as of the read; threads sharing a name are summed.
+struct ThreadStatsSample
+{
+    std::string                                      thread;
+    std::array<uint64_t, SELF_COUNTERS>              counters{};
+    std::array<SelfHistogramSample, SELF_HISTOGRAMS> histograms{};
+};
+
+using SelfStatsSample = std::vector<ThreadStatsSample>;
+
+// The collector's own counters and histograms. Every thread writes to a cache line aligned block
+// of its own with plain relaxed stores, nothing is shared on the write path; read() walks the
+// blocks and sums them up. A thread's block is created on its first write and kept after the
+// thread exits, so totals never go backwards.
+// The counters are the pipeline's only event counts, UdpServer and loadgen read them too, so
+// they are always kept. The histograms and sampled timings are built only with
+// METRIC_COLLECTOR_SELF_STATS, otherwise record() compiles to nothing and sample() says no.
+class SelfStats
+{
+  public:
+    static constexpr uint32_t SAMPLE_EVERY = 256;
+
+    static void add(SelfCounter counter, uint64_t delta = 1)
+    {
+        bump(local().counters[static_cast<std::size_t>(counter)], delta);
+    }
+
+    // one call in SAMPLE_EVERY on the calling thread says yes, for measurements too costly to
+    // take every time; always no without self stats
+    static bool sample() noexcept
+    {
+#ifdef METRIC_COLLECTOR_SELF_STATS
+        return (++ticks_ & (SAMPLE_EVERY - 1)) == 0;
+#else
+        return false;
+#endif
+    }
+
+    static void record(SelfHistogram histogram, uint64_t value)
+    {
+#ifdef METRIC_COLLECTOR_SELF_STATS
+        auto& block = local();
+        auto  index = static_cast<std::size_t>(histogram);
+        bump(block.buckets[index][std::bit_width(value)], 1);
+        bump(block.sums[index], value);
+#else
+        (void)histogram;
+        (void)value;
+#endif
+    }
+
+    // labels the calling thread's stats, e.g. "worker3"
+    static void name_thread(std::string name);
+
+    static SelfStatsSample read();
+
+    // counter summed over every thread, cheaper than read() for a single value
+    static uint64_t total(SelfCounter counter);
+
+    static std::string_view name_of(SelfCounter counter) noexcept;
+    static std::string_view name_of(SelfHistogram histogram) noexcept;
+
+  private:
+    using Buckets = std::array<std::atomic<uint64_t>, SelfHistogramSample::BUCKETS>;
+
+    struct alignas(64) Block
+    {
+        std::string                                        name; // under the registry lock
+        std::array<std::atomic<uint64_t>, SELF_COUNTERS>   counters{};
+        std::array<Buckets, SELF_HISTOGRAMS>               buckets{};
+        std::array<std::atomic<uint64_t>, SELF_HISTOGRAMS> sums{};
+    };
+
+    // only the owning thread writes, readers may see a value a moment old
+    static void bump(std::atomic<uint64_t>& value, uint64_t delta) noexcept
+    {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static Block& local()
+    {
+        if (local_ == nullptr)
+        {
+            local_ = attach();
+        }
+        return *local_;
+    }
+
+    struct Registry;
+
+    static Registry& registry();
+    static Block*    attach();
+
+    static inline thread_local Block*   local_ = nullptr;
+    static inline thread_local uint32_t ticks_ = 0;
+};
+} // namespace metric_collector::aggregation
+
+#endif
@@ -1,18 +1,46 @@
 #include "shard.hpp"
 
+#include <chrono>
+
 namespace metric_collector::aggregation
 {
 
-std::shared_ptr<MetricValue> Shard::get_metric(uint64_t key) const
+std::optional<MetricValue> Shard::get_metric(uint64_t key) const
 {
-    std::lock_guard lock(mutex_);
+    auto lock = acquire();
+
+    const Ref* ref = index_.find(key, key_of());
+    if (ref == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    auto copy = [position = position_of(*ref)](const auto& column)
+    { return MetricValue(column[position].value); };
 
-    auto it = metrics_.find(key);
-    if (it == metrics_.end())
+    switch (type_of(*ref))
     {
-        return nullptr;
+    case metric_index<Counter>():
+        return copy(std::get<Column<Counter>>(columns_));
+    case metric_index<Gauge>():
+        return copy(std::get<Column<Gauge>>(columns_));
+    case metric_index<Timer>():
+        return copy(std::get<Column<Timer>>(columns_));
+    default:
+        return copy(std::get<Column<Set>>(columns_));
     }
-    return it->second;
+}
+
+std::unique_lock<std::mutex> Shard::timed_acquire() const
+{
+    auto             start  = std::chrono::steady_clock::now();
+    std::unique_lock lock(mutex_);
+    auto             waited = std::chrono::steady_clock::now() - start;
+
+    SelfStats::record(SelfHistogram::ShardLockWaitNs,
+                      static_cast<uint64_t>(
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count()));
+    return lock;
 }
 
 } // namespace metric_collector::aggregation
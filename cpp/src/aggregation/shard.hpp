@@ -1,14 +1,40 @@
 #ifndef METRIC_COLLECTOR_AGGREGATION_SHARD_HPP
 #define METRIC_COLLECTOR_AGGREGATION_SHARD_HPP
 
+#include "flat_index.hpp"
 #include "metrics.hpp"
+#include "self_stats.hpp"
+#include "window_arena.hpp"
 
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 #include <mutex>
-#include <unordered_map>
+#include <new>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace metric_collector::aggregation
 {
+enum class StoreResult : uint8_t
+{
+    Stored,
+    TypeMismatch,
+    Refused // the key was new and admit() turned it down
+};
+
+// Metrics are stored column wise, one dense array of (key, name, metric) per type, and the index
+// only holds a 32-bit reference with the type and the position in its column; the key is read
+// back from the column. A counter costs its key, name view and 8 bytes plus an index slot
+// instead of a slot sized for the largest alternative, and scans walk the arrays in order. The
+// name is the interned view the metric was stored under, so a scan needs no NameTable lookup.
+// Timers and sets allocate from the shard's arena, so clear() frees nothing one by one: it drops
+// the index and the columns and rewinds the arena, and all of them keep their memory for the
+// next window.
 class Shard
 {
   public:
@@ -17,34 +43,175 @@ class Shard
     void clear()
     {
         std::lock_guard lock(mutex_);
-        metrics_.clear();
+        index_.clear();
+        std::apply([](auto&... column) { (column.clear(), ...); }, columns_); // keeps capacity
+        arena_.reset();
     }
 
-    [[nodiscard]] std::shared_ptr<MetricValue> get_metric(uint64_t key) const;
+    // readers get a copy taken under the lock
+    [[nodiscard]] std::optional<MetricValue> get_metric(uint64_t key) const;
 
-    template <MetricTypeConcept T> std::shared_ptr<MetricValue> store(uint64_t key)
+    // finds or creates the metric for key and applies func to it under the shard lock, returns
+    // false on a type mismatch; name is the interned name of key and must outlive the window
+    template <MetricTypeConcept T, typename F>
+    bool store(uint64_t key, std::string_view name, F&& func)
     {
-        std::lock_guard lock(mutex_);
+        return store<T>(key, name, []() noexcept { return true; }, std::forward<F>(func)) ==
+               StoreResult::Stored;
+    }
+
+    // as above, but a key the shard does not hold yet is only created if admit() agrees; admit
+    // runs under the shard lock, once per new key
+    template <MetricTypeConcept T, typename A, typename F>
+    StoreResult store(uint64_t key, std::string_view name, A&& admit, F&& func)
+    {
+        auto lock = acquire();
 
-        auto it = metrics_.find(key);
-        if (it != metrics_.end())
+        auto& column = std::get<Column<T>>(columns_);
+
+        const Ref* ref = index_.find(key, key_of());
+        if (ref == nullptr)
         {
-            if (!std::holds_alternative<T>(it->second->metric))
+            if (!admit())
             {
-                return nullptr; // type mismatch
+                return StoreResult::Refused;
             }
-            return it->second;
+            index_.insert(key, make_ref(metric_index<T>(), column.size()), key_of());
+            func(column.emplace_back(key, name, &arena_).value);
+            return StoreResult::Stored;
+        }
+
+        if (type_of(*ref) != metric_index<T>())
+        {
+            return StoreResult::TypeMismatch;
         }
 
-        auto ptr = std::make_shared<MetricValue>(std::in_place_type<T>);
-        metrics_.emplace(key, ptr);
-        return ptr;
+        func(column[position_of(*ref)].value);
+        return StoreResult::Stored;
+    }
+
+    // func(key, name, metric) with the typed metric for every metric, one type after the other
+    // in storage order, under the shard lock
+    template <typename F> void for_each(F&& func) const
+    {
+        std::lock_guard lock(mutex_);
+        std::apply(
+            [&func](const auto&... column)
+            {
+                (
+                    [&func, &column]()
+                    {
+                        for (const auto& entry : column)
+                        {
+                            func(entry.key, entry.name, entry.value);
+                        }
+                    }(),
+                    ...);
+            },
+            columns_);
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        std::lock_guard lock(mutex_);
+        return index_.size();
+    }
+
+    // bytes held by the index, the columns and the arena
+    [[nodiscard]] std::size_t memory_usage() const
+    {
+        std::lock_guard lock(mutex_);
+        return index_.memory_usage() + arena_.reserved() +
+               std::apply([](const auto&... column)
+                          { return ((column.capacity() * sizeof(column[0])) + ...); },
+                          columns_);
     }
 
   private:
-    std::unordered_map<uint64_t, std::shared_ptr<MetricValue>> metrics_;
-    mutable std::mutex                                         mutex_;
+    // the shard lock for stores and lookups; with self stats one acquisition in
+    // SelfStats::SAMPLE_EVERY is timed, a try_lock first would cost more on every uncontended one
+    std::unique_lock<std::mutex> acquire() const
+    {
+        if (SelfStats::sample())
+        {
+            return timed_acquire();
+        }
+        return std::unique_lock(mutex_);
+    }
+
+    // out of line so the timing code stays off the inlined fast path
+    std::unique_lock<std::mutex> timed_acquire() const;
+
+    // type in the low bits, position in its column above them
+    using Ref = FlatIndex::Ref;
+
+    static constexpr unsigned TYPE_BITS = 2;
+    static_assert(std::variant_size_v<MetricVariant> <= (1U << TYPE_BITS));
+
+    static Ref make_ref(std::size_t type, std::size_t position) noexcept
+    {
+        return static_cast<Ref>((position << TYPE_BITS) | type);
+    }
+    static std::size_t type_of(Ref ref) noexcept { return ref & ((1U << TYPE_BITS) - 1); }
+    static std::size_t position_of(Ref ref) noexcept { return ref >> TYPE_BITS; }
+
+    // the key sits next to its metric, so the index probe and the update touch one line. The
+    // metric's destructor never runs: all it can own is arena memory, which clear() takes back
+    // wholesale, so dropping a column is O(1) whatever its types
+    template <MetricTypeConcept T> struct Entry
+    {
+        Entry(uint64_t k, std::string_view n, std::pmr::memory_resource* arena) : key(k), name(n)
+        {
+            if constexpr (std::is_constructible_v<T, std::pmr::memory_resource*>)
+            {
+                ::new (&value) T(arena);
+            }
+            else
+            {
+                ::new (&value) T();
+            }
+        }
+        Entry(Entry&& other) noexcept : key(other.key), name(other.name)
+        {
+            ::new (&value) T(std::move(other.value));
+        }
+        Entry& operator=(Entry&&) = delete;
+        ~Entry() {}
+
+        uint64_t         key;
+        std::string_view name;
+        union
+        {
+            T value;
+        };
+    };
+
+    template <MetricTypeConcept T> using Column = std::vector<Entry<T>>;
+
+    auto key_of() const noexcept
+    {
+        return [this](Ref ref)
+        {
+            std::size_t position = position_of(ref);
+            switch (type_of(ref))
+            {
+            case metric_index<Counter>():
+                return std::get<Column<Counter>>(columns_)[position].key;
+            case metric_index<Gauge>():
+                return std::get<Column<Gauge>>(columns_)[position].key;
+            case metric_index<Timer>():
+                return std::get<Column<Timer>>(columns_)[position].key;
+            default:
+                return std::get<Column<Set>>(columns_)[position].key;
+            }
+        };
+    }
+
+    WindowArena                                                           arena_;
+    FlatIndex                                                             index_;
+    std::tuple<Column<Counter>, Column<Gauge>, Column<Timer>, Column<Set>> columns_;
+    mutable std::mutex                                                    mutex_;
 };
 } // namespace metric_collector::aggregation
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,52 @@
+#include "snapshot.hpp"
+
+#include "name_table.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace metric_collector::aggregation
+{
+
+void Snapshot::insert(uint64_t key, std::string_view name, MetricValue value)
+{
+    auto* copy = static_cast<char*>(names_.allocate(name.size(), 1));
+    std::memcpy(copy, name.data(), name.size());
+    name = {copy, name.size()};
+
+    entries_.try_emplace(key, Entry{name, std::move(value)});
+    if (key != NameTable::hash_of(name))
+    {
+        displaced_.push_back(key);
+    }
+}
+
+const MetricValue* Snapshot::find(std::string_view name) const noexcept
+{
+    const Entry* entry = entries_.find(NameTable::hash_of(name));
+    if (entry != nullptr && entry->name == name)
+    {
+        return &entry->value;
+    }
+
+    for (uint64_t key : displaced_)
+    {
+        entry = entries_.find(key);
+        if (entry->name == name)
+        {
+            return &entry->value;
+        }
+    }
+    return nullptr;
+}
+
+void Snapshot::find_many(std::span<const std::string_view> names,
+                         std::span<const MetricValue*>     out) const noexcept
+{
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        out[i] = find(names[i]);
+    }
+}
+
+} // namespace metric_collector::aggregation
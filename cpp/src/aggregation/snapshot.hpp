@@ -0,0 +1,77 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_SNAPSHOT_HPP
+#define METRIC_COLLECTOR_AGGREGATION_SNAPSHOT_HPP
+
+#include "flat_map.hpp"
+#include "metrics.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace metric_collector::aggregation
+{
+// Immutable copy of one or more consecutive sealed windows, built from a window or a
+// RangeAggregate and shared with readers through a shared_ptr. Lookups touch no lock at all,
+// neither the shards' nor the NameTable's: entries are keyed by the interned key, which is the
+// name's hash for all but the rare names that lost their hash to another one, and those are also
+// listed in displaced_. Names are copied in, so a snapshot may outlive the ring.
+class Snapshot
+{
+  public:
+    struct Entry
+    {
+        std::string_view name; // points into names_
+        MetricValue      value;
+    };
+
+    Snapshot(uint64_t epoch, std::size_t expected, std::size_t span = 1)
+        : epoch_(epoch), span_(span), entries_(expected)
+    {
+    }
+
+    Snapshot(const Snapshot&)            = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    // only while building, before the snapshot is published; name is copied
+    void insert(uint64_t key, std::string_view name, MetricValue value);
+
+    [[nodiscard]] const MetricValue* find(std::string_view name) const noexcept;
+
+    // out[i] is the value of names[i] or nullptr, out must be at least as long as names
+    void find_many(std::span<const std::string_view> names,
+                   std::span<const MetricValue*>     out) const noexcept;
+
+    // func(name, value) for every metric covered
+    template <typename F> void for_each(F&& func) const
+    {
+        entries_.for_each([&func](uint64_t /*key*/, const Entry& entry)
+                          { func(entry.name, entry.value); });
+    }
+
+    // func(key, name, value) with the interned key, for merging snapshots of one ring
+    template <typename F> void for_each_keyed(F&& func) const
+    {
+        entries_.for_each([&func](uint64_t key, const Entry& entry)
+                          { func(key, entry.name, entry.value); });
+    }
+
+    // rotation that sealed the newest window covered
+    [[nodiscard]] uint64_t    epoch() const noexcept { return epoch_; }
+    // number of windows covered
+    [[nodiscard]] std::size_t span() const noexcept { return span_; }
+    [[nodiscard]] std::size_t size() const noexcept { return entries_.size(); }
+
+  private:
+    uint64_t                            epoch_;
+    std::size_t                         span_;
+    FlatMap<Entry>                      entries_;
+    std::vector<uint64_t>               displaced_;
+    std::pmr::monotonic_buffer_resource names_;
+};
+} // namespace metric_collector::aggregation
+
+#endif
@@ -0,0 +1,403 @@
+#include "snapshot_file.hpp"
+
+#include "metrics.hpp"
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <variant>
+
+namespace metric_collector::aggregation
+{
+namespace fmt = snapshot_format;
+
+// Types[i] is written straight from the variant index
+static_assert(std::is_same_v<std::variant_alternative_t<0, MetricVariant>, Counter> &&
+              static_cast<uint8_t>(fmt::Type::Counter) == 0);
+static_assert(std::is_same_v<std::variant_alternative_t<1, MetricVariant>, Gauge> &&
+              static_cast<uint8_t>(fmt::Type::Gauge) == 1);
+static_assert(std::is_same_v<std::variant_alternative_t<2, MetricVariant>, Timer> &&
+              static_cast<uint8_t>(fmt::Type::Timer) == 2);
+static_assert(std::is_same_v<std::variant_alternative_t<3, MetricVariant>, Set> &&
+              static_cast<uint8_t>(fmt::Type::Set) == 3);
+static_assert(std::variant_size_v<MetricVariant> == 4, "new metric types need a format version");
+
+namespace
+{
+std::size_t align_up(std::size_t offset) noexcept
+{
+    return (offset + fmt::COLUMN_ALIGN - 1) & ~(fmt::COLUMN_ALIGN - 1);
+}
+
+template <typename T> T* column_ptr(std::byte* base, const fmt::Header& header, fmt::ColumnId id)
+{
+    return reinterpret_cast<T*>(base + header.columns[static_cast<std::size_t>(id)].offset);
+}
+
+// unmaps and closes whatever is still held when the write bails out
+struct Mapping
+{
+    int         fd{-1};
+    void*       addr{MAP_FAILED};
+    std::size_t size{0};
+
+    ~Mapping()
+    {
+        if (addr != MAP_FAILED)
+        {
+            munmap(addr, size);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+};
+} // namespace
+
+SnapshotFileWriter::SnapshotFileWriter(std::string path)
+    : path_(std::move(path)), tmp_path_(path_ + ".tmp")
+{
+}
+
+bool SnapshotFileWriter::write(const Snapshot& snapshot)
+{
+    rows_.clear();
+    snapshot.for_each([this](std::string_view name, const MetricValue& value)
+                      { rows_.emplace_back(name, &value); });
+    std::sort(rows_.begin(), rows_.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+    std::size_t counts[fmt::NUM_COLUMNS] = {};
+    std::size_t per_type[4]              = {};
+    for (const auto& [name, value] : rows_)
+    {
+        counts[static_cast<std::size_t>(fmt::ColumnId::NameBytes)] += name.size();
+        per_type[value->metric.index()]++;
+    }
+
+    counts[static_cast<std::size_t>(fmt::ColumnId::NameOffsets)]  = rows_.size() + 1;
+    counts[static_cast<std::size_t>(fmt::ColumnId::Types)]        = rows_.size();
+    counts[static_cast<std::size_t>(fmt::ColumnId::Rows)]         = rows_.size();
+    counts[static_cast<std::size_t>(fmt::ColumnId::CounterValue)] = per_type[0];
+    counts[static_cast<std::size_t>(fmt::ColumnId::GaugeValue)]   = per_type[1];
+    for (auto id = static_cast<std::size_t>(fmt::ColumnId::TimerCount);
+         id <= static_cast<std::size_t>(fmt::ColumnId::TimerP99); id++)
+    {
+        counts[id] = per_type[2];
+    }
+    counts[static_cast<std::size_t>(fmt::ColumnId::SetCount)]  = per_type[3];
+    counts[static_cast<std::size_t>(fmt::ColumnId::TimerP999)] = per_type[2];
+
+    fmt::Header header{};
+    header.magic       = fmt::MAGIC;
+    header.version     = fmt::VERSION;
+    header.header_size = fmt::HEADER_SIZE;
+    header.epoch       = snapshot.epoch();
+    header.span        = static_cast<uint32_t>(snapshot.span());
+    header.num_metrics = static_cast<uint32_t>(rows_.size());
+    header.num_columns = fmt::NUM_COLUMNS;
+
+    std::size_t offset = fmt::HEADER_SIZE;
+    for (std::size_t id = 0; id < fmt::NUM_COLUMNS; id++)
+    {
+        offset             = align_up(offset);
+        header.columns[id] = {offset, counts[id]};
+        offset += counts[id] * fmt::element_size(static_cast<fmt::ColumnId>(id));
+    }
+    header.file_size = align_up(offset);
+
+    Mapping file;
+    file.size = header.file_size;
+    file.fd   = open(tmp_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file.fd < 0 || ftruncate(file.fd, static_cast<off_t>(file.size)) != 0)
+    {
+        std::cerr << "---> cannot create " << tmp_path_ << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    file.addr = mmap(nullptr, file.size, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+    if (file.addr == MAP_FAILED)
+    {
+        std::cerr << "---> mmap() of " << tmp_path_ << " failed: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    auto* base = static_cast<std::byte*>(file.addr);
+    std::memcpy(base, &header, sizeof(header));
+
+    auto* name_offsets = column_ptr<uint32_t>(base, header, fmt::ColumnId::NameOffsets);
+    auto* name_bytes   = column_ptr<char>(base, header, fmt::ColumnId::NameBytes);
+    auto* types        = column_ptr<uint8_t>(base, header, fmt::ColumnId::Types);
+    auto* row_index    = column_ptr<uint32_t>(base, header, fmt::ColumnId::Rows);
+
+    uint32_t    name_offset = 0;
+    std::size_t next[4]     = {};
+    for (std::size_t row = 0; row < rows_.size(); row++)
+    {
+        const auto& [name, value] = rows_[row];
+
+        name_offsets[row] = name_offset;
+        std::memcpy(name_bytes + name_offset, name.data(), name.size());
+        name_offset += static_cast<uint32_t>(name.size());
+
+        auto type      = value->metric.index();
+        auto index     = next[type]++;
+        types[row]     = static_cast<uint8_t>(type);
+        row_index[row] = static_cast<uint32_t>(index);
+
+        auto put = [base, &header, index](fmt::ColumnId id, uint64_t v)
+        { column_ptr<uint64_t>(base, header, id)[index] = v; };
+
+        std::visit(
+            [&put](const auto& metric)
+            {
+                using T = std::decay_t<decltype(metric)>;
+                if constexpr (std::same_as<T, Counter>)
+                {
+                    put(fmt::ColumnId::CounterValue, metric.get());
+                }
+                else if constexpr (std::same_as<T, Gauge>)
+                {
+                    put(fmt::ColumnId::GaugeValue, metric.get());
+                }
+                else if constexpr (std::same_as<T, Timer>)
+                {
+                    put(fmt::ColumnId::TimerCount, metric.count());
+                    put(fmt::ColumnId::TimerSum, metric.sum());
+                    put(fmt::ColumnId::TimerMin, metric.count() == 0 ? 0 : metric.min());
+                    put(fmt::ColumnId::TimerMax, metric.max());
+                    put(fmt::ColumnId::TimerP50, metric.percentile(0.50));
+                    put(fmt::ColumnId::TimerP90, metric.percentile(0.90));
+                    put(fmt::ColumnId::TimerP99, metric.percentile(0.99));
+                    put(fmt::ColumnId::TimerP999, metric.percentile(0.999));
+                }
+                else
+                {
+                    put(fmt::ColumnId::SetCount, metric.count());
+                }
+            },
+            value->metric);
+    }
+    name_offsets[rows_.size()] = name_offset;
+
+    // readers only ever open the renamed file, which is complete by then
+    if (rename(tmp_path_.c_str(), path_.c_str()) != 0)
+    {
+        std::cerr << "---> rename() to " << path_ << " failed: " << strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+SnapshotFileReader::SnapshotFileReader(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::cerr << "---> cannot open " << path << ": " << strerror(errno) << "\n";
+        throw std::runtime_error("cannot open snapshot file");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < fmt::HEADER_SIZE)
+    {
+        close(fd);
+        std::cerr << "---> " << path << " is too short for a snapshot header\n";
+        throw std::runtime_error("snapshot file too short");
+    }
+
+    size_      = static_cast<std::size_t>(st.st_size);
+    void* addr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (addr == MAP_FAILED)
+    {
+        std::cerr << "---> mmap() of " << path << " failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("mmap() failed");
+    }
+    base_ = static_cast<const std::byte*>(addr);
+
+    try
+    {
+        validate();
+    }
+    catch (const std::runtime_error&)
+    {
+        munmap(const_cast<std::byte*>(base_), size_);
+        throw;
+    }
+}
+
+SnapshotFileReader::~SnapshotFileReader()
+{
+    munmap(const_cast<std::byte*>(base_), size_);
+}
+
+void SnapshotFileReader::validate() const
+{
+    auto fail = [](const char* what)
+    {
+        std::cerr << "---> invalid snapshot file: " << what << "\n";
+        throw std::runtime_error(what);
+    };
+
+    const auto& hdr = header();
+    if (hdr.magic != fmt::MAGIC)
+    {
+        fail("bad magic");
+    }
+    if (hdr.version != fmt::VERSION)
+    {
+        fail("unsupported version");
+    }
+    if (hdr.header_size < fmt::HEADER_SIZE || hdr.num_columns < fmt::NUM_COLUMNS)
+    {
+        fail("header too small");
+    }
+    if (hdr.file_size != size_)
+    {
+        fail("file size mismatch");
+    }
+
+    for (std::size_t id = 0; id < fmt::NUM_COLUMNS; id++)
+    {
+        const auto& col  = hdr.columns[id];
+        auto        elem = fmt::element_size(static_cast<fmt::ColumnId>(id));
+        if (col.offset % fmt::COLUMN_ALIGN != 0 || col.offset < hdr.header_size ||
+            col.offset > size_ || col.count > (size_ - col.offset) / elem)
+        {
+            fail("column out of bounds");
+        }
+    }
+
+    auto count = [&hdr](fmt::ColumnId id)
+    { return hdr.columns[static_cast<std::size_t>(id)].count; };
+
+    std::size_t rows = hdr.num_metrics;
+    if (count(fmt::ColumnId::NameOffsets) != rows + 1 || count(fmt::ColumnId::Types) != rows ||
+        count(fmt::ColumnId::Rows) != rows)
+    {
+        fail("row columns disagree");
+    }
+    for (auto id = static_cast<std::size_t>(fmt::ColumnId::TimerSum);
+         id <= static_cast<std::size_t>(fmt::ColumnId::TimerP99); id++)
+    {
+        if (hdr.columns[id].count != count(fmt::ColumnId::TimerCount))
+        {
+            fail("timer columns disagree");
+        }
+    }
+    if (count(fmt::ColumnId::TimerP999) != count(fmt::ColumnId::TimerCount))
+    {
+        fail("timer columns disagree");
+    }
+
+    // every accessor below trusts these
+    auto offsets = column<uint32_t>(fmt::ColumnId::NameOffsets);
+    if (offsets[0] != 0 || offsets[rows] > count(fmt::ColumnId::NameBytes))
+    {
+        fail("name offsets out of bounds");
+    }
+
+    const fmt::ColumnId value_column[] = {fmt::ColumnId::CounterValue,
+                                          fmt::ColumnId::GaugeValue, fmt::ColumnId::TimerCount,
+                                          fmt::ColumnId::SetCount};
+    // with the ends in bounds, non-decreasing offsets keep every name inside the bytes
+    for (std::size_t row = 0; row < rows; row++)
+    {
+        if (offsets[row] > offsets[row + 1])
+        {
+            fail("name offsets not sorted");
+        }
+    }
+
+    auto types = column<uint8_t>(fmt::ColumnId::Types);
+    for (std::size_t row = 0; row < rows; row++)
+    {
+        if (row > 0 && !(name(row - 1) < name(row)))
+        {
+            fail("names not sorted"); // find() searches them
+        }
+        if (types[row] >= std::size(value_column))
+        {
+            fail("unknown metric type");
+        }
+        if (row_index(row) >= count(value_column[types[row]]))
+        {
+            fail("row index out of bounds");
+        }
+    }
+}
+
+std::optional<std::size_t> SnapshotFileReader::find(std::string_view name) const noexcept
+{
+    std::size_t lo = 0;
+    std::size_t hi = size();
+    while (lo < hi)
+    {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (this->name(mid) < name)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo < size() && this->name(lo) == name)
+    {
+        return lo;
+    }
+    return std::nullopt;
+}
+
+std::string_view SnapshotFileReader::name(std::size_t row) const noexcept
+{
+    auto offsets = column<uint32_t>(fmt::ColumnId::NameOffsets);
+    auto bytes   = column<char>(fmt::ColumnId::NameBytes);
+    return {bytes.data() + offsets[row], offsets[row + 1] - offsets[row]};
+}
+
+SnapshotFileReader::Type SnapshotFileReader::type(std::size_t row) const noexcept
+{
+    return static_cast<Type>(column<uint8_t>(fmt::ColumnId::Types)[row]);
+}
+
+uint64_t SnapshotFileReader::value(std::size_t row) const noexcept
+{
+    switch (type(row))
+    {
+    case Type::Counter:
+        return column<uint64_t>(fmt::ColumnId::CounterValue)[row_index(row)];
+    case Type::Gauge:
+        return column<uint64_t>(fmt::ColumnId::GaugeValue)[row_index(row)];
+    case Type::Timer:
+        return column<uint64_t>(fmt::ColumnId::TimerCount)[row_index(row)];
+    case Type::Set:
+        return column<uint64_t>(fmt::ColumnId::SetCount)[row_index(row)];
+    }
+    return 0;
+}
+
+SnapshotFileReader::TimerSummary SnapshotFileReader::timer(std::size_t row) const noexcept
+{
+    auto index = row_index(row);
+    auto get   = [this, index](fmt::ColumnId id) { return column<uint64_t>(id)[index]; };
+
+    return {get(fmt::ColumnId::TimerCount), get(fmt::ColumnId::TimerSum),
+            get(fmt::ColumnId::TimerMin),   get(fmt::ColumnId::TimerMax),
+            get(fmt::ColumnId::TimerP50),   get(fmt::ColumnId::TimerP90),
+            get(fmt::ColumnId::TimerP99),   get(fmt::ColumnId::TimerP999)};
+}
+
+} // namespace metric_collector::aggregation
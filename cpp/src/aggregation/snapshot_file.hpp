@@ -0,0 +1,106 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_SNAPSHOT_FILE_HPP
+#define METRIC_COLLECTOR_AGGREGATION_SNAPSHOT_FILE_HPP
+
+#include "snapshot_format.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace metric_collector::aggregation
+{
+struct MetricValue;
+class Snapshot;
+
+// Exports snapshots in the snapshot_format layout, meant for a tmpfs path like /dev/shm so
+// the file never reaches a disk. Every write builds the next file in place through a mapping
+// and renames it over the previous one.
+class SnapshotFileWriter
+{
+  public:
+    explicit SnapshotFileWriter(std::string path);
+
+    // false (and logged) if the file could not be written, the previous one stays in place
+    bool write(const Snapshot& snapshot);
+
+    [[nodiscard]] const std::string& path() const noexcept { return path_; }
+
+  private:
+    std::string path_;
+    std::string tmp_path_;
+
+    // reused across writes
+    std::vector<std::pair<std::string_view, const MetricValue*>> rows_;
+};
+
+// Maps an exported file read only and serves it in place, no value is copied out of the
+// mapping. Throws if the file is missing or not a valid snapshot of a known version.
+class SnapshotFileReader
+{
+  public:
+    using Type = snapshot_format::Type;
+
+    struct TimerSummary
+    {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t min;
+        uint64_t max;
+        uint64_t p50;
+        uint64_t p90;
+        uint64_t p99;
+        uint64_t p999;
+    };
+
+    explicit SnapshotFileReader(const std::string& path);
+    ~SnapshotFileReader();
+
+    SnapshotFileReader(const SnapshotFileReader&)            = delete;
+    SnapshotFileReader& operator=(const SnapshotFileReader&) = delete;
+
+    [[nodiscard]] uint64_t    epoch() const noexcept { return header().epoch; }
+    [[nodiscard]] uint32_t    span() const noexcept { return header().span; }
+    [[nodiscard]] std::size_t size() const noexcept { return header().num_metrics; }
+
+    // row of name, binary search over the sorted names
+    [[nodiscard]] std::optional<std::size_t> find(std::string_view name) const noexcept;
+
+    [[nodiscard]] std::string_view name(std::size_t row) const noexcept;
+    [[nodiscard]] Type             type(std::size_t row) const noexcept;
+
+    // counter or gauge value, set cardinality, or the number of samples of a timer
+    [[nodiscard]] uint64_t     value(std::size_t row) const noexcept;
+    [[nodiscard]] TimerSummary timer(std::size_t row) const noexcept;
+
+    // a whole column in place, e.g. column<uint64_t>(ColumnId::CounterValue)
+    template <typename T>
+    [[nodiscard]] std::span<const T> column(snapshot_format::ColumnId id) const noexcept
+    {
+        const auto& column = header().columns[static_cast<std::size_t>(id)];
+        return {reinterpret_cast<const T*>(base_ + column.offset), column.count};
+    }
+
+  private:
+    [[nodiscard]] const snapshot_format::Header& header() const noexcept
+    {
+        return *reinterpret_cast<const snapshot_format::Header*>(base_);
+    }
+
+    [[nodiscard]] uint32_t row_index(std::size_t row) const noexcept
+    {
+        return column<uint32_t>(snapshot_format::ColumnId::Rows)[row];
+    }
+
+    void validate() const;
+
+    const std::byte* base_{nullptr};
+    std::size_t      size_{0};
+};
+} // namespace metric_collector::aggregation
+
+#endif
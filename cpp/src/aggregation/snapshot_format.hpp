@@ -0,0 +1,118 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_SNAPSHOT_FORMAT_HPP
+#define METRIC_COLLECTOR_AGGREGATION_SNAPSHOT_FORMAT_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace metric_collector::aggregation::snapshot_format
+{
+// On-disk layout of a sealed window exported for other processes, e.g. the Go control plane,
+// which map the file read only and use it in place. Everything is little endian and fixed width.
+//
+//   Header        at offset 0, HEADER_SIZE bytes, including the column table
+//   columns       each at Column::offset, COLUMN_ALIGN aligned, Column::count elements
+//
+// Rows are the metrics sorted by name (bytewise), so a reader binary searches the name column.
+// Row i is named NameBytes[NameOffsets[i] .. NameOffsets[i + 1]), has type Types[i] and its
+// value sits at index Rows[i] of the value columns of that type. Timers are summarised into
+// count, sum, min, max and the p50, p90, p99 and p999 percentiles, sets into their estimated
+// cardinality.
+//
+// A file is written next to its final path and renamed over it, so a reader never sees a
+// partial file and a mapping stays valid after the next window replaces the file.
+// Readers must reject a different MAGIC or VERSION; columns may only be appended, with
+// num_columns telling readers how many the writer knew about.
+
+constexpr uint64_t    MAGIC        = 0x31'30'50'41'4e'53'43'4d; // "MCSNAP01" read as bytes
+constexpr uint32_t    VERSION      = 1;
+constexpr std::size_t COLUMN_ALIGN = 8;
+
+// value of Types[i], same order as MetricType
+enum class Type : uint8_t
+{
+    Counter = 0,
+    Gauge   = 1,
+    Timer   = 2,
+    Set     = 3,
+};
+
+// index into Header::columns and the element type stored there
+enum class ColumnId : uint32_t
+{
+    NameOffsets,  // uint32_t, num_metrics + 1 entries
+    NameBytes,    // char
+    Types,        // Type
+    Rows,         // uint32_t, index into the value columns of the row's type
+    CounterValue, // uint64_t
+    GaugeValue,   // uint64_t
+    TimerCount,   // uint64_t, the timer columns all have one entry per timer
+    TimerSum,     // uint64_t
+    TimerMin,     // uint64_t
+    TimerMax,     // uint64_t
+    TimerP50,     // uint64_t
+    TimerP90,     // uint64_t
+    TimerP99,     // uint64_t
+    SetCount,     // uint64_t
+    TimerP999,    // uint64_t, appended after SetCount, one entry per timer like the others
+    Count
+};
+
+constexpr std::size_t NUM_COLUMNS = static_cast<std::size_t>(ColumnId::Count);
+
+struct Column
+{
+    uint64_t offset; // from the start of the file
+    uint64_t count;  // elements, not bytes
+};
+
+struct Header
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t file_size;
+    uint64_t epoch;       // rotation that sealed the newest window covered
+    uint32_t span;        // windows covered
+    uint32_t num_metrics; // rows
+    uint32_t num_columns;
+    uint32_t reserved;
+    Column   columns[NUM_COLUMNS];
+};
+
+constexpr std::size_t HEADER_SIZE = sizeof(Header);
+
+// bytes per element of a column
+constexpr std::size_t element_size(ColumnId id) noexcept
+{
+    switch (id)
+    {
+    case ColumnId::NameOffsets:
+    case ColumnId::Rows:
+        return sizeof(uint32_t);
+    case ColumnId::NameBytes:
+    case ColumnId::Types:
+        return 1;
+    default:
+        return sizeof(uint64_t);
+    }
+}
+
+// the layout is shared with code that never sees these headers, pin it
+static_assert(std::endian::native == std::endian::little, "the format is little endian");
+static_assert(sizeof(Column) == 16);
+static_assert(offsetof(Header, magic) == 0);
+static_assert(offsetof(Header, version) == 8);
+static_assert(offsetof(Header, header_size) == 12);
+static_assert(offsetof(Header, file_size) == 16);
+static_assert(offsetof(Header, epoch) == 24);
+static_assert(offsetof(Header, span) == 32);
+static_assert(offsetof(Header, num_metrics) == 36);
+static_assert(offsetof(Header, num_columns) == 40);
+static_assert(offsetof(Header, columns) == 48);
+static_assert(NUM_COLUMNS == 15, "new columns go at the end and bump nothing else");
+static_assert(HEADER_SIZE == 48 + 15 * 16);
+static_assert(HEADER_SIZE % COLUMN_ALIGN == 0);
+} // namespace metric_collector::aggregation::snapshot_format
+
+#endif
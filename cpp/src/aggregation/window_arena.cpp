@@ -0,0 +1,72 @@
+#include "window_arena.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+
+namespace metric_collector::aggregation
+{
+
+WindowArena::~WindowArena()
+{
+    for (const auto& chunk : chunks_)
+    {
+        munmap(chunk.data, chunk.size);
+    }
+}
+
+void* WindowArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    while (true)
+    {
+        if (current_ < chunks_.size())
+        {
+            const Chunk& chunk = chunks_[current_];
+
+            std::size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+            if (start + bytes <= chunk.size)
+            {
+                offset_ = start + bytes;
+                return chunk.data + start;
+            }
+
+            if (current_ + 1 < chunks_.size())
+            {
+                current_++; // a chunk kept from an earlier window
+                offset_ = 0;
+                continue;
+            }
+        }
+
+        map_chunk(bytes + alignment);
+        current_ = chunks_.size() - 1;
+        offset_  = 0;
+    }
+}
+
+void WindowArena::map_chunk(std::size_t at_least)
+{
+    std::size_t size = chunks_.empty() ? FIRST_CHUNK : std::min(chunks_.back().size * 2, MAX_CHUNK);
+    size             = std::max(size, at_least);
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        std::cerr << "---> mmap() of a " << size << " byte arena chunk failed: " << strerror(errno)
+                  << "\n";
+        throw std::bad_alloc();
+    }
+
+    if (size >= HUGE_PAGE)
+    {
+        madvise(data, size, MADV_HUGEPAGE); // best effort, THP may be disabled
+    }
+
+    chunks_.push_back({static_cast<std::byte*>(data), size});
+    reserved_ += size;
+}
+
+} // namespace metric_collector::aggregation
@@ -0,0 +1,62 @@
+#ifndef METRIC_COLLECTOR_AGGREGATION_WINDOW_ARENA_HPP
+#define METRIC_COLLECTOR_AGGREGATION_WINDOW_ARENA_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace metric_collector::aggregation
+{
+// Monotonic memory for everything a window's metrics allocate, histogram buckets and set
+// registers. Allocation bumps a pointer through mmap'd chunks that double in size, chunks from
+// HUGE_PAGE up are advised to be backed by transparent huge pages, deallocate() does nothing
+// and reset() rewinds to the first chunk while keeping all of them, so the next window reuses
+// the memory without any per allocation work.
+// Not thread safe, owners serialise access.
+class WindowArena : public std::pmr::memory_resource
+{
+  public:
+    static constexpr std::size_t FIRST_CHUNK = std::size_t{64} << 10;
+    static constexpr std::size_t MAX_CHUNK   = std::size_t{64} << 20;
+    static constexpr std::size_t HUGE_PAGE   = std::size_t{2} << 20;
+
+    WindowArena() = default;
+    ~WindowArena() override;
+
+    WindowArena(const WindowArena&)            = delete;
+    WindowArena& operator=(const WindowArena&) = delete;
+
+    // everything handed out so far is gone, the chunks stay mapped
+    void reset() noexcept
+    {
+        current_ = 0;
+        offset_  = 0;
+    }
+
+    // bytes mapped
+    [[nodiscard]] std::size_t reserved() const noexcept { return reserved_; }
+
+  private:
+    struct Chunk
+    {
+        std::byte*  data;
+        std::size_t size;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void  do_deallocate(void* /*p*/, std::size_t /*bytes*/, std::size_t /*alignment*/) override {}
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    void map_chunk(std::size_t at_least);
+
+    std::vector<Chunk> chunks_;
+    std::size_t        current_{0}; // chunk being bumped through
+    std::size_t        offset_{0};
+    std::size_t        reserved_{0};
+};
+} // namespace metric_collector::aggregation
+
+#endif
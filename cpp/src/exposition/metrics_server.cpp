@@ -0,0 +1,310 @@
+#include "metrics_server.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace metric_collector::exposition
+{
+MetricsServer::MetricsServer(uint16_t port, const std::string& addr, const PrometheusPage& page)
+    : page_(page)
+{
+    auto not_found  = std::make_shared<Page>();
+    not_found->body = "not found\n";
+    not_found->head = "HTTP/1.1 404 Not Found\r\n"
+                      "Content-Type: text/plain\r\n"
+                      "Connection: close\r\n"
+                      "Content-Length: " +
+                      std::to_string(not_found->body.size()) + "\r\n\r\n";
+    not_found_ = std::move(not_found);
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0)
+    {
+        std::cerr << "---> socket() failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("socket() failed");
+    }
+
+    int yes = 1;
+    if (setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0)
+    {
+        std::cerr << "---> setsockopt(SO_REUSEADDR) failed: " << strerror(errno) << "\n";
+        close(listen_fd_);
+        throw std::runtime_error("setsockopt(SO_REUSEADDR) failed");
+    }
+
+    struct sockaddr_in sock_addr;
+    memset(&sock_addr, 0, sizeof(sock_addr));
+    sock_addr.sin_family = AF_INET;
+    sock_addr.sin_port   = htons(port);
+    inet_pton(AF_INET, addr.data(), &sock_addr.sin_addr);
+
+    if (bind(listen_fd_, (struct sockaddr*)&sock_addr, sizeof(sock_addr)) < 0 ||
+        listen(listen_fd_, SOMAXCONN) < 0)
+    {
+        std::cerr << "---> bind()/listen() on metrics port failed: " << strerror(errno) << "\n";
+        close(listen_fd_);
+        throw std::runtime_error("bind()/listen() failed");
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1)
+    {
+        std::cerr << "---> epoll_create1() failed: " << strerror(errno) << "\n";
+        close(listen_fd_);
+        throw std::runtime_error("epoll_create1() failed");
+    }
+
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = listen_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) == -1)
+    {
+        std::cerr << "---> epoll_ctl() failed: " << strerror(errno) << "\n";
+        close(listen_fd_);
+        close(epoll_fd_);
+        throw std::runtime_error("epoll_ctl() failed");
+    }
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+
+    for (const auto& [fd, conn] : connections_)
+    {
+        close(fd);
+    }
+    close(listen_fd_);
+    close(epoll_fd_);
+}
+
+void MetricsServer::start()
+{
+    if (running_.exchange(true))
+    {
+        return;
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+void MetricsServer::stop()
+{
+    running_.store(false);
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void MetricsServer::run()
+{
+    while (running_.load(std::memory_order_acquire))
+    {
+        int n = epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), 100);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "---> epoll_wait() failed with error: " << strerror(errno) << "\n";
+            break;
+        }
+
+        // an idle server still wakes every 100ms, so deadlines are checked at least that often
+        close_expired(Clock::now());
+
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events_[i].data.fd;
+            if (fd == listen_fd_)
+            {
+                accept_all();
+                continue;
+            }
+
+            auto it = connections_.find(fd);
+            if (it == connections_.end())
+            {
+                continue;
+            }
+
+            Connection& conn = it->second;
+            if ((events_[i].events & (EPOLLERR | EPOLLHUP)) != 0)
+            {
+                close_connection(fd);
+            }
+            else if (conn.response != nullptr)
+            {
+                if (!send_response(fd, conn))
+                {
+                    close_connection(fd);
+                }
+            }
+            else
+            {
+                on_readable(fd, conn);
+            }
+        }
+    }
+}
+
+void MetricsServer::accept_all()
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                std::cerr << "---> accept4() failed: " << strerror(errno) << "\n";
+            }
+            return;
+        }
+
+        epoll_event event{};
+        event.events  = EPOLLIN;
+        event.data.fd = fd;
+        if (connections_.size() >= MAX_CONNECTIONS ||
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1)
+        {
+            close(fd);
+            continue;
+        }
+        connections_.try_emplace(fd).first->second.accepted = Clock::now();
+    }
+}
+
+void MetricsServer::on_readable(int fd, Connection& conn)
+{
+    char buf[1024];
+    bool eof = false;
+    while (true)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n > 0)
+        {
+            conn.request.append(buf, static_cast<std::size_t>(n));
+            if (conn.request.size() > MAX_REQUEST)
+            {
+                close_connection(fd);
+                return;
+            }
+            continue;
+        }
+        if (n == 0)
+        {
+            eof = true; // a client may shut down its side right after the request
+            break;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        close_connection(fd);
+        return;
+    }
+
+    std::string_view request(conn.request);
+    if (request.find("\r\n\r\n") == std::string_view::npos)
+    {
+        if (eof)
+        {
+            close_connection(fd); // gone before a full request
+        }
+        return; // headers still incomplete
+    }
+
+    // only the request line matters, a query string is ignored
+    std::string_view target = "GET /metrics";
+    bool             scrape = request.starts_with(target) &&
+                  (request[target.size()] == ' ' || request[target.size()] == '?');
+    if (scrape)
+    {
+        conn.response = page_.current();
+        scrapes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        conn.response = not_found_;
+    }
+
+    if (!send_response(fd, conn))
+    {
+        close_connection(fd);
+    }
+}
+
+bool MetricsServer::send_response(int fd, Connection& conn)
+{
+    const Page& page  = *conn.response;
+    std::size_t total = page.head.size() + page.body.size();
+
+    while (conn.sent < total)
+    {
+        iovec iov[2];
+        int   count = 0;
+        if (conn.sent < page.head.size())
+        {
+            iov[count++] = {const_cast<char*>(page.head.data()) + conn.sent,
+                            page.head.size() - conn.sent};
+        }
+        std::size_t body_sent = conn.sent > page.head.size() ? conn.sent - page.head.size() : 0;
+        iov[count++]          = {const_cast<char*>(page.body.data()) + body_sent,
+                                 page.body.size() - body_sent};
+
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                // the rest goes out once the socket drains
+                epoll_event event{};
+                event.events  = EPOLLOUT;
+                event.data.fd = fd;
+                return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == 0;
+            }
+            return false;
+        }
+        conn.sent += static_cast<std::size_t>(n);
+    }
+    return false; // fully sent, the connection is done
+}
+
+void MetricsServer::close_expired(Clock::time_point now)
+{
+    expired_.clear();
+    for (const auto& [fd, conn] : connections_)
+    {
+        if (now - conn.accepted >= CONNECTION_TIMEOUT)
+        {
+            expired_.push_back(fd);
+        }
+    }
+
+    for (int fd : expired_)
+    {
+        close_connection(fd);
+    }
+}
+
+void MetricsServer::close_connection(int fd)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+}
+} // namespace metric_collector::exposition
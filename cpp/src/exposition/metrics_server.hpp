@@ -0,0 +1,84 @@
+#ifndef METRIC_COLLECTOR_EXPOSITION_METRICS_SERVER_HPP
+#define METRIC_COLLECTOR_EXPOSITION_METRICS_SERVER_HPP
+
+#include "prometheus_page.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/epoll.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace metric_collector::exposition
+{
+constexpr uint16_t DEFAULT_METRICS_PORT = 9102;
+
+// Minimal HTTP/1.1 listener for Prometheus scrapes: GET /metrics answers with the pre-rendered
+// page in a single writev, anything else with 404, and every connection closes after its
+// response. One epoll thread serves all scrapers; nothing is rendered or copied per request.
+// A connection that has not been answered and sent within CONNECTION_TIMEOUT is closed, so idle
+// clients cannot hold every slot.
+class MetricsServer
+{
+  public:
+    MetricsServer(uint16_t port, const std::string& addr, const PrometheusPage& page);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&)            = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    void start();
+    void stop();
+
+    [[nodiscard]] uint64_t scrapes() const noexcept
+    {
+        return scrapes_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr std::size_t MAX_EVENTS      = 64;
+    static constexpr std::size_t MAX_CONNECTIONS = 256;
+    static constexpr std::size_t MAX_REQUEST     = 4096;
+
+    static constexpr auto CONNECTION_TIMEOUT = std::chrono::seconds(5);
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection
+    {
+        Clock::time_point           accepted;
+        std::string                 request;
+        std::shared_ptr<const Page> response; // set once the request is complete
+        std::size_t                 sent{0};
+    };
+
+    void run();
+    void accept_all();
+    void on_readable(int fd, Connection& conn);
+    // false once the connection is done, sent or failed
+    bool send_response(int fd, Connection& conn);
+    void close_connection(int fd);
+    void close_expired(Clock::time_point now);
+
+    const PrometheusPage&       page_;
+    std::shared_ptr<const Page> not_found_;
+
+    int               listen_fd_{-1};
+    int               epoll_fd_{-1};
+    std::atomic<bool> running_{false};
+    std::thread       thread_;
+
+    std::unordered_map<int, Connection> connections_;
+    std::vector<int>                    expired_; // reused by close_expired()
+    std::array<epoll_event, MAX_EVENTS> events_;
+    std::atomic<uint64_t>               scrapes_{0};
+};
+} // namespace metric_collector::exposition
+
+#endif
@@ -0,0 +1,288 @@
+#include "prometheus_page.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <metrics.hpp>
+#include <utility>
+#include <variant>
+
+namespace metric_collector::exposition
+{
+namespace
+{
+constexpr std::string_view SELF_PREFIX = "metric_collector_";
+
+void append(std::string& out, uint64_t value)
+{
+    char buf[20];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+void append_type(std::string& out, std::string_view name, std::string_view type)
+{
+    out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void append_help(std::string& out, std::string_view name, std::string_view help)
+{
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+}
+
+void append_sample(std::string& out, std::string_view name, std::string_view suffix,
+                   uint64_t value)
+{
+    out.append(name).append(suffix).append(" ");
+    append(out, value);
+    out.append("\n");
+}
+} // namespace
+
+PrometheusPage::PrometheusPage()
+{
+    auto empty = std::make_unique<Page>();
+    set_head(*empty);
+    publish(std::move(empty));
+}
+
+void PrometheusPage::render(const aggregation::Snapshot&                      snapshot,
+                            const aggregation::SelfStatsSample&               self,
+                            const std::vector<aggregation::CardinalityStats>& cardinality)
+{
+    std::size_t count = 0;
+    rows_.resize(std::max(rows_.size(), snapshot.size()));
+    snapshot.for_each(
+        [this, &count](std::string_view name, const aggregation::MetricValue& value)
+        {
+            Row& row = rows_[count];
+            sanitise(name, row.name);
+            if (!row.name.empty())
+            {
+                row.original = name;
+                row.value    = &value;
+                count++;
+            }
+        });
+    std::sort(rows_.begin(), rows_.begin() + static_cast<std::ptrdiff_t>(count),
+              [](const Row& lhs, const Row& rhs)
+              {
+                  return lhs.name != rhs.name ? lhs.name < rhs.name
+                                              : lhs.original < rhs.original;
+              });
+
+    // the acquire pairs with the release of whoever let go of the page last
+    std::unique_ptr<Page> page(spare_->page.exchange(nullptr, std::memory_order_acquire));
+    if (page == nullptr)
+    {
+        page = std::make_unique<Page>();
+    }
+    page->body.clear();
+
+    collisions_ = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const Row& row = rows_[i];
+        if (i > 0 && row.name == rows_[i - 1].name)
+        {
+            collisions_++;
+            continue;
+        }
+
+        std::string& out = page->body;
+        std::visit(
+            [&out, &row](const auto& metric)
+            {
+                using T = std::decay_t<decltype(metric)>;
+                if constexpr (std::same_as<T, aggregation::Timer>)
+                {
+                    append_type(out, row.name, "summary");
+                    append_sample(out, row.name, "{quantile=\"0.5\"}", metric.percentile(0.5));
+                    append_sample(out, row.name, "{quantile=\"0.9\"}", metric.percentile(0.9));
+                    append_sample(out, row.name, "{quantile=\"0.99\"}",
+                                  metric.percentile(0.99));
+                    append_sample(out, row.name, "{quantile=\"0.999\"}",
+                                  metric.percentile(0.999));
+                    append_sample(out, row.name, "_sum", metric.sum());
+                    append_sample(out, row.name, "_count", metric.count());
+                }
+                else
+                {
+                    // counter and gauge have get(), a set its cardinality
+                    uint64_t value = 0;
+                    if constexpr (std::same_as<T, aggregation::Set>)
+                    {
+                        value = metric.count();
+                    }
+                    else
+                    {
+                        value = metric.get();
+                    }
+                    append_type(out, row.name, "gauge");
+                    append_sample(out, row.name, "", value);
+                }
+            },
+            row.value->metric);
+    }
+    render_self(self, page->body);
+    render_cardinality(cardinality, page->body);
+    set_head(*page);
+    publish(std::move(page));
+}
+
+void PrometheusPage::publish(std::unique_ptr<Page> page)
+{
+    // runs after the last reference is gone, a page already waiting is the older one
+    auto recycle = [spare = spare_](const Page* done)
+    {
+        Page* older = spare->page.exchange(const_cast<Page*>(done), std::memory_order_acq_rel);
+        delete older;
+    };
+    current_.store(std::shared_ptr<const Page>(page.release(), std::move(recycle)),
+                   std::memory_order_release);
+}
+
+void PrometheusPage::render_self(const aggregation::SelfStatsSample& self, std::string& out)
+{
+    using aggregation::SelfStats;
+
+    std::string name;
+    std::string labels;
+    for (std::size_t c = 0; c < aggregation::SELF_COUNTERS; c++)
+    {
+        name.assign(SELF_PREFIX)
+            .append(SelfStats::name_of(static_cast<aggregation::SelfCounter>(c)))
+            .append("_total");
+        bool typed = false;
+        for (const auto& thread : self)
+        {
+            if (thread.counters[c] == 0)
+            {
+                continue;
+            }
+            if (!typed)
+            {
+                append_type(out, name, "counter");
+                typed = true;
+            }
+            labels.assign("{thread=\"").append(thread.thread).append("\"}");
+            append_sample(out, name, labels, thread.counters[c]);
+        }
+    }
+
+    // buckets up to the highest one in use, le is the largest value a bucket holds
+    for (std::size_t h = 0; h < aggregation::SELF_HISTOGRAMS; h++)
+    {
+        name.assign(SELF_PREFIX).append(
+            SelfStats::name_of(static_cast<aggregation::SelfHistogram>(h)));
+        bool typed = false;
+        for (const auto& thread : self)
+        {
+            const auto& histogram = thread.histograms[h];
+            uint64_t    count     = histogram.count();
+            if (count == 0)
+            {
+                continue;
+            }
+            if (!typed)
+            {
+                append_type(out, name, "histogram");
+                typed = true;
+            }
+
+            std::size_t last = histogram.buckets.size() - 1;
+            while (histogram.buckets[last] == 0)
+            {
+                last--;
+            }
+
+            uint64_t cumulative = 0;
+            for (std::size_t b = 0; b <= last && b < 64; b++)
+            {
+                cumulative += histogram.buckets[b];
+                labels.assign("_bucket{thread=\"").append(thread.thread).append("\",le=\"");
+                append(labels, (uint64_t{1} << b) - 1);
+                labels.append("\"}");
+                append_sample(out, name, labels, cumulative);
+            }
+            labels.assign("_bucket{thread=\"").append(thread.thread).append("\",le=\"+Inf\"}");
+            append_sample(out, name, labels, count);
+
+            labels.assign("_sum{thread=\"").append(thread.thread).append("\"}");
+            append_sample(out, name, labels, histogram.sum);
+            labels.assign("_count{thread=\"").append(thread.thread).append("\"}");
+            append_sample(out, name, labels, count);
+        }
+    }
+}
+
+void PrometheusPage::render_cardinality(const std::vector<aggregation::CardinalityStats>& stats,
+                                        std::string&                                      out)
+{
+    if (stats.empty())
+    {
+        return;
+    }
+
+    // the prefix is configuration, escaped as a label value all the same
+    std::string labels;
+    auto        label = [&labels](const aggregation::CardinalityStats& limit)
+    {
+        labels.assign("{prefix=\"");
+        for (char c : limit.prefix)
+        {
+            if (c == '\\' || c == '"')
+            {
+                labels.push_back('\\');
+            }
+            labels.push_back(c);
+        }
+        labels.append("\"}");
+        return std::string_view(labels);
+    };
+
+    std::string name(SELF_PREFIX);
+    name.append("cardinality_rejected_total");
+    append_help(out, name, "Samples dropped because their name was over a cardinality limit.");
+    append_type(out, name, "counter");
+    for (const auto& limit : stats)
+    {
+        append_sample(out, name, label(limit), limit.rejected);
+    }
+
+    name.assign(SELF_PREFIX).append("cardinality_folded_total");
+    append_help(out, name,
+                "Samples of names over a cardinality limit, counted into the limit's "
+                "cardinality_overflow metric instead.");
+    append_type(out, name, "counter");
+    for (const auto& limit : stats)
+    {
+        append_sample(out, name, label(limit), limit.folded);
+    }
+}
+
+void PrometheusPage::sanitise(std::string_view name, std::string& out)
+{
+    out.assign(name);
+    for (std::size_t i = 0; i < out.size(); i++)
+    {
+        char c     = out[i];
+        bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' ||
+                     (i > 0 && c >= '0' && c <= '9');
+        if (!valid)
+        {
+            out[i] = '_';
+        }
+    }
+}
+
+void PrometheusPage::set_head(Page& page)
+{
+    page.head.assign("HTTP/1.1 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                     "Connection: close\r\n"
+                     "Content-Length: ");
+    append(page.head, page.body.size());
+    page.head.append("\r\n\r\n");
+}
+} // namespace metric_collector::exposition
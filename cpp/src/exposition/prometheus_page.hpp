@@ -0,0 +1,86 @@
+#ifndef METRIC_COLLECTOR_EXPOSITION_PROMETHEUS_PAGE_HPP
+#define METRIC_COLLECTOR_EXPOSITION_PROMETHEUS_PAGE_HPP
+
+#include <atomic>
+#include <cardinality_guard.hpp>
+#include <cstddef>
+#include <memory>
+#include <self_stats.hpp>
+#include <snapshot.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace metric_collector::exposition
+{
+// A complete HTTP response, status line and headers apart from the body so both go out with
+// one writev.
+struct Page
+{
+    std::string head;
+    std::string body;
+};
+
+// The /metrics response in Prometheus text format (0.0.4) for one sealed window, rendered once
+// per rotation and shared by every scrape until the next one. StatsD counters count within the
+// window, so they are exposed as gauges like sets and gauges; timers become summaries.
+// Names are sanitised to [a-zA-Z0-9_:]; when two end up equal the bytewise smaller original
+// name is kept and the other dropped.
+// Pages are recycled: whoever lets go of a replaced page last, the render or a slow scrape,
+// hands it back through a release store, and the next render takes it with an acquire.
+// With a scrape still holding it by then, a fresh page is rendered instead.
+class PrometheusPage
+{
+  public:
+    PrometheusPage();
+
+    // from the rotation thread only; self, if given, is appended as the collector's own
+    // metrics, cumulative since start and labelled by thread, and so are the cardinality
+    // guard's totals, labelled by the limit's prefix
+    void render(const aggregation::Snapshot&                      snapshot,
+                const aggregation::SelfStatsSample&               self        = {},
+                const std::vector<aggregation::CardinalityStats>& cardinality = {});
+
+    // never null, an empty page until the first render
+    [[nodiscard]] std::shared_ptr<const Page> current() const
+    {
+        return current_.load(std::memory_order_acquire);
+    }
+
+    // names dropped from the last render because they collided after sanitising
+    [[nodiscard]] std::size_t collisions() const noexcept { return collisions_; }
+
+  private:
+    struct Row
+    {
+        std::string                     name; // sanitised
+        std::string_view                original;
+        const aggregation::MetricValue* value;
+    };
+
+    static void render_self(const aggregation::SelfStatsSample& self, std::string& out);
+    static void render_cardinality(const std::vector<aggregation::CardinalityStats>& stats,
+                                   std::string&                                      out);
+    static void sanitise(std::string_view name, std::string& out);
+    static void set_head(Page& page);
+
+    // publishes page, it comes back to spare_ once no scrape holds it anymore
+    void publish(std::unique_ptr<Page> page);
+
+    // shared with the deleters of the published pages, which may outlive this object
+    struct Spare
+    {
+        std::atomic<Page*> page{nullptr};
+
+        ~Spare() { delete page.load(std::memory_order_acquire); }
+    };
+
+    std::atomic<std::shared_ptr<const Page>> current_;
+    std::shared_ptr<Spare>                   spare_ = std::make_shared<Spare>();
+
+    std::vector<Row> rows_; // reused across renders, so are the names' buffers
+    std::size_t      collisions_{0};
+};
+} // namespace metric_collector::exposition
+
+#endif
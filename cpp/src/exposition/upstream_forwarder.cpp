@@ -0,0 +1,269 @@
+#include "upstream_forwarder.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <metrics.hpp>
+#include <netdb.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <utility>
+#include <variant>
+
+namespace metric_collector::exposition
+{
+namespace
+{
+void append_value(std::string& out, uint64_t value)
+{
+    char buf[20];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+} // namespace
+
+UpstreamForwarder::UpstreamForwarder(ForwarderOptions options)
+    : options_(std::move(options)),
+      buffer_(options_.batch_size * options_.payload_size),
+      iovecs_(options_.batch_size),
+      msgs_(options_.batch_size)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    struct addrinfo* found = nullptr;
+    auto             port  = std::to_string(options_.port);
+    int              error = getaddrinfo(options_.host.c_str(), port.c_str(), &hints, &found);
+    if (error != 0)
+    {
+        std::cerr << "---> cannot resolve upstream " << options_.host << ": "
+                  << gai_strerror(error) << "\n";
+        throw std::runtime_error("cannot resolve upstream");
+    }
+
+    // the first address that takes a connect, resolved once for the forwarder's lifetime
+    for (auto* address = found; address != nullptr && fd_ < 0; address = address->ai_next)
+    {
+        fd_ = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC,
+                     address->ai_protocol);
+        if (fd_ >= 0 && connect(fd_, address->ai_addr, address->ai_addrlen) < 0)
+        {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd_ < 0)
+    {
+        std::cerr << "---> cannot connect to upstream " << options_.host << ":" << options_.port
+                  << ": " << strerror(errno) << "\n";
+        throw std::runtime_error("connect() to upstream failed");
+    }
+
+    // connected, so the messages need no address
+    for (std::size_t i = 0; i < options_.batch_size; i++)
+    {
+        iovecs_[i].iov_base         = buffer_.data() + i * options_.payload_size;
+        msgs_[i].msg_hdr.msg_iov    = &iovecs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+UpstreamForwarder::~UpstreamForwarder()
+{
+    stop();
+    close(fd_);
+}
+
+void UpstreamForwarder::start()
+{
+    std::lock_guard lock(mutex_);
+    if (thread_.joinable())
+    {
+        return; // already running
+    }
+
+    stopping_ = false;
+    thread_   = std::thread([this]() { run(); });
+}
+
+void UpstreamForwarder::stop()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_all();
+
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void UpstreamForwarder::submit(std::shared_ptr<const aggregation::Snapshot> snapshot)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (pending_ != nullptr)
+        {
+            skipped_++; // the upstream is slower than the windows
+        }
+        pending_ = std::move(snapshot);
+    }
+    wakeup_.notify_one();
+}
+
+FlushStats UpstreamForwarder::last_flush() const
+{
+    std::lock_guard lock(mutex_);
+    return last_;
+}
+
+uint64_t UpstreamForwarder::windows_skipped() const
+{
+    std::lock_guard lock(mutex_);
+    return skipped_;
+}
+
+void UpstreamForwarder::run()
+{
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        wakeup_.wait(lock, [this] { return stopping_ || pending_ != nullptr; });
+        if (stopping_)
+        {
+            return;
+        }
+
+        auto snapshot = std::move(pending_);
+        lock.unlock();
+        auto stats = flush(*snapshot);
+        lock.lock();
+
+        last_ = stats;
+    }
+}
+
+FlushStats UpstreamForwarder::flush(const aggregation::Snapshot& snapshot)
+{
+    stats_             = FlushStats{};
+    stats_.epoch       = snapshot.epoch();
+    current_           = 0;
+    iovecs_[0].iov_len = 0;
+
+    snapshot.for_each(
+        [this](std::string_view name, const aggregation::MetricValue& value)
+        {
+            auto line = [this, name](std::string_view suffix, uint64_t v, std::string_view type)
+            {
+                line_.assign(name).append(suffix).append(":");
+                append_value(line_, v);
+                line_.append("|").append(type);
+                append_line(line_);
+            };
+
+            std::visit(
+                [&line](const auto& metric)
+                {
+                    using T = std::decay_t<decltype(metric)>;
+                    if constexpr (std::same_as<T, aggregation::Counter>)
+                    {
+                        line("", metric.get(), "c");
+                    }
+                    else if constexpr (std::same_as<T, aggregation::Gauge>)
+                    {
+                        line("", metric.get(), "g");
+                    }
+                    else if constexpr (std::same_as<T, aggregation::Timer>)
+                    {
+                        line(".count", metric.count(), "c");
+                        line(".sum", metric.sum(), "c");
+                        line(".min", metric.count() == 0 ? 0 : metric.min(), "g");
+                        line(".max", metric.max(), "g");
+                        line(".p50", metric.percentile(0.50), "g");
+                        line(".p90", metric.percentile(0.90), "g");
+                        line(".p99", metric.percentile(0.99), "g");
+                        line(".p999", metric.percentile(0.999), "g");
+                    }
+                    else
+                    {
+                        line("", metric.count(), "g");
+                    }
+                },
+                value.metric);
+        });
+
+    if (iovecs_[current_].iov_len > 0)
+    {
+        current_++;
+    }
+    send_batch();
+    return stats_;
+}
+
+void UpstreamForwarder::append_line(std::string_view line)
+{
+    if (line.size() > options_.payload_size)
+    {
+        stats_.dropped_lines++;
+        return;
+    }
+
+    // lines are newline separated, the last one in a datagram needs none
+    std::size_t used = iovecs_[current_].iov_len;
+    std::size_t need = used == 0 ? line.size() : line.size() + 1;
+    if (used + need > options_.payload_size)
+    {
+        if (++current_ == options_.batch_size)
+        {
+            send_batch();
+        }
+        iovecs_[current_].iov_len = 0;
+        used                      = 0;
+        need                      = line.size();
+    }
+
+    char* dest = static_cast<char*>(iovecs_[current_].iov_base) + used;
+    if (used != 0)
+    {
+        *dest++ = '\n';
+    }
+    std::memcpy(dest, line.data(), line.size());
+    iovecs_[current_].iov_len = used + need;
+    stats_.lines++;
+}
+
+// sends the current_ complete datagrams and starts over at the first slot
+void UpstreamForwarder::send_batch()
+{
+    std::size_t sent = 0;
+    while (sent < current_)
+    {
+        int n = sendmmsg(fd_, msgs_.data() + sent, static_cast<unsigned>(current_ - sent), 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // e.g. ECONNREFUSED from an earlier ICMP, drop the datagram and go on
+            stats_.send_errors++;
+            sent++;
+            continue;
+        }
+
+        for (std::size_t i = sent; i < sent + static_cast<std::size_t>(n); i++)
+        {
+            stats_.bytes += iovecs_[i].iov_len;
+        }
+        stats_.datagrams += static_cast<uint64_t>(n);
+        sent += static_cast<std::size_t>(n);
+    }
+    current_ = 0;
+}
+} // namespace metric_collector::exposition
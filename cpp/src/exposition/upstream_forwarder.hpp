@@ -0,0 +1,96 @@
+#ifndef METRIC_COLLECTOR_EXPOSITION_UPSTREAM_FORWARDER_HPP
+#define METRIC_COLLECTOR_EXPOSITION_UPSTREAM_FORWARDER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <snapshot.hpp>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+namespace metric_collector::exposition
+{
+// 1500 byte ethernet MTU minus the IPv6 and UDP headers, with room for tunnel overhead
+constexpr std::size_t DEFAULT_UPSTREAM_PAYLOAD = 1432;
+constexpr std::size_t DEFAULT_UPSTREAM_BATCH   = 64;
+
+struct ForwarderOptions
+{
+    std::string host{"127.0.0.1"}; // name or address, resolved once at construction
+    uint16_t    port{8125};
+    std::size_t payload_size{DEFAULT_UPSTREAM_PAYLOAD}; // max bytes per datagram
+    std::size_t batch_size{DEFAULT_UPSTREAM_BATCH};     // datagrams per sendmmsg
+};
+
+// What one window cost to forward.
+struct FlushStats
+{
+    uint64_t epoch{0};
+    uint64_t lines{0};
+    uint64_t datagrams{0};
+    uint64_t bytes{0};
+    uint64_t dropped_lines{0}; // longer than a datagram
+    uint64_t send_errors{0};   // datagrams the kernel refused
+};
+
+// Forwards closed windows to an upstream StatsD endpoint, e.g. the next collector tier.
+// Counters and gauges go out as they are, sets as a gauge of their cardinality and timers as
+// name.count and name.sum (counters, they add up across windows) plus
+// name.min/.max/.p50/.p90/.p99/.p999 (gauges), since the samples themselves are gone. Lines are
+// packed newline separated into datagrams of at most payload_size bytes and sent batch_size
+// datagrams per sendmmsg on a connected socket.
+// submit() only hands the window over; formatting and sending happen on the forwarder's own
+// thread so neither the rotation nor ingestion waits on the network.
+class UpstreamForwarder
+{
+  public:
+    explicit UpstreamForwarder(ForwarderOptions options);
+    ~UpstreamForwarder();
+
+    UpstreamForwarder(const UpstreamForwarder&)            = delete;
+    UpstreamForwarder& operator=(const UpstreamForwarder&) = delete;
+
+    void start();
+    void stop();
+
+    // queue a window for the forwarder thread; one still waiting is replaced and counted
+    void submit(std::shared_ptr<const aggregation::Snapshot> snapshot);
+
+    // format and send a window on the calling thread, not concurrently with the forwarder's
+    FlushStats flush(const aggregation::Snapshot& snapshot);
+
+    [[nodiscard]] FlushStats last_flush() const;
+    [[nodiscard]] uint64_t   windows_skipped() const;
+
+  private:
+    void run();
+    void append_line(std::string_view line);
+    void send_batch();
+
+    ForwarderOptions options_;
+    int              fd_{-1};
+
+    // batch_size slots of payload_size bytes, filled one datagram at a time
+    std::vector<char>    buffer_;
+    std::vector<iovec>   iovecs_;
+    std::vector<mmsghdr> msgs_;
+    std::size_t          current_{0}; // datagram being filled
+    std::string          line_;
+    FlushStats           stats_;
+
+    mutable std::mutex                          mutex_;
+    std::condition_variable                     wakeup_;
+    std::shared_ptr<const aggregation::Snapshot> pending_;
+    FlushStats                                  last_;
+    uint64_t                                    skipped_{0};
+    bool                                        stopping_{false};
+    std::thread                                 thread_;
+};
+} // namespace metric_collector::exposition
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef METRIC_COLLECTOR_INGESTION_AGGREGATOR_HPP
+#define METRIC_COLLECTOR_INGESTION_AGGREGATOR_HPP
+
+#include "parser.hpp"
+
+#include <atomic>
+#include <bucket_ring.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <local_table.hpp>
+#include <self_stats.hpp>
+#include <string_view>
+
+namespace metric_collector::ingestion
+{
+// Parses payloads into a thread-owned LocalTable and periodically merges it into the shared
+// ring. Owned by whichever thread parses: a Worker, or a Listener running with inline parsing.
+// It also merges when a rotation asks, so the sealed window is not missing its last second.
+class Aggregator
+{
+  public:
+    explicit Aggregator(aggregation::MetricRing& ring) : ring_(ring), local_(ring.names())
+    {
+        ring_.attach(flush_);
+    }
+
+    ~Aggregator() { ring_.detach(flush_); }
+
+    Aggregator(const Aggregator&)            = delete;
+    Aggregator& operator=(const Aggregator&) = delete;
+
+    void process(std::string_view payload)
+    {
+        std::size_t lines      = 0;
+        std::size_t mismatches = 0;
+        std::size_t rejected   = Parser::parse_packet(
+            payload,
+            [this, &lines, &mismatches](std::string_view name, aggregation::MetricType type,
+                                        uint64_t value)
+            {
+                lines++;
+                if (!record(name, type, value))
+                {
+                    mismatches++;
+                }
+            });
+
+        if (!local_.empty() && !flush_.pending.load(std::memory_order_relaxed))
+        {
+            flush_.pending.store(true, std::memory_order_release); // a rotation waits for it now
+        }
+
+        // counted once per packet; conflicts with the shared window are counted when merged
+        aggregation::SelfStats::add(aggregation::SelfCounter::LinesParsed, lines);
+        if (rejected != 0)
+        {
+            aggregation::SelfStats::add(aggregation::SelfCounter::ParseErrors, rejected);
+        }
+        if (mismatches != 0)
+        {
+            aggregation::SelfStats::add(aggregation::SelfCounter::LocalTypeMismatches,
+                                        mismatches);
+        }
+    }
+
+    // call once per loop iteration, only reads the clock every MERGE_CHECK_ITERATIONS calls;
+    // a rotation's flush request is answered on the first call that sees it
+    void tick()
+    {
+        uint64_t request = ring_.flush_requested();
+        if (request != flush_.acked.load(std::memory_order_relaxed))
+        {
+            merge();
+            flush_.acked.store(request, std::memory_order_release);
+        }
+
+        if (++since_check_ < MERGE_CHECK_ITERATIONS)
+        {
+            return;
+        }
+        since_check_ = 0;
+
+        auto now = Clock::now();
+        if (now >= next_merge_)
+        {
+            merge();
+            next_merge_ = now + MERGE_INTERVAL;
+        }
+    }
+
+    void merge()
+    {
+        if (local_.empty())
+        {
+            return;
+        }
+
+        ring_.merge(local_);
+        local_.clear();
+        flush_.pending.store(false, std::memory_order_release);
+    }
+
+  private:
+    // how often the local table is flushed into the shared ring, and how many loop iterations
+    // pass between clock reads
+    static constexpr auto        MERGE_INTERVAL         = std::chrono::seconds(1);
+    static constexpr std::size_t MERGE_CHECK_ITERATIONS = 256;
+
+    using Clock = std::chrono::steady_clock;
+
+    bool record(std::string_view name, aggregation::MetricType type, uint64_t value)
+    {
+        switch (type)
+        {
+        case aggregation::MetricType::Counter:
+            return local_.add<aggregation::Counter>(name, value);
+        case aggregation::MetricType::Gauge:
+            return local_.add<aggregation::Gauge>(name, value);
+        case aggregation::MetricType::Timer:
+            return local_.add<aggregation::Timer>(name, value);
+        case aggregation::MetricType::Set:
+            return local_.add<aggregation::Set>(name, value);
+        case aggregation::MetricType::Invalid:
+            break; // rejected by the parser
+        }
+        return true;
+    }
+
+    aggregation::MetricRing& ring_;
+    aggregation::LocalTable  local_;
+    aggregation::FlushTicket flush_;
+    std::size_t              since_check_{0};
+    Clock::time_point        next_merge_{Clock::now() + MERGE_INTERVAL};
+};
+} // namespace metric_collector::ingestion
+
+#endif
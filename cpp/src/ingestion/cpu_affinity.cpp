@@ -0,0 +1,207 @@
+#include "cpu_affinity.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <unordered_map>
+
+namespace metric_collector::ingestion
+{
+namespace
+{
+std::string read_line(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    std::string   line;
+    std::getline(file, line);
+    return line;
+}
+
+// the number after prefix in name, e.g. 3 for ("node3", "node"); nullopt if name is not that
+std::optional<int> suffix_number(std::string_view name, std::string_view prefix)
+{
+    if (!name.starts_with(prefix))
+    {
+        return std::nullopt;
+    }
+    name.remove_prefix(prefix.size());
+
+    int  number = 0;
+    auto res    = std::from_chars(name.data(), name.data() + name.size(), number);
+    if (res.ec != std::errc{} || res.ptr != name.data() + name.size())
+    {
+        return std::nullopt;
+    }
+    return number;
+}
+
+// the action names of the IRQs in /proc/interrupts, by IRQ: the last column, e.g. eth0-TxRx-3
+std::unordered_map<int, std::string> irq_names()
+{
+    std::unordered_map<int, std::string> names;
+
+    std::ifstream file("/proc/interrupts");
+    std::string   line;
+    while (std::getline(file, line))
+    {
+        std::string_view rest(line);
+        rest.remove_prefix(std::min(rest.size(), rest.find_first_not_of(' ')));
+        auto colon = rest.find(':');
+        auto irq   = suffix_number(rest.substr(0, colon), "");
+        auto last  = rest.find_last_of(' ');
+        if (!irq.has_value() || colon == std::string_view::npos || last == std::string_view::npos)
+        {
+            continue; // the header and the NMI, LOC, ... rows
+        }
+        names.emplace(*irq, std::string(rest.substr(last + 1)));
+    }
+    return names;
+}
+
+// drivers name a vector that receives eth0-TxRx-0, eth0-rx-0, virtio1-input.0 or
+// mlx5_comp0@pci:...; admin, mailbox and tx-only vectors carry none of these
+bool is_rx_queue(std::string name)
+{
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return name.find("rx") != std::string::npos || name.find("input") != std::string::npos ||
+           name.find("comp") != std::string::npos;
+}
+} // namespace
+
+bool pin_thread(int cpu)
+{
+    if (cpu == ANY_CPU)
+    {
+        return true;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+    {
+        std::cerr << "---> pinning thread to cpu " << cpu << " failed: " << strerror(err) << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::vector<int>> numa_nodes()
+{
+    std::vector<std::vector<int>> nodes;
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec))
+    {
+        auto node = suffix_number(entry.path().filename().string(), "node");
+        if (!node.has_value())
+        {
+            continue;
+        }
+
+        auto cpus = parse_cpu_list(read_line(entry.path() / "cpulist"));
+        if (cpus.empty())
+        {
+            continue; // memory only node
+        }
+        nodes.resize(std::max(nodes.size(), static_cast<std::size_t>(*node) + 1));
+        nodes[static_cast<std::size_t>(*node)] = std::move(cpus);
+    }
+
+    std::erase_if(nodes, [](const std::vector<int>& cpus) { return cpus.empty(); });
+    if (nodes.empty())
+    {
+        nodes.emplace_back();
+        for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); cpu++)
+        {
+            nodes.back().push_back(static_cast<int>(cpu));
+        }
+    }
+    return nodes;
+}
+
+std::vector<int> parse_cpu_list(std::string_view list)
+{
+    std::vector<int> cpus;
+    while (!list.empty())
+    {
+        auto item = list.substr(0, list.find(','));
+        list.remove_prefix(std::min(list.size(), item.size() + 1));
+
+        int  first = 0;
+        int  last  = 0;
+        auto dash  = item.find('-');
+        auto lo    = item.substr(0, dash);
+        auto hi    = dash == std::string_view::npos ? lo : item.substr(dash + 1);
+        auto a     = std::from_chars(lo.data(), lo.data() + lo.size(), first);
+        auto b     = std::from_chars(hi.data(), hi.data() + hi.size(), last);
+        if (a.ec != std::errc{} || a.ptr != lo.data() + lo.size() || b.ec != std::errc{} ||
+            b.ptr != hi.data() + hi.size() || first < 0 || last < first || last >= CPU_SETSIZE)
+        {
+            std::cerr << "---> malformed cpu list item: " << item << "\n";
+            return {};
+        }
+
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> nic_irq_cpus(const std::string& interface)
+{
+    std::vector<int> irqs;
+
+    std::error_code ec;
+    auto            dir = std::filesystem::path("/sys/class/net") / interface / "device/msi_irqs";
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+    {
+        if (auto irq = suffix_number(entry.path().filename().string(), ""))
+        {
+            irqs.push_back(*irq);
+        }
+    }
+    std::sort(irqs.begin(), irqs.end());
+
+    auto             names = irq_names();
+    std::vector<int> cpus;
+    for (int irq : irqs)
+    {
+        auto name = names.find(irq);
+        if (name == names.end() || !is_rx_queue(name->second))
+        {
+            continue;
+        }
+
+        auto base = std::filesystem::path("/proc/irq") / std::to_string(irq);
+        auto list = read_line(base / "effective_affinity_list");
+        if (list.empty())
+        {
+            list = read_line(base / "smp_affinity_list");
+        }
+
+        // an IRQ allowed on several cpus is delivered to the first of them
+        auto allowed = parse_cpu_list(list);
+        if (!allowed.empty() && std::find(cpus.begin(), cpus.end(), allowed.front()) == cpus.end())
+        {
+            cpus.push_back(allowed.front());
+        }
+    }
+
+    if (cpus.empty())
+    {
+        std::cerr << "---> no rx queue IRQ cpus found for interface " << interface << "\n";
+    }
+    return cpus;
+}
+} // namespace metric_collector::ingestion
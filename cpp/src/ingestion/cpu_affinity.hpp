@@ -0,0 +1,77 @@
+#ifndef METRIC_COLLECTOR_INGESTION_CPU_AFFINITY_HPP
+#define METRIC_COLLECTOR_INGESTION_CPU_AFFINITY_HPP
+
+#include <exception>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace metric_collector::ingestion
+{
+constexpr int ANY_CPU = -1;
+
+// pins the calling thread to cpu, false (and logged) if the kernel refuses; ANY_CPU is a no-op
+bool pin_thread(int cpu);
+
+// cpus of every numa node that has any, in node order; a single node holding every cpu on
+// machines without numa information
+std::vector<std::vector<int>> numa_nodes();
+
+// "0-3,8,10-11" as in cpulist files and taskset, empty (and logged) if malformed or naming a
+// cpu at or above CPU_SETSIZE
+std::vector<int> parse_cpu_list(std::string_view list);
+
+// Cpus the interrupts of interface's rx queues are delivered to, in IRQ order and without
+// duplicates. With RSS every rx queue has its own IRQ, so these are the cpus the kernel runs
+// the receive path on and where listeners should run. Only MSI IRQs whose /proc/interrupts
+// name marks a receiving queue count (TxRx, rx, virtio input, mlx5 comp), not admin, mailbox or
+// tx-only vectors. Empty if there are none, e.g. loopback or a driver naming its queues
+// otherwise.
+std::vector<int> nic_irq_cpus(const std::string& interface);
+
+// cpus[index] wrapping around, ANY_CPU if cpus is empty
+inline int cpu_for(const std::vector<int>& cpus, std::size_t index)
+{
+    return cpus.empty() ? ANY_CPU : cpus[index % cpus.size()];
+}
+
+// Runs func on a short lived thread pinned to cpu and returns what it returns, exceptions
+// included. Memory func allocates and initialises is first touched on that cpu, so with the
+// kernel's default policy its pages come from cpu's numa node. ANY_CPU runs func in place.
+template <typename F> std::invoke_result_t<F&> construct_on(int cpu, F&& func)
+{
+    if (cpu == ANY_CPU)
+    {
+        return func();
+    }
+
+    std::optional<std::invoke_result_t<F&>> result;
+    std::exception_ptr                      error;
+    std::thread(
+        [&]()
+        {
+            pin_thread(cpu);
+            try
+            {
+                result.emplace(func());
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        })
+        .join();
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return std::move(*result);
+}
+} // namespace metric_collector::ingestion
+
+#endif
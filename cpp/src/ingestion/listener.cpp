@@ -0,0 +1,432 @@
+#include "listener.hpp"
+
+#include "worker.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <linux/sock_diag.h>
+#include <self_stats.hpp>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace metric_collector::ingestion
+{
+Listener::Listener(uint16_t port, const std::string& addr, aggregation::MetricRing& ring,
+                   ReceiveOptions options)
+    : gro_(options.gro), pool_(pool_size(buffer_size(options)), buffer_size(options)),
+      aggregator_(ring)
+{
+    // every in-flight packet owns a pool buffer, so a queue can never hold more than the pool
+    static_assert(POOL_SIZE <= WORKER_QUEUE_CAPACITY, "pool must not outgrow a worker queue");
+
+    if (options.max_datagram == 0 || options.max_datagram > MAX_DATAGRAM)
+    {
+        std::cerr << "---> max_datagram must be between 1 and " << MAX_DATAGRAM << ", not "
+                  << options.max_datagram << "\n";
+        throw std::runtime_error("invalid max_datagram");
+    }
+
+    init_listen_socket(port, addr);
+    if (gro_)
+    {
+        enable_gro();
+    }
+
+    if (options.backend == Backend::IoUring)
+    {
+        try
+        {
+            uring_ = std::make_unique<UringReceiver>(listen_fd_, pool_, gro_);
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << "---> io_uring unavailable (" << e.what() << "), falling back to epoll\n";
+        }
+    }
+
+    if (uring_ == nullptr)
+    {
+        init_buffers();
+        init_epoll_socket();
+    }
+}
+
+Listener::~Listener()
+{
+    if (listen_fd_ >= 0)
+    {
+        close(listen_fd_);
+    }
+
+    if (epoll_fd_ >= 0)
+    {
+        close(epoll_fd_);
+    }
+}
+
+void Listener::init_epoll_socket()
+{
+    epoll_fd_ = epoll_create1(0);
+    if (epoll_fd_ == -1)
+    {
+        std::cerr << "---> epoll_create1() failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("epoll_create1() failed");
+    }
+
+    struct epoll_event event;
+    event.events  = EPOLLIN | EPOLLET;
+    event.data.fd = listen_fd_;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) == -1)
+    {
+        std::cerr << "---> epoll_ctl() failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("epoll_ctl() failed");
+    }
+}
+
+void Listener::init_listen_socket(uint16_t port, const std::string& addr)
+{
+    listen_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (listen_fd_ < 0)
+    {
+        std::cerr << "---> socket() failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("socket() failed");
+    }
+
+    // allow reuse of port and addr
+    int yes = 1;
+    if (setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0)
+    {
+        std::cerr << "---> setsockopt(SO_REUSEADDR) failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("socket() failed");
+    }
+    if (setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0)
+    {
+        std::cerr << "---> setsockopt(SO_REUSEPORT) failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("socket() failed");
+    }
+
+    struct sockaddr_in sock_addr;
+    memset(&sock_addr, 0, sizeof(sock_addr));
+    sock_addr.sin_family = AF_INET;
+    sock_addr.sin_port   = htons(port);
+    inet_pton(AF_INET, addr.data(), &sock_addr.sin_addr);
+
+    if (bind(listen_fd_, (struct sockaddr*)&sock_addr, sizeof(sock_addr)) < 0)
+    {
+        std::cerr << "---> socket() failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("socket() failed");
+    }
+
+    if (set_non_blocking(listen_fd_) < 0)
+    {
+        std::cerr << "---> set_non_blocking() failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("set_non_blocking() failed");
+    }
+}
+
+void Listener::enable_gro()
+{
+    int yes = 1;
+    if (setsockopt(listen_fd_, SOL_UDP, UDP_GRO, &yes, sizeof(yes)) < 0)
+    {
+        std::cerr << "---> setsockopt(UDP_GRO) failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("setsockopt(UDP_GRO) failed");
+    }
+}
+
+std::size_t Listener::buffer_size(const ReceiveOptions& options) noexcept
+{
+    std::size_t payload = options.gro ? GRO_BUFFER : options.max_datagram;
+    if (options.backend == Backend::IoUring)
+    {
+        return payload + UringReceiver::headroom(options.gro);
+    }
+    return payload;
+}
+
+std::size_t Listener::pool_size(std::size_t buffer_size) noexcept
+{
+    // at least two full receive batches, so workers holding buffers cannot starve recvmmsg
+    return std::clamp(POOL_BYTES / buffer_size, 2 * BATCH_SIZE, POOL_SIZE);
+}
+
+int Listener::set_non_blocking(int fd)
+{
+    auto flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1)
+    {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void Listener::set_incoming_cpu(int cpu)
+{
+    if (setsockopt(listen_fd_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0)
+    {
+        std::cerr << "---> setsockopt(SO_INCOMING_CPU) failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("setsockopt(SO_INCOMING_CPU) failed");
+    }
+}
+
+uint64_t Listener::socket_drops() const noexcept
+{
+    std::array<uint32_t, SK_MEMINFO_VARS> meminfo{};
+    socklen_t                             len = sizeof(meminfo);
+    if (getsockopt(listen_fd_, SOL_SOCKET, SO_MEMINFO, meminfo.data(), &len) < 0)
+    {
+        return 0;
+    }
+    return meminfo[SK_MEMINFO_DROPS];
+}
+
+void Listener::run(const std::atomic<bool>& running)
+{
+    if (uring_ != nullptr)
+    {
+        run_uring(running);
+    }
+    else
+    {
+        run_epoll(running);
+    }
+
+    if (workers_.empty())
+    {
+        aggregator_.merge();
+    }
+}
+
+void Listener::run_uring(const std::atomic<bool>& running)
+{
+    bool starved = false;
+
+    while (running.load(std::memory_order_acquire))
+    {
+        uint64_t batch = 0;
+
+        // same short poll as the epoll path while the pool is empty
+        starved = !uring_->poll(starved ? 1 : 100,
+                                [this, &batch](Packet packet, bool truncated)
+                                {
+                                    dispatch(packet, truncated);
+                                    if (workers_.empty())
+                                    {
+                                        packet.release(); // back into the buffer ring
+                                    }
+                                    batch++;
+                                });
+        wake_workers();
+
+        if (batch != 0)
+        {
+            aggregation::SelfStats::record(aggregation::SelfHistogram::RecvBatch, batch);
+        }
+
+        if (workers_.empty())
+        {
+            aggregator_.tick();
+        }
+    }
+}
+
+void Listener::run_epoll(const std::atomic<bool>& running)
+{
+    while (running.load(std::memory_order_acquire))
+    {
+        // poll quickly while buffers are owed back by the workers, edge triggered epoll would
+        // not wake us for data that is already queued on the socket
+        int timeout = backlogged_ ? 1 : 100;
+        int n = epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), timeout);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "---> epoll_wait() failed with error: " << strerror(errno) << "\n";
+            break;
+        }
+
+        if (workers_.empty())
+        {
+            aggregator_.tick();
+        }
+
+        if (n == 0)
+        {
+            if (backlogged_)
+            {
+                drain_socket();
+            }
+            continue; // no packet received
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (events_[i].data.fd != listen_fd_)
+            {
+                continue;
+            }
+
+            drain_socket();
+        }
+    }
+}
+
+void Listener::drain_socket()
+{
+    backlogged_ = false;
+
+    while (true)
+    {
+        auto ready = refill_slots();
+        if (ready == 0)
+        {
+            backlogged_ = true; // pool exhausted, leave the rest in the socket buffer
+            break;
+        }
+
+        int r = recvmmsg(listen_fd_, msgs_.data(), static_cast<unsigned int>(ready), MSG_DONTWAIT,
+                         nullptr);
+        if (r < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break; // no more data
+            }
+
+            std::cerr << "---> recvmmsg() failed" << strerror(errno) << "\n";
+            break;
+        }
+
+        if (r == 0)
+        {
+            break;
+        }
+
+        aggregation::SelfStats::record(aggregation::SelfHistogram::RecvBatch,
+                                       static_cast<uint64_t>(r));
+        process_packets(r);
+        wake_workers();
+    }
+}
+
+void Listener::process_packets(size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        auto&  hdr = msgs_[i].msg_hdr;
+        Packet packet{&pool_, slots_[i], msgs_[i].msg_len};
+        if (gro_)
+        {
+            packet.segment     = gro_segment_size(hdr);
+            hdr.msg_controllen = GRO_CONTROL_SPACE; // the kernel set it to what it wrote
+        }
+        dispatch(packet, (hdr.msg_flags & MSG_TRUNC) != 0);
+
+        // with inline parsing the slot keeps its buffer for the next recvmmsg
+        if (!workers_.empty())
+        {
+            slots_[i] = PacketPool::INVALID_INDEX;
+        }
+    }
+}
+
+void Listener::dispatch(Packet packet, bool truncated)
+{
+    if (truncated)
+    {
+        // the tail of the datagram is lost, keep the lines that made it in whole
+        auto             bytes = packet.data();
+        std::string_view payload{reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+        auto             end = payload.rfind('\n');
+        packet.length        = end == std::string_view::npos ? 0 : static_cast<uint32_t>(end);
+        aggregation::SelfStats::add(aggregation::SelfCounter::DatagramsTruncated);
+    }
+
+    aggregation::SelfStats::add(aggregation::SelfCounter::PacketsReceived, packet.datagrams());
+
+    if (workers_.empty())
+    {
+        packet.for_each_datagram([this](std::string_view payload)
+                                 { aggregator_.process(payload); });
+        aggregator_.tick();
+        return;
+    }
+
+    // ownership of the buffer moves to the worker, it is released back after parsing
+    auto& queue = workers_[current_worker_]->queue();
+    queue.push(packet,
+               [](Packet&& dropped)
+               {
+                   dropped.release();
+                   aggregation::SelfStats::add(aggregation::SelfCounter::QueueDrops);
+               });
+    pushed_++;
+
+    current_worker_++;
+    current_worker_ = current_worker_ % workers_.size();
+}
+
+void Listener::wake_workers() noexcept
+{
+    // pushes go round robin, so the workers pushed to are the ones just before current_worker_
+    std::size_t count = std::min(pushed_, workers_.size());
+    for (std::size_t i = 1; i <= count; i++)
+    {
+        workers_[(current_worker_ + workers_.size() - i) % workers_.size()]->wake();
+    }
+    pushed_ = 0;
+}
+
+std::size_t Listener::refill_slots() noexcept
+{
+    for (size_t i = 0; i < BATCH_SIZE; i++)
+    {
+        if (slots_[i] != PacketPool::INVALID_INDEX)
+        {
+            continue;
+        }
+
+        auto idx = pool_.acquire();
+        if (idx == PacketPool::INVALID_INDEX)
+        {
+            return i; // only the filled prefix can be handed to recvmmsg
+        }
+
+        auto buffer         = pool_.buffer(idx);
+        slots_[i]           = idx;
+        iovecs_[i].iov_base = buffer.data();
+        iovecs_[i].iov_len  = buffer.size();
+    }
+
+    return BATCH_SIZE;
+}
+
+void Listener::init_buffers()
+{
+    slots_.fill(PacketPool::INVALID_INDEX);
+
+    for (size_t i = 0; i < BATCH_SIZE; i++)
+    {
+        msgs_[i].msg_hdr.msg_iov    = &iovecs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+
+        msgs_[i].msg_hdr.msg_name    = &peers_[i];
+        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+
+        if (gro_)
+        {
+            msgs_[i].msg_hdr.msg_control    = controls_[i].data();
+            msgs_[i].msg_hdr.msg_controllen = GRO_CONTROL_SPACE;
+        }
+    }
+
+    refill_slots();
+}
+} // namespace metric_collector::ingestion
@@ -0,0 +1,138 @@
+#ifndef METRIC_COLLECTOR_INGESTION_LISTENER_HPP
+#define METRIC_COLLECTOR_INGESTION_LISTENER_HPP
+
+#include "aggregator.hpp"
+#include "packet_pool.hpp"
+#include "udp_gro.hpp"
+#include "uring_receiver.hpp"
+
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <bucket_ring.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <span>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+constexpr std::size_t MAX_EVENTS   = 64;
+constexpr std::size_t BATCH_SIZE   = 64;
+// default receive buffer per datagram: a 1500 byte MTU less the IPv4 and UDP headers, so
+// anything not fragmented on an ethernet path arrives whole
+constexpr std::size_t MAX_PACKET   = 1472;
+constexpr std::size_t MAX_DATAGRAM = 65507; // largest UDP payload over IPv4
+constexpr std::size_t POOL_SIZE    = 4096;
+// larger buffers get fewer of them, a pool never holds much more than this
+constexpr std::size_t POOL_BYTES = std::size_t{16} << 20;
+
+namespace metric_collector::ingestion
+{
+class Worker;
+
+enum class Backend : uint8_t
+{
+    Epoll,  // epoll_wait + recvmmsg into a fixed batch of slots
+    IoUring // multishot recvmsg from a provided buffer ring, falls back to Epoll if unsupported
+};
+
+struct ReceiveOptions
+{
+    Backend     backend{Backend::Epoll};
+    // datagrams up to this size are received whole, longer ones are cut at their last complete
+    // line and counted as truncated; at most MAX_DATAGRAM
+    std::size_t max_datagram{MAX_PACKET};
+    // UDP_GRO: the kernel may coalesce a run of datagrams from one flow into a single buffer,
+    // which is then split again by segment size; buffers grow to GRO_BUFFER
+    bool        gro{false};
+};
+
+// One SO_REUSEPORT socket with its own receive loop (epoll + recvmmsg or io_uring) and packet
+// pool. Received packets are either handed round robin to the listener's own workers (each
+// worker queue has exactly one producer) or, with inline parsing, aggregated directly on the
+// receive thread. Workers are woken once per receive batch, not once per packet.
+class Listener
+{
+  public:
+    // without workers the listener parses inline into ring
+    Listener(uint16_t port, const std::string& addr, aggregation::MetricRing& ring,
+             ReceiveOptions options = {});
+
+    ~Listener();
+
+    Listener(const Listener&)            = delete;
+    Listener& operator=(const Listener&) = delete;
+    Listener(Listener&&)                 = delete;
+    Listener& operator=(Listener&&)      = delete;
+
+    void add_worker(Worker& worker) { workers_.push_back(&worker); }
+
+    // runs until running is cleared
+    void run(const std::atomic<bool>& running);
+
+    // prefer packets handled by this cpu, the kernel compares it against the receiving cpu
+    void set_incoming_cpu(int cpu);
+
+    // what the listener actually runs after a possible fallback
+    [[nodiscard]] Backend backend() const noexcept
+    {
+        return uring_ != nullptr ? Backend::IoUring : Backend::Epoll;
+    }
+
+    // datagrams the kernel dropped because the socket's receive buffer was full
+    [[nodiscard]] uint64_t socket_drops() const noexcept;
+
+    [[nodiscard]] int               fd() const noexcept { return listen_fd_; }
+    [[nodiscard]] const PacketPool& pool() const noexcept { return pool_; }
+
+  private:
+    static std::size_t buffer_size(const ReceiveOptions& options) noexcept;
+    static std::size_t pool_size(std::size_t buffer_size) noexcept;
+
+    void init_buffers();
+
+    inline void       init_listen_socket(uint16_t port, const std::string& addr);
+    inline void       enable_gro();
+    inline void       init_epoll_socket();
+    static inline int set_non_blocking(int fd);
+
+    void run_epoll(const std::atomic<bool>& running);
+    void run_uring(const std::atomic<bool>& running);
+
+    void        drain_socket();
+    void        process_packets(size_t count);
+    void        dispatch(Packet packet, bool truncated);
+    void        wake_workers() noexcept;
+    std::size_t refill_slots() noexcept;
+
+    int  listen_fd_{-1};
+    int  epoll_fd_{-1};
+    bool backlogged_{false}; // pool ran dry before the socket was drained
+    bool gro_{false};
+
+    // must outlive the workers, they release packets back to it while draining
+    PacketPool                                pool_;
+    std::unique_ptr<UringReceiver>            uring_;
+    std::vector<Worker*>                      workers_;
+    std::size_t                               current_worker_{0};
+    std::size_t                               pushed_{0}; // since the last wake_workers()
+    Aggregator                                aggregator_; // inline parsing only
+    std::array<PacketPool::Index, BATCH_SIZE> slots_;
+    std::array<iovec, BATCH_SIZE>             iovecs_;
+    std::array<mmsghdr, BATCH_SIZE>           msgs_;
+    std::array<sockaddr_storage, BATCH_SIZE>  peers_;
+    // UDP_GRO control messages, one per slot
+    alignas(cmsghdr) std::array<std::array<char, GRO_CONTROL_SPACE>, BATCH_SIZE> controls_;
+    std::array<epoll_event, MAX_EVENTS>       events_;
+};
+} // namespace metric_collector::ingestion
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef METRIC_COLLECTOR_INGESTION_PACKET_POOL_HPP
+#define METRIC_COLLECTOR_INGESTION_PACKET_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace metric_collector::ingestion
+{
+
+// Preallocated slab of receive buffers. The receive thread acquires buffers, hands them to a
+// worker as a Packet and the worker releases them back once parsed. acquire() must only be
+// called from a single thread, release() may be called from any thread. Having a single
+// consumer keeps the free list immune to ABA without tagging the head.
+class PacketPool
+{
+  public:
+    using Index = uint32_t;
+
+    static constexpr Index       INVALID_INDEX = std::numeric_limits<Index>::max();
+    static constexpr std::size_t ALIGNMENT     = 64;
+
+    PacketPool(std::size_t num_buffers, std::size_t buffer_size)
+        : num_buffers_(num_buffers), buffer_size_(buffer_size),
+          stride_((buffer_size + ALIGNMENT - 1) & ~(ALIGNMENT - 1)),
+          storage_(std::make_unique<std::byte[]>(num_buffers_ * stride_ + ALIGNMENT)),
+          next_(std::make_unique<std::atomic<Index>[]>(num_buffers_))
+    {
+        assert(num_buffers_ > 0 && num_buffers_ < INVALID_INDEX);
+        assert(buffer_size_ > 0);
+
+        auto base = reinterpret_cast<std::uintptr_t>(storage_.get());
+        slab_     = storage_.get() + (((base + ALIGNMENT - 1) & ~(ALIGNMENT - 1)) - base);
+
+        for (std::size_t i = 0; i < num_buffers_; i++)
+        {
+            auto next = i + 1 < num_buffers_ ? static_cast<Index>(i + 1) : INVALID_INDEX;
+            next_[i].store(next, std::memory_order_relaxed);
+        }
+        free_head_.store(0, std::memory_order_release);
+    }
+
+    PacketPool(const PacketPool&)            = delete;
+    PacketPool(PacketPool&&)                 = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+    PacketPool& operator=(PacketPool&&)      = delete;
+
+    // single consumer only
+    [[nodiscard]] Index acquire() noexcept
+    {
+        Index head = free_head_.load(std::memory_order_acquire);
+        while (head != INVALID_INDEX)
+        {
+            Index next = next_[head].load(std::memory_order_relaxed);
+            if (free_head_.compare_exchange_weak(head, next, std::memory_order_acquire,
+                                                 std::memory_order_acquire))
+            {
+                return head;
+            }
+        }
+
+        // only the consumer writes this, avoid a locked RMW
+        exhausted_.store(exhausted_.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+        return INVALID_INDEX;
+    }
+
+    void release(Index idx) noexcept
+    {
+        assert(idx < num_buffers_);
+
+        Index head = free_head_.load(std::memory_order_relaxed);
+        do
+        {
+            next_[idx].store(head, std::memory_order_relaxed);
+        } while (!free_head_.compare_exchange_weak(head, idx, std::memory_order_release,
+                                                   std::memory_order_relaxed));
+    }
+
+    [[nodiscard]] std::span<std::byte> buffer(Index idx) const noexcept
+    {
+        assert(idx < num_buffers_);
+        return {slab_ + static_cast<std::size_t>(idx) * stride_, buffer_size_};
+    }
+
+    [[nodiscard]] std::size_t capacity() const noexcept { return num_buffers_; }
+    [[nodiscard]] std::size_t buffer_size() const noexcept { return buffer_size_; }
+
+    // number of acquire() calls that found the pool empty
+    [[nodiscard]] uint64_t exhausted() const noexcept
+    {
+        return exhausted_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::size_t                           num_buffers_;
+    std::size_t                           buffer_size_;
+    std::size_t                           stride_;
+    std::unique_ptr<std::byte[]>          storage_;
+    std::byte*                            slab_{nullptr};
+    std::unique_ptr<std::atomic<Index>[]> next_;
+
+    alignas(64) std::atomic<Index> free_head_{INVALID_INDEX};
+    alignas(64) std::atomic<uint64_t> exhausted_{0};
+};
+
+// Owning handle to a pool buffer, moved through the worker queue by value.
+struct Packet
+{
+    PacketPool*       pool{nullptr};
+    PacketPool::Index index{PacketPool::INVALID_INDEX};
+    uint32_t          length{0};
+    uint32_t          offset{0};  // payload start, io_uring puts a header in front of it
+    uint16_t          segment{0}; // UDP GRO: datagrams of this size back to back, 0 for one
+
+    [[nodiscard]] std::span<const std::byte> data() const noexcept
+    {
+        return pool->buffer(index).subspan(offset, length);
+    }
+
+    [[nodiscard]] uint32_t datagrams() const noexcept
+    {
+        return segment == 0 || length == 0 ? 1 : (length + segment - 1) / segment;
+    }
+
+    // calls func(std::string_view) with the payload of every datagram in the buffer
+    template <typename F> void for_each_datagram(F&& func) const
+    {
+        auto        bytes = data();
+        const char* chars = reinterpret_cast<const char*>(bytes.data());
+        std::size_t step  = segment == 0 ? bytes.size() : segment;
+        std::size_t pos   = 0;
+        do
+        {
+            std::size_t size = std::min(step, bytes.size() - pos);
+            func(std::string_view{chars + pos, size});
+            pos += size;
+        } while (pos < bytes.size());
+    }
+
+    void release() noexcept { pool->release(index); }
+};
+
+} // namespace metric_collector::ingestion
+
+#endif
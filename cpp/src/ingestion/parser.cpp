@@ -0,0 +1,164 @@
+#include "parser.hpp"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace metric_collector::ingestion
+{
+namespace
+{
+constexpr uint64_t LOW_7_BITS = 0x7F7F7F7F7F7F7F7FULL;
+
+// high bit set in every byte of word equal to c, without false positives from carries
+inline uint64_t swar_match(uint64_t word, char c)
+{
+    uint64_t t = word ^ (0x0101010101010101ULL * static_cast<unsigned char>(c));
+    return ~(((t & LOW_7_BITS) + LOW_7_BITS) | t | LOW_7_BITS);
+}
+
+// portable fallback, eight bytes at a time in general purpose registers
+void classify_scalar(const char* data, std::size_t len, uint64_t* masks)
+{
+    for (std::size_t block = 0; block * 64 < len; block++)
+    {
+        uint64_t bits = 0;
+        for (std::size_t i = block * 64; i < std::min(len, block * 64 + 64); i += 8)
+        {
+            uint64_t    word  = 0;
+            std::size_t bytes = std::min<std::size_t>(8, len - i);
+            std::memcpy(&word, data + i, bytes);
+
+            uint64_t hits = swar_match(word, '\n') | swar_match(word, ':') | swar_match(word, '|');
+            // gather the high bit of each byte into the low 8 bits
+            uint64_t byte_mask = ((hits >> 7) * 0x0102040810204080ULL) >> 56;
+            bits |= byte_mask << (i - block * 64);
+        }
+        masks[block] = bits;
+    }
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+// Three byte compares per vector beat pcmpistrm for a three character set, so the 128-bit path
+// sticks to SSE2 which every x86_64 cpu has.
+inline uint64_t classify_block_sse2(const char* block)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i colon   = _mm_set1_epi8(':');
+    const __m128i pipe    = _mm_set1_epi8('|');
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i v   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, colon)),
+            _mm_cmpeq_epi8(v, pipe));
+        bits |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hit))) << (i * 16);
+    }
+    return bits;
+}
+
+__attribute__((target("avx2"))) inline uint64_t classify_block_avx2(const char* block)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i colon   = _mm256_set1_epi8(':');
+    const __m256i pipe    = _mm256_set1_epi8('|');
+
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+
+    __m256i hit_lo = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(lo, newline), _mm256_cmpeq_epi8(lo, colon)),
+        _mm256_cmpeq_epi8(lo, pipe));
+    __m256i hit_hi = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(hi, newline), _mm256_cmpeq_epi8(hi, colon)),
+        _mm256_cmpeq_epi8(hi, pipe));
+
+    return static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit_lo))) |
+           (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit_hi))) << 32);
+}
+
+// Full blocks are read in place; the tail is copied into a zero padded block, NUL is not a
+// delimiter so the padding never sets a bit.
+template <uint64_t (*ClassifyBlock)(const char*)>
+inline void classify_blocks(const char* data, std::size_t len, uint64_t* masks)
+{
+    std::size_t full = len / 64;
+    for (std::size_t block = 0; block < full; block++)
+    {
+        masks[block] = ClassifyBlock(data + block * 64);
+    }
+
+    if (len % 64 != 0)
+    {
+        alignas(64) char tail[64] = {};
+        std::memcpy(tail, data + full * 64, len % 64);
+        masks[full] = ClassifyBlock(tail);
+    }
+}
+
+void classify_sse2(const char* data, std::size_t len, uint64_t* masks)
+{
+    classify_blocks<classify_block_sse2>(data, len, masks);
+}
+
+__attribute__((target("avx2"))) void classify_avx2(const char* data, std::size_t len,
+                                                   uint64_t* masks)
+{
+    classify_blocks<classify_block_avx2>(data, len, masks);
+}
+#endif
+
+detail::ClassifyFn classifier_for(SimdLevel level)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    switch (level)
+    {
+    case SimdLevel::Avx2:
+        return classify_avx2;
+    case SimdLevel::Sse2:
+        return classify_sse2;
+    case SimdLevel::Scalar:
+        break;
+    }
+#else
+    (void)level;
+#endif
+    return classify_scalar;
+}
+
+std::atomic<SimdLevel>          active_level{detect_simd_level()};
+std::atomic<detail::ClassifyFn> active_classifier{classifier_for(active_level.load())};
+} // namespace
+
+detail::ClassifyFn detail::classifier() noexcept
+{
+    return active_classifier.load(std::memory_order_relaxed);
+}
+
+SimdLevel detect_simd_level() noexcept
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SimdLevel::Avx2;
+    }
+    return SimdLevel::Sse2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel simd_level() noexcept { return active_level.load(std::memory_order_relaxed); }
+
+void set_simd_level(SimdLevel level) noexcept
+{
+    level = std::min(level, detect_simd_level());
+    active_level.store(level, std::memory_order_relaxed);
+    active_classifier.store(classifier_for(level), std::memory_order_relaxed);
+}
+} // namespace metric_collector::ingestion
@@ -1,5 +1,17 @@
+#ifndef METRIC_COLLECTOR_INGESTION_PARSER_HPP
+#define METRIC_COLLECTOR_INGESTION_PARSER_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <hash.hpp>
 #include <metrics.hpp>
+#include <new>
+#include <string_view>
 
 namespace metric_collector::ingestion
 {
@@ -9,30 +21,168 @@ concept MetricCallback =
         { func(name, type, value) } -> std::same_as<void>;
     };
 
+enum class SimdLevel : uint8_t
+{
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// value is the number, or for sets the hash of the member, which can be any string
+struct ParsedMetric
+{
+    std::string_view        name;
+    aggregation::MetricType type;
+    uint64_t                value;
+};
+
+// Fixed capacity output of Parser::parse_batch, reused across packets. Slots are raw storage so a
+// batch on the stack costs nothing until lines are pushed.
+class MetricBatch
+{
+  public:
+    static constexpr std::size_t CAPACITY = 256;
+
+    void push(const ParsedMetric& metric) noexcept
+    {
+        ::new (&items_[size_++]) ParsedMetric(metric);
+    }
+    // a non empty line that is not a metric
+    void reject() noexcept { rejected_++; }
+    void clear() noexcept
+    {
+        size_     = 0;
+        rejected_ = 0;
+    }
+
+    [[nodiscard]] bool        full() const noexcept { return size_ == CAPACITY; }
+    [[nodiscard]] bool        empty() const noexcept { return size_ == 0; }
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    [[nodiscard]] std::size_t rejected() const noexcept { return rejected_; }
+
+    [[nodiscard]] const ParsedMetric* begin() const noexcept { return data(); }
+    [[nodiscard]] const ParsedMetric* end() const noexcept { return data() + size_; }
+
+  private:
+    struct alignas(ParsedMetric) Slot
+    {
+        std::byte bytes[sizeof(ParsedMetric)];
+    };
+
+    [[nodiscard]] const ParsedMetric* data() const noexcept
+    {
+        return std::launder(reinterpret_cast<const ParsedMetric*>(items_.data()));
+    }
+
+    std::array<Slot, CAPACITY> items_;
+    std::size_t                size_{0};
+    std::size_t                rejected_{0};
+};
+
+// Delimiter classification is done for a whole chunk of the datagram at a time: every byte that
+// is '\n', ':' or '|' gets its bit set in one 64-bit mask per 64 bytes. The line walker then
+// jumps from delimiter to delimiter instead of running three find() scans per line.
+namespace detail
+{
+constexpr std::size_t CLASSIFY_CHUNK = 1024;
+constexpr std::size_t CHUNK_MASKS    = CLASSIFY_CHUNK / 64;
+
+using ClassifyFn = void (*)(const char* data, std::size_t len, uint64_t* masks);
+
+[[nodiscard]] ClassifyFn classifier() noexcept;
+} // namespace detail
+
+// runtime dispatch, defaults to the widest level the cpu supports
+[[nodiscard]] SimdLevel detect_simd_level() noexcept;
+[[nodiscard]] SimdLevel simd_level() noexcept;
+// clamped to the detected level, meant for benchmarks and comparisons
+void set_simd_level(SimdLevel level) noexcept;
+
 class Parser
 {
   public:
+    // returns the number of lines that were not metrics
     template <MetricCallback Callback>
-    static void parse_packet(std::string_view packet, Callback&& cb)
+    static std::size_t parse_packet(std::string_view packet, Callback&& cb)
     {
-        size_t pos = 0;
+        MetricBatch batch;
+        std::size_t pos      = 0;
+        std::size_t rejected = 0;
 
         while (pos < packet.size())
         {
-            size_t end = packet.find('\n', pos);
-            if (end == std::string_view::npos)
+            pos += parse_batch(packet.substr(pos), batch);
+
+            for (const auto& metric : batch)
             {
-                end = packet.size();
+                cb(metric.name, metric.type, metric.value);
             }
+            rejected += batch.rejected();
+            batch.clear();
+        }
+
+        return rejected;
+    }
+
+    // Parses whole lines into batch until the packet or the batch is exhausted, returns the
+    // number of bytes consumed so the caller can resume after draining the batch.
+    static std::size_t parse_batch(std::string_view packet, MetricBatch& batch)
+    {
+        if (batch.full())
+        {
+            return 0;
+        }
+
+        std::array<uint64_t, detail::CHUNK_MASKS> masks;
+
+        auto        classify   = detail::classifier();
+        std::size_t line_start = 0;
+        std::size_t colon      = std::string_view::npos;
+        std::size_t pipe       = std::string_view::npos;
+
+        for (std::size_t chunk = 0; chunk < packet.size(); chunk += detail::CLASSIFY_CHUNK)
+        {
+            std::size_t len = std::min(detail::CLASSIFY_CHUNK, packet.size() - chunk);
+            classify(packet.data() + chunk, len, masks.data());
 
-            std::string_view line = packet.substr(pos, end - pos);
-            if (!line.empty())
+            for (std::size_t block = 0; block * 64 < len; block++)
             {
-                parse_metric(line, cb);
-            }
+                for (uint64_t bits = masks[block]; bits != 0; bits &= bits - 1)
+                {
+                    std::size_t pos = chunk + block * 64 + std::countr_zero(bits);
+
+                    switch (packet[pos])
+                    {
+                    case ':':
+                        if (colon == std::string_view::npos)
+                        {
+                            colon = pos;
+                        }
+                        break;
+                    case '|':
+                        if (colon != std::string_view::npos && pipe == std::string_view::npos)
+                        {
+                            pipe = pos;
+                        }
+                        break;
+                    default: // '\n'
+                        emit_line(packet, line_start, colon, pipe, pos, batch);
+                        line_start = pos + 1;
+                        colon      = std::string_view::npos;
+                        pipe       = std::string_view::npos;
 
-            pos = end + 1;
+                        if (batch.full())
+                        {
+                            return line_start;
+                        }
+                        break;
+                    }
+                }
+            }
         }
+
+        emit_line(packet, line_start, colon, pipe, packet.size(), batch);
+        return packet.size();
     }
 
     template <MetricCallback Callback>
@@ -54,6 +204,13 @@ class Parser
         std::string_view value_sv = line.substr(colon + 1, pipe - colon - 1);
         std::string_view type_sv  = line.substr(pipe + 1);
 
+        auto type = aggregation::StringToMetricType(type_sv);
+        if (type == aggregation::MetricType::Set)
+        {
+            cb(name, type, aggregation::hash_bytes(value_sv.data(), value_sv.size()));
+            return;
+        }
+
         uint64_t value{};
         auto     res = std::from_chars(value_sv.data(), value_sv.data() + value_sv.size(), value);
         if (res.ec != std::errc{})
@@ -61,9 +218,103 @@ class Parser
             return;
         }
 
-        auto type = aggregation::StringToMetricType(type_sv);
-
         cb(name, type, value);
     }
+
+  private:
+    static void emit_line(std::string_view packet, std::size_t start, std::size_t colon,
+                          std::size_t pipe, std::size_t end, MetricBatch& batch)
+    {
+        if (start == end)
+        {
+            return; // empty line, e.g. after the trailing newline
+        }
+
+        if (colon == std::string_view::npos || pipe == std::string_view::npos)
+        {
+            batch.reject();
+            return;
+        }
+
+        auto     type = parse_type(packet, pipe + 1, end);
+        uint64_t value{};
+        if (type == aggregation::MetricType::Invalid)
+        {
+            batch.reject();
+            return;
+        }
+        if (type == aggregation::MetricType::Set)
+        {
+            value = aggregation::hash_bytes(packet.data() + colon + 1, pipe - colon - 1);
+        }
+        else if (!parse_value(packet, colon + 1, pipe, value))
+        {
+            batch.reject();
+            return;
+        }
+
+        batch.push({packet.substr(start, colon - start), type, value});
+    }
+
+    // With the value's bounds already known from the delimiter bitmap, values of up to eight
+    // digits are converted in a handful of multiplies instead of a branch per digit. The 8 bytes
+    // ending at the pipe are loaded at once, the bytes before the value replaced by '0'.
+    static bool parse_value(std::string_view packet, std::size_t first, std::size_t last,
+                            uint64_t& value)
+    {
+        constexpr uint64_t ZEROS = 0x3030303030303030ULL;
+
+        std::size_t len = last - first;
+        if (len > 0 && len <= 8 && last >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, packet.data() + last - 8, sizeof(word));
+
+            uint64_t keep = ~uint64_t{0} << (8 * (8 - len)); // little endian: the value's bytes
+            word          = (word & keep) | (ZEROS & ~keep);
+
+            // every byte in '0'..'9'
+            if ((word & 0xF0F0F0F0F0F0F0F0ULL) == ZEROS &&
+                ((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) == ZEROS)
+            {
+                word  = word - ZEROS;
+                word  = (word * 10) + (word >> 8);
+                value = (((word & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+                         (((word >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >>
+                        32;
+                return true;
+            }
+        }
+
+        // longer values and anything that is not all digits keep from_chars semantics
+        auto res = std::from_chars(packet.data() + first, packet.data() + last, value);
+        return res.ec == std::errc{};
+    }
+
+    // single letter types resolved without a compare chain, anything else by StringToMetricType
+    static aggregation::MetricType parse_type(std::string_view packet, std::size_t first,
+                                              std::size_t last)
+    {
+        if (last - first != 1)
+        {
+            return aggregation::StringToMetricType(packet.substr(first, last - first));
+        }
+
+        return TYPE_TABLE[static_cast<unsigned char>(packet[first])];
+    }
+
+    static constexpr std::array<aggregation::MetricType, 256> TYPE_TABLE = []
+    {
+        std::array<aggregation::MetricType, 256> table{};
+        table.fill(aggregation::MetricType::Invalid);
+        for (std::size_t c = 0; c < table.size(); c++)
+        {
+            char type[] = {static_cast<char>(c)};
+            table[c]    = aggregation::StringToMetricType(std::string_view(type, 1));
+        }
+        return table;
+    }();
 };
-} // namespace metric_collector::ingestion
\ No newline at end of file
+} // namespace metric_collector::ingestion
+
+#endif
@@ -1,23 +1,47 @@
 #ifndef METRIC_COLLECTOR_INGESTION_SPSC_QUEUE
 #define METRIC_COLLECTOR_INGESTION_SPSC_QUEUE
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <span>
+#include <thread>
 #include <type_traits>
+#include <utility>
 
 namespace metric_collector::ingestion
 {
+// What push() does when the queue is full.
+enum class FullPolicy : uint8_t
+{
+    DropNewest, // the element being pushed is handed back to the producer
+    DropOldest, // the oldest queued element is taken out and handed back to the producer
+    Block       // the producer waits for the consumer to make room
+};
 
-template <typename T, std::size_t Capacity> class SpscQueue
+// Bounded single producer single consumer ring. Each side owns its index on its own cache line
+// and keeps a cached copy of the other side's, so the shared line is only read again when the
+// cached value says the queue looks full (producer) or empty (consumer).
+// DropOldest needs the producer to take an element the consumer may be about to read, so with
+// that policy the consumer claims a range with a CAS on read_pos_ before reading it and then
+// publishes done_pos_; the producer evicts with the same CAS and only overwrites a slot the
+// consumer has finished with. The other policies keep the plain load/store protocol.
+// Dropped elements are passed to the caller's on_drop so owned resources can be released and
+// the drop counted, the queue keeps no count of its own.
+template <typename T, std::size_t Capacity, FullPolicy Policy = FullPolicy::DropNewest>
+class SpscQueue
 {
     static_assert(Capacity > 0, "Capacity must be positive number");
     static_assert(((Capacity & (Capacity - 1)) == 0), "Capacity must be power of two number");
     static_assert((std::is_nothrow_move_assignable_v<T> || std::is_nothrow_copy_assignable_v<T>),
                   "T must be nothrow move assignable or copy-assignable");
 
-    static constexpr std::size_t MASK = Capacity - 1;
+    static constexpr std::size_t MASK           = Capacity - 1;
+    static constexpr std::size_t CACHE_LINE     = 64;
+    static constexpr bool        CLAIMS_TO_READ = Policy == FullPolicy::DropOldest;
 
   public:
     SpscQueue() = default;
@@ -27,48 +51,198 @@ template <typename T, std::size_t Capacity> class SpscQueue
     SpscQueue& operator=(const SpscQueue&) = delete;
     SpscQueue& operator=(SpscQueue&&)      = delete;
 
-    void push(const T& item) noexcept
+    // producer only, false if the queue is full whatever the policy
+    [[nodiscard]] bool try_push(const T& item) noexcept { return try_push_n({&item, 1}) == 1; }
+
+    // producer only, pushes the longest prefix of items that fits and returns its length
+    std::size_t try_push_n(std::span<const T> items) noexcept
     {
-        const auto wp   = write_pos_.load(std::memory_order_relaxed);
-        auto       rp   = read_pos_.load(std::memory_order_acquire);
-        auto       next = wp + 1;
+        const auto  wp = write_pos_.load(std::memory_order_relaxed);
+        std::size_t n  = std::min(items.size(), free_slots(wp, items.size()));
 
-        // buffer full drop older element
-        if (next - rp > Capacity)
+        for (std::size_t i = 0; i < n; i++)
         {
-            read_pos_.store(rp + 1, std::memory_order_release);
+            buffer_[(wp + i) & MASK] = items[i];
         }
+        write_pos_.store(wp + n, std::memory_order_release);
+        return n;
+    }
 
-        buffer_[wp & MASK] = item;
-        write_pos_.store(next, std::memory_order_release);
+    // producer only, applies Policy when full; on_drop(T&&) receives whatever was dropped
+    template <typename F> void push(const T& item, F&& on_drop) noexcept
+    {
+        push_n({&item, 1}, std::forward<F>(on_drop));
     }
 
-    [[nodiscard]] std::optional<T> pop() noexcept
+    template <typename F> void push_n(std::span<const T> items, F&& on_drop) noexcept
     {
-        auto rp = read_pos_.load(std::memory_order_acquire);
-        auto wp = write_pos_.load(std::memory_order_acquire);
+        while (!items.empty())
+        {
+            std::size_t n = try_push_n(items);
+            items         = items.subspan(n);
+            if (items.empty())
+            {
+                return;
+            }
+
+            if constexpr (Policy == FullPolicy::DropNewest)
+            {
+                for (const T& item : items)
+                {
+                    on_drop(T(item));
+                }
+                return;
+            }
+            else if constexpr (Policy == FullPolicy::DropOldest)
+            {
+                if (!evict_oldest(on_drop))
+                {
+                    std::this_thread::yield(); // the consumer is reading it, only briefly
+                }
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
 
-        if (rp == wp)
+    // consumer only
+    [[nodiscard]] std::optional<T> pop() noexcept
+    {
+        T item;
+        if (pop_n({&item, 1}) == 0)
         {
             return std::nullopt;
         }
-
-        auto item = std::move(buffer_[rp & MASK]);
-        read_pos_.store(rp + 1, std::memory_order_release);
         return item;
     }
 
+    // consumer only, moves up to out.size() elements into out and returns how many
+    std::size_t pop_n(std::span<T> out) noexcept
+    {
+        while (true)
+        {
+            auto rp = read_pos_.load(CLAIMS_TO_READ ? std::memory_order_acquire
+                                                    : std::memory_order_relaxed);
+
+            // evictions can move rp past a stale cached_write_, that wraps above Capacity
+            std::size_t available = cached_write_ - rp;
+            if (available == 0 || available > Capacity)
+            {
+                cached_write_ = write_pos_.load(std::memory_order_acquire);
+                available     = cached_write_ - rp;
+                if (available == 0)
+                {
+                    return 0;
+                }
+            }
+
+            std::size_t n = std::min(out.size(), available);
+            if constexpr (CLAIMS_TO_READ)
+            {
+                if (!read_pos_.compare_exchange_strong(rp, rp + n, std::memory_order_acq_rel,
+                                                       std::memory_order_acquire))
+                {
+                    continue; // the producer evicted the head in between
+                }
+            }
+
+            for (std::size_t i = 0; i < n; i++)
+            {
+                out[i] = std::move(buffer_[(rp + i) & MASK]);
+            }
+
+            if constexpr (CLAIMS_TO_READ)
+            {
+                done_pos_.store(rp + n, std::memory_order_release);
+            }
+            else
+            {
+                read_pos_.store(rp + n, std::memory_order_release);
+            }
+            return n;
+        }
+    }
+
     [[nodiscard]] bool empty() const noexcept
     {
         return read_pos_.load(std::memory_order_acquire) ==
                write_pos_.load(std::memory_order_acquire);
     }
 
+    // elements queued, from either side; only a hint while the other side is running
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        auto wp = write_pos_.load(std::memory_order_acquire);
+        auto rp = read_pos_.load(std::memory_order_acquire);
+        return wp > rp ? wp - rp : 0;
+    }
+
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+
   private:
-    std::array<T, Capacity>  buffer_;
-    std::atomic<std::size_t> write_pos_{0};
-    std::atomic<std::size_t> read_pos_{0};
+    // slots the producer may write from wp on, refreshing its cached view only when wanted
+    // exceeds what the cache allows
+    std::size_t free_slots(std::size_t wp, std::size_t wanted) noexcept
+    {
+        std::size_t free = Capacity - (wp - cached_done_);
+        if (free < wanted)
+        {
+            // after an eviction the cache is ahead of what the consumer published, keep it
+            auto done    = done_position().load(std::memory_order_acquire);
+            cached_done_ = std::max(cached_done_, done);
+            free         = Capacity - (wp - cached_done_);
+        }
+        return free;
+    }
+
+    // the position every slot before which the consumer is done with
+    std::atomic<std::size_t>& done_position() noexcept
+    {
+        if constexpr (CLAIMS_TO_READ)
+        {
+            return done_pos_;
+        }
+        else
+        {
+            return read_pos_;
+        }
+    }
+
+    // full means the slot for wp still holds wp - Capacity; take it unless the consumer already
+    // claimed it, in which case try_push_n succeeds as soon as it is done reading
+    template <typename F> bool evict_oldest(F& on_drop) noexcept
+    {
+        const auto wp     = write_pos_.load(std::memory_order_relaxed);
+        auto       oldest = wp - Capacity;
+
+        if (read_pos_.compare_exchange_strong(oldest, oldest + 1, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed))
+        {
+            T item = std::move(buffer_[oldest & MASK]);
+
+            // the slot is ours now, let the retried try_push_n reuse it
+            cached_done_ = oldest + 1;
+            on_drop(std::move(item));
+            return true;
+        }
+        return false;
+    }
+
+    // producer line
+    alignas(CACHE_LINE) std::atomic<std::size_t> write_pos_{0};
+    std::size_t cached_done_{0};
+
+    // consumer line
+    alignas(CACHE_LINE) std::atomic<std::size_t> read_pos_{0};
+    std::size_t cached_write_{0};
+
+    // DropOldest only, how far the consumer has finished reading what it claimed
+    alignas(CACHE_LINE) std::atomic<std::size_t> done_pos_{0};
+
+    alignas(CACHE_LINE) std::array<T, Capacity> buffer_;
 };
 } // namespace metric_collector::ingestion
 
-#endif
\ No newline at end of file
+#endif
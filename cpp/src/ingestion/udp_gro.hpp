@@ -0,0 +1,35 @@
+#ifndef METRIC_COLLECTOR_INGESTION_UDP_GRO_HPP
+#define METRIC_COLLECTOR_INGESTION_UDP_GRO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+namespace metric_collector::ingestion
+{
+// With UDP_GRO set on a socket the kernel may hand over a run of datagrams from one flow as a
+// single buffer: every datagram but the last is gso_size bytes long and the size comes along as
+// a control message. A coalesced buffer is never longer than this.
+constexpr std::size_t GRO_BUFFER        = 1 << 16;
+constexpr std::size_t GRO_CONTROL_SPACE = CMSG_SPACE(sizeof(int));
+
+// the gso_size of a received message, 0 if it holds a single datagram
+inline uint16_t gro_segment_size(const msghdr& msg) noexcept
+{
+    for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg       = CMSG_NXTHDR(const_cast<msghdr*>(&msg), cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            int size = 0;
+            std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return static_cast<uint16_t>(size);
+        }
+    }
+    return 0;
+}
+} // namespace metric_collector::ingestion
+
+#endif
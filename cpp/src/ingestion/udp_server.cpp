@@ -1,112 +1,121 @@
 #include "udp_server.hpp"
 
+#include "cpu_affinity.hpp"
 #include "worker.hpp"
 
-#include <cassert>
+#include <array>
 #include <cstring>
 #include <iostream>
-#include <span>
+#include <linux/filter.h>
+#include <self_stats.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <utility>
 
 namespace metric_collector::ingestion
 {
-UdpServer::UdpServer(uint16_t port, std::string addr, std::size_t num_of_workers)
-    : port_(port), addr_(std::move(addr)), num_of_workers_(num_of_workers)
+UdpServer::UdpServer(uint16_t port, std::string addr, std::size_t num_of_workers,
+                     aggregation::MetricRing& ring)
+    : UdpServer(
+          UdpServerOptions{.port = port, .addr = std::move(addr), .num_workers = num_of_workers},
+          ring)
 {
-    assert(num_of_workers_ > 0);
-
-    for (std::size_t i{0}; i < num_of_workers_; i++)
-    {
-        workers_.emplace_back(std::make_unique<Worker>());
-    }
-
-    init_buffers();
-    init_listen_socket();
-    init_epoll_socket();
 }
 
-UdpServer::~UdpServer()
+UdpServer::UdpServer(UdpServerOptions options, aggregation::MetricRing& ring)
+    : options_(std::move(options))
 {
-    if (listen_fd_ >= 0)
+    for (std::size_t c = 0; c < aggregation::SELF_COUNTERS; c++)
     {
-        close(listen_fd_);
+        auto counter       = static_cast<aggregation::SelfCounter>(c);
+        counted_before_[c] = aggregation::SelfStats::total(counter);
     }
 
-    if (epoll_fd_ >= 0)
+    if (options_.num_listeners == 0)
     {
-        close(epoll_fd_);
+        std::cerr << "---> a UdpServer needs at least one listener\n";
+        throw std::runtime_error("no listeners");
     }
-}
-
-void UdpServer::init_epoll_socket()
-{
-    epoll_fd_ = epoll_create1(0);
-    if (epoll_fd_ == -1)
+    // a listener without a worker would quietly parse inline
+    if (!options_.inline_parse && options_.num_workers < options_.num_listeners)
     {
-        std::cerr << "---> epoll_create1() failed: " << strerror(errno) << "\n";
-        throw std::runtime_error("epoll_create1() failed");
+        std::cerr << "---> " << options_.num_workers << " workers cannot serve "
+                  << options_.num_listeners << " listeners, every listener needs one\n";
+        throw std::runtime_error("fewer workers than listeners");
     }
 
-    struct epoll_event event;
-    event.events  = EPOLLIN | EPOLLET;
-    event.data.fd = listen_fd_;
-
-    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) == -1)
+    // every socket joins the same reuseport group, the bind order is the group index
+    for (std::size_t i{0}; i < options_.num_listeners; i++)
     {
-        std::cerr << "---> epoll_ctl() failed: " << strerror(errno) << "\n";
-        throw std::runtime_error("epoll_ctl() failed");
+        listeners_.emplace_back(construct_on(
+            cpu_for(options_.listener_cpus, i),
+            [this, &ring]()
+            {
+                return std::make_unique<Listener>(
+                    options_.port, options_.addr, ring,
+                    ReceiveOptions{.backend      = options_.backend,
+                                   .max_datagram = options_.max_datagram,
+                                   .gro          = options_.udp_gro});
+            }));
     }
-}
 
-void UdpServer::init_listen_socket()
-{
-    listen_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
-    if (listen_fd_ < 0)
+    if (!options_.inline_parse)
     {
-        std::cerr << "---> socket() failed: " << strerror(errno) << "\n";
-        throw std::runtime_error("socket() failed");
+        for (std::size_t i{0}; i < options_.num_workers; i++)
+        {
+            auto cpu = cpu_for(options_.worker_cpus, i);
+            workers_.emplace_back(
+                construct_on(cpu, [&ring]() { return std::make_unique<Worker>(ring); }));
+            listeners_[i % listeners_.size()]->add_worker(*workers_.back());
+        }
     }
 
-    // allow reuse of port and addr
-    int yes = 1;
-    if (setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0)
+    switch (options_.steering)
     {
-        std::cerr << "---> setsockopt(SO_REUSEADDR) failed: " << strerror(errno) << "\n";
-        throw std::runtime_error("socket() failed");
-    }
-    if (setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0)
-    {
-        std::cerr << "---> setsockopt(SO_REUSEPORT) failed: " << strerror(errno) << "\n";
-        throw std::runtime_error("socket() failed");
+    case Steering::None:
+        break;
+    case Steering::IncomingCpu:
+        for (std::size_t i{0}; i < listeners_.size(); i++)
+        {
+            auto cpu = cpu_for(options_.listener_cpus, i);
+            listeners_[i]->set_incoming_cpu(cpu == ANY_CPU ? static_cast<int>(i) : cpu);
+        }
+        break;
+    case Steering::CpuBpf:
+        attach_cpu_steering();
+        break;
     }
+}
 
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port   = htons(port_);
-    inet_pton(AF_INET, addr_.data(), &addr.sin_addr);
+UdpServer::~UdpServer() = default;
 
-    if (bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0)
-    {
-        std::cerr << "---> socket() failed: " << strerror(errno) << "\n";
-        throw std::runtime_error("socket() failed");
-    }
-
-    if (set_non_blocking(listen_fd_) < 0)
+void UdpServer::attach_cpu_steering()
+{
+    // classic BPF: a packet received on a listener's cpu goes to that listener, any other cpu
+    // picks the socket index as the cpu modulo the group size
+    auto                     group = static_cast<uint32_t>(listeners_.size());
+    std::vector<sock_filter> code{
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)}};
+    for (std::size_t i{0}; i < options_.listener_cpus.size() && i < listeners_.size(); i++)
     {
-        std::cerr << "---> set_non_blocking() failed: " << strerror(errno) << "\n";
-        throw std::runtime_error("set_non_blocking() failed");
+        // on a match fall through to the return, otherwise skip it
+        code.push_back({BPF_JMP | BPF_JEQ | BPF_K, 0, 1,
+                        static_cast<uint32_t>(options_.listener_cpus[i])});
+        code.push_back({BPF_RET | BPF_K, 0, 0, static_cast<uint32_t>(i)});
     }
-}
+    code.push_back({BPF_ALU | BPF_MOD | BPF_K, 0, 0, group});
+    code.push_back({BPF_RET | BPF_A, 0, 0, 0});
+    sock_fprog prog{static_cast<unsigned short>(code.size()), code.data()};
 
-int UdpServer::set_non_blocking(int fd)
-{
-    auto flags = fcntl(fd, F_GETFL, 0);
-    if (flags == -1)
+    // attaching to any member applies to the whole group
+    if (setsockopt(listeners_.front()->fd(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                   sizeof(prog)) < 0)
     {
-        return -1;
+        std::cerr << "---> setsockopt(SO_ATTACH_REUSEPORT_CBPF) failed: " << strerror(errno)
+                  << "\n";
+        throw std::runtime_error("setsockopt(SO_ATTACH_REUSEPORT_CBPF) failed");
     }
-    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
 void UdpServer::stop()
@@ -117,89 +126,65 @@ void UdpServer::stop()
 
 void UdpServer::run()
 {
-    std::cout << "---> Server starting at: " << addr_ << "\n";
+    std::cout << "---> Server starting at: " << options_.addr << " with "
+              << options_.num_listeners << " listener(s)\n";
     running_.store(true);
 
-    while (running_.load(std::memory_order_acquire))
+    for (std::size_t i{0}; i < workers_.size(); i++)
     {
-        int n = epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), 100);
-        if (n < 0)
-        {
-            if (errno == EINTR)
-            {
-                continue;
-            }
-            std::cerr << "---> epoll_wait() failed with error: " << strerror(errno) << "\n";
-            break;
-        }
-
-        if (n == 0)
-        {
-            continue; // no packet received
-        }
-
-        for (std::size_t i = 0; i < n; i++)
-        {
-            if (events_[i].data.fd != listen_fd_)
-            {
-                continue;
-            }
-
-            drain_socket();
-        }
+        workers_[i]->start("worker" + std::to_string(i), cpu_for(options_.worker_cpus, i));
     }
-}
 
-void UdpServer::drain_socket()
-{
-    while (true)
+    std::vector<std::thread> threads;
+    for (std::size_t i{1}; i < listeners_.size(); i++)
     {
-        int r = recvmmsg(listen_fd_, msgs_.data(), BATCH_SIZE, MSG_DONTWAIT, nullptr);
-        if (r < 0)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
+        threads.emplace_back(
+            [this, i]()
             {
-                break; // no more data
-            }
+                pin_thread(cpu_for(options_.listener_cpus, i));
+                aggregation::SelfStats::name_thread("listener" + std::to_string(i));
+                listeners_[i]->run(running_);
+            });
+    }
 
-            std::cerr << "---> recvmmsg() failed" << strerror(errno) << "\n";
-        }
+    pin_thread(cpu_for(options_.listener_cpus, 0));
+    aggregation::SelfStats::name_thread("listener0");
+    listeners_.front()->run(running_);
 
-        if (r == 0)
-        {
-            break;
-        }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
 
-        process_packets(r);
+    for (auto& worker : workers_)
+    {
+        worker->stop();
     }
 }
 
-void UdpServer::process_packets(size_t count)
+uint64_t UdpServer::pool_exhausted() const noexcept
 {
-    for (size_t i = 0; i < count; i++)
+    uint64_t total = 0;
+    for (const auto& listener : listeners_)
     {
-        std::span<std::byte> packet{buffers_[i].data(), msgs_[i].msg_len}; // received data
-        auto&                queue = workers_.at(current_worker_)->queue();
-
-        queue.push(packet);
-
-        current_worker_++;
-        current_worker_ = current_worker_ % num_of_workers_;
+        total += listener->pool().exhausted();
     }
+    return total;
 }
 
-void UdpServer::init_buffers()
+uint64_t UdpServer::socket_drops() const noexcept
 {
-    for (size_t i = 0; i < BATCH_SIZE; i++)
+    uint64_t total = 0;
+    for (const auto& listener : listeners_)
     {
-        iovecs_[i].iov_base = buffers_[i].data();
-        iovecs_[i].iov_len  = buffers_[i].size();
-
-        msgs_[i].msg_hdr.msg_iov    = &iovecs_[i];
-        msgs_[i].msg_hdr.msg_iovlen = 1;
-
-        msgs_[i].msg_hdr.msg_name    = &peers_[i];
-        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        total += listener->socket_drops();
     }
+    return total;
+}
+
+uint64_t UdpServer::counted(aggregation::SelfCounter counter) const
+{
+    return aggregation::SelfStats::total(counter) -
+           counted_before_[static_cast<std::size_t>(counter)];
 }
 } // namespace metric_collector::ingestion
@@ -1,65 +1,90 @@
 #ifndef METRIC_COLLECTOR_INGESTION_UDP_SERVER_HPP
 #define METRIC_COLLECTOR_INGESTION_UDP_SERVER_HPP
 
-#include <arpa/inet.h>
+#include "listener.hpp"
+
 #include <array>
 #include <atomic>
+#include <bucket_ring.hpp>
 #include <cstddef>
 #include <cstdint>
-#include <cstdlib>
-#include <fcntl.h>
 #include <memory>
-#include <netinet/in.h>
+#include <self_stats.hpp>
 #include <string>
-#include <sys/epoll.h>
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <unistd.h>
 #include <vector>
 
-constexpr std::size_t MAX_EVENTS = 64;
-constexpr std::size_t BATCH_SIZE = 64;
-constexpr std::size_t MAX_PACKET = 512;
-
 namespace metric_collector::ingestion
 {
 class Worker;
 
+// How the kernel picks one of the SO_REUSEPORT listeners for a datagram.
+enum class Steering : uint8_t
+{
+    None,        // kernel flow hash
+    IncomingCpu, // SO_INCOMING_CPU hint, listener i prefers its listener cpu, or cpu i
+    CpuBpf       // reuseport BPF program, the receiving cpu selects the listener on that cpu,
+                 // or listener cpu % listeners
+};
+
+struct UdpServerOptions
+{
+    uint16_t    port{8125};
+    std::string addr{"0.0.0.0"};
+    std::size_t num_listeners{1}; // at least 1
+    // total across listeners, each listener gets its own share so there must be at least
+    // num_listeners; ignored with inline_parse. The constructor throws on either
+    std::size_t num_workers{1};
+    bool        inline_parse{false};
+    Steering    steering{Steering::None};
+    Backend     backend{Backend::Epoll};
+    // see ReceiveOptions
+    std::size_t max_datagram{MAX_PACKET};
+    bool        udp_gro{false};
+    // Listener i runs on listener_cpus[i] and worker i on worker_cpus[i], wrapping around; empty
+    // leaves placement to the scheduler. Each one is also constructed on its cpu, so its packet
+    // pool or queue and tables are first touched, and placed, on that cpu's numa node. With
+    // IncomingCpu or CpuBpf steering the listeners' cpus are also the ones steered to, list the
+    // cpus of the NIC's rx IRQs (see nic_irq_cpus) to keep every packet on the cpu and node that
+    // received it.
+    std::vector<int> listener_cpus{};
+    std::vector<int> worker_cpus{};
+};
+
 class UdpServer
 {
   public:
-    explicit UdpServer(uint16_t port, std::string addr, std::size_t num_of_workers);
+    explicit UdpServer(uint16_t port, std::string addr, std::size_t num_of_workers,
+                       aggregation::MetricRing& ring);
+    UdpServer(UdpServerOptions options, aggregation::MetricRing& ring);
 
     ~UdpServer();
 
+    // listener 0 runs on the calling thread, which is pinned like the other listeners' threads
     void run();
     void stop();
 
-  private:
-    void init_buffers();
+    // acquire() calls that found a listener's pool empty, summed over listeners
+    [[nodiscard]] uint64_t pool_exhausted() const noexcept;
 
-    inline void       init_listen_socket();
-    inline void       init_epoll_socket();
-    static inline int set_non_blocking(int fd);
+    // datagrams the kernel dropped on full socket buffers, summed over listeners
+    [[nodiscard]] uint64_t socket_drops() const noexcept;
 
-    void drain_socket();
-    void process_packets(size_t count);
+    // a SelfStats counter since construction, e.g. QueueDrops or LinesParsed; the counters are
+    // per process, so this assumes one server at a time
+    [[nodiscard]] uint64_t counted(aggregation::SelfCounter counter) const;
 
-    int               listen_fd_;
-    int               epoll_fd_;
-    uint16_t          port_;
-    std::string       addr_;
+  private:
+    void attach_cpu_steering();
+
+    UdpServerOptions  options_;
     std::atomic<bool> running_{false};
 
-    std::vector<std::unique_ptr<Worker>>                      workers_;
-    std::size_t                                               current_worker_{0};
-    std::size_t                                               num_of_workers_;
-    std::array<std::array<std::byte, MAX_PACKET>, BATCH_SIZE> buffers_;
-    std::array<iovec, BATCH_SIZE>                             iovecs_;
-    std::array<mmsghdr, BATCH_SIZE>                           msgs_;
-    std::array<sockaddr_storage, BATCH_SIZE>                  peers_;
-    std::array<epoll_event, MAX_EVENTS>                       events_;
+    std::array<uint64_t, aggregation::SELF_COUNTERS> counted_before_{};
+
+    // listeners own the packet pools, so they must outlive the workers
+    std::vector<std::unique_ptr<Listener>> listeners_;
+    std::vector<std::unique_ptr<Worker>>   workers_;
 };
 }; // namespace metric_collector::ingestion
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,296 @@
+#include "uring_receiver.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace metric_collector::ingestion
+{
+namespace
+{
+int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                   const void* arg, std::size_t arg_size)
+{
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+int io_uring_register(int ring_fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+template <typename T> T* at_offset(void* base, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<std::byte*>(base) + offset);
+}
+} // namespace
+
+UringReceiver::UringReceiver(int fd, PacketPool& pool, bool gro) : fd_(fd), pool_(pool)
+{
+    // buffer ids are 16 bit
+    if (pool_.capacity() > UINT16_MAX + 1 || pool_.buffer_size() <= headroom(gro))
+    {
+        throw std::runtime_error("packet pool does not fit a provided buffer ring");
+    }
+
+    // no room reserved for the peer address, and for control messages only with gro; the
+    // payload follows
+    msg_.msg_namelen    = 0;
+    msg_.msg_controllen = gro ? GRO_CONTROL_SPACE : 0;
+
+    try
+    {
+        setup_ring();
+        setup_buffer_ring();
+    }
+    catch (...)
+    {
+        teardown();
+        throw;
+    }
+
+    replenish();
+}
+
+UringReceiver::~UringReceiver() { teardown(); }
+
+void UringReceiver::teardown() noexcept
+{
+    // Unregistering takes the buffer ring away from the kernel synchronously, the multishot
+    // request can no longer pick a buffer after it returns. Closing the ring alone is not enough,
+    // its teardown runs asynchronously and may still write into buffers handed back below.
+    if (ring_fd_ >= 0)
+    {
+        if (buf_ring_ != nullptr)
+        {
+            io_uring_buf_reg reg;
+            memset(&reg, 0, sizeof(reg));
+            reg.bgid = BUF_GROUP;
+            io_uring_register(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        }
+        close(ring_fd_);
+        ring_fd_ = -1;
+    }
+
+    // buffers still in the ring go back to the pool so nothing is lost for its next owner
+
+    if (buf_ring_ != nullptr)
+    {
+        // the kernel consumes from the head, so the unused buffers are the last in_ring_ added
+        for (std::size_t i = 0; i < in_ring_; i++)
+        {
+            auto slot = (buf_tail_ - in_ring_ + i) & (BUF_RING_ENTRIES - 1);
+            pool_.release(buf_slots_[slot].bid);
+        }
+        in_ring_ = 0;
+
+        munmap(buf_ring_, BUF_RING_ENTRIES * sizeof(io_uring_buf));
+        buf_ring_  = nullptr;
+        buf_slots_ = nullptr;
+    }
+
+    if (sqes_ptr_ != nullptr)
+    {
+        munmap(sqes_ptr_, sqes_size_);
+        sqes_ptr_ = nullptr;
+    }
+
+    if (ring_ptr_ != nullptr)
+    {
+        munmap(ring_ptr_, ring_size_);
+        ring_ptr_ = nullptr;
+    }
+}
+
+void UringReceiver::setup_ring()
+{
+    // One multishot recvmsg posts a completion per datagram, up to one per ring buffer between
+    // two polls; a smaller CQ overflows and the kernel ends the multishot request.
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags      = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_CQSIZE;
+    params.cq_entries = CQ_ENTRIES;
+
+    ring_fd_ = io_uring_setup(SQ_ENTRIES, &params);
+    if (ring_fd_ < 0 && errno == EINVAL)
+    {
+        // COOP_TASKRUN is only a hint, older kernels reject it
+        memset(&params, 0, sizeof(params));
+        params.flags      = IORING_SETUP_CQSIZE;
+        params.cq_entries = CQ_ENTRIES;
+        ring_fd_          = io_uring_setup(SQ_ENTRIES, &params);
+    }
+    if (ring_fd_ < 0)
+    {
+        std::cerr << "---> io_uring_setup() failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("io_uring_setup() failed");
+    }
+
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 ||
+        (params.features & IORING_FEAT_EXT_ARG) == 0)
+    {
+        throw std::runtime_error("io_uring lacks SINGLE_MMAP or EXT_ARG");
+    }
+
+    ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                          params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    ring_ptr_  = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQ_RING);
+    if (ring_ptr_ == MAP_FAILED)
+    {
+        ring_ptr_ = nullptr;
+        std::cerr << "---> mmap(IORING_OFF_SQ_RING) failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("mmap() failed");
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ptr_  = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes_ptr_ == MAP_FAILED)
+    {
+        sqes_ptr_ = nullptr;
+        std::cerr << "---> mmap(IORING_OFF_SQES) failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("mmap() failed");
+    }
+
+    sq_tail_  = at_offset<uint32_t>(ring_ptr_, params.sq_off.tail);
+    sq_mask_  = *at_offset<uint32_t>(ring_ptr_, params.sq_off.ring_mask);
+    sq_array_ = at_offset<uint32_t>(ring_ptr_, params.sq_off.array);
+    sqes_     = static_cast<io_uring_sqe*>(sqes_ptr_);
+
+    cq_head_ = at_offset<uint32_t>(ring_ptr_, params.cq_off.head);
+    cq_tail_ = at_offset<uint32_t>(ring_ptr_, params.cq_off.tail);
+    cq_mask_ = *at_offset<uint32_t>(ring_ptr_, params.cq_off.ring_mask);
+    cqes_    = at_offset<io_uring_cqe>(ring_ptr_, params.cq_off.cqes);
+}
+
+void UringReceiver::setup_buffer_ring()
+{
+    void* ring = mmap(nullptr, BUF_RING_ENTRIES * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+    {
+        std::cerr << "---> mmap(buffer ring) failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("mmap() failed");
+    }
+    buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+    // not buf_ring_->bufs, the flex array in the uapi header sits behind an empty struct that
+    // is one byte in C++, which moves it off the kernel layout
+    buf_slots_ = static_cast<io_uring_buf*>(ring);
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = BUF_RING_ENTRIES;
+    reg.bgid         = BUF_GROUP;
+
+    if (io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        std::cerr << "---> io_uring_register(PBUF_RING) failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("io_uring_register() failed");
+    }
+}
+
+bool UringReceiver::replenish() noexcept
+{
+    bool added = false;
+    while (in_ring_ < BUF_RING_ENTRIES)
+    {
+        auto index = pool_.acquire();
+        if (index == PacketPool::INVALID_INDEX)
+        {
+            break;
+        }
+
+        auto  buffer = pool_.buffer(index);
+        auto& slot   = buf_slots_[buf_tail_ & (BUF_RING_ENTRIES - 1)];
+        slot.addr    = reinterpret_cast<uint64_t>(buffer.data());
+        slot.len     = static_cast<uint32_t>(buffer.size());
+        slot.bid     = static_cast<uint16_t>(index);
+
+        buf_tail_++;
+        in_ring_++;
+        added = true;
+    }
+
+    if (added)
+    {
+        std::atomic_ref(buf_ring_->tail).store(buf_tail_, std::memory_order_release);
+    }
+
+    if (!armed_ && in_ring_ > 0)
+    {
+        arm();
+    }
+
+    return in_ring_ > 0;
+}
+
+void UringReceiver::arm() noexcept
+{
+    uint32_t      tail = std::atomic_ref(*sq_tail_).load(std::memory_order_relaxed);
+    uint32_t      idx  = tail & sq_mask_;
+    io_uring_sqe& sqe  = sqes_[idx];
+
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode    = IORING_OP_RECVMSG;
+    sqe.fd        = fd_;
+    sqe.addr      = reinterpret_cast<uint64_t>(&msg_);
+    sqe.len       = 1;
+    sqe.ioprio    = IORING_RECV_MULTISHOT;
+    sqe.flags     = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = BUF_GROUP;
+    sqe.user_data = RECV_TAG;
+
+    sq_array_[idx] = idx;
+    std::atomic_ref(*sq_tail_).store(tail + 1, std::memory_order_release);
+
+    to_submit_++;
+    armed_ = true;
+}
+
+uint16_t UringReceiver::segment_size(PacketPool::Index index, uint32_t controllen) noexcept
+{
+    // the control data sits right after the header, as recvmsg would have written it
+    msghdr msg{};
+    msg.msg_control    = pool_.buffer(index).data() + HEADROOM;
+    msg.msg_controllen = std::min<std::size_t>(controllen, msg_.msg_controllen);
+    return gro_segment_size(msg);
+}
+
+void UringReceiver::submit_and_wait(int timeout_ms) noexcept
+{
+    __kernel_timespec ts{};
+    ts.tv_sec  = timeout_ms / 1000;
+    ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+
+    io_uring_getevents_arg arg{};
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+    int r = io_uring_enter(ring_fd_, to_submit_, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                           &arg, sizeof(arg));
+    if (r >= 0)
+    {
+        to_submit_ -= std::min(to_submit_, static_cast<uint32_t>(r));
+    }
+    else if (errno != ETIME && errno != EINTR && errno != EBUSY)
+    {
+        report_error(errno);
+    }
+}
+
+void UringReceiver::report_error(int error)
+{
+    std::cerr << "---> io_uring recvmsg failed: " << strerror(error) << "\n";
+}
+} // namespace metric_collector::ingestion
@@ -0,0 +1,143 @@
+#ifndef METRIC_COLLECTOR_INGESTION_URING_RECEIVER_HPP
+#define METRIC_COLLECTOR_INGESTION_URING_RECEIVER_HPP
+
+#include "packet_pool.hpp"
+#include "udp_gro.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+namespace metric_collector::ingestion
+{
+// Receives datagrams with a single multishot IORING_OP_RECVMSG fed from a provided buffer ring,
+// so the kernel picks a buffer per datagram and one io_uring_enter reaps any number of them.
+// Ring buffers are PacketPool buffers (buffer id == pool index): the receive thread moves freed
+// pool buffers into the ring, consumers release them back to the pool as before.
+// Talks to the kernel through the raw syscalls, the constructor throws std::runtime_error when
+// the kernel lacks any of the pieces (multishot recvmsg needs 6.0) so callers can fall back.
+class UringReceiver
+{
+  public:
+    static constexpr unsigned    SQ_ENTRIES       = 8;
+    static constexpr uint16_t    BUF_RING_ENTRIES = 1024;
+    static constexpr uint16_t    BUF_GROUP        = 0;
+    // a completion per ring buffer plus room for error and re-arm completions
+    static constexpr unsigned    CQ_ENTRIES       = 2 * BUF_RING_ENTRIES;
+    // every buffer starts with the recvmsg header, then the control data with gro, then the
+    // payload
+    static constexpr std::size_t HEADROOM = sizeof(io_uring_recvmsg_out);
+
+    static constexpr std::size_t headroom(bool gro) noexcept
+    {
+        return HEADROOM + (gro ? GRO_CONTROL_SPACE : 0);
+    }
+
+    // gro reserves room for the UDP_GRO control message, the socket must have it enabled
+    UringReceiver(int fd, PacketPool& pool, bool gro = false);
+    ~UringReceiver();
+
+    UringReceiver(const UringReceiver&)            = delete;
+    UringReceiver& operator=(const UringReceiver&) = delete;
+    UringReceiver(UringReceiver&&)                 = delete;
+    UringReceiver& operator=(UringReceiver&&)      = delete;
+
+    // Waits up to timeout_ms for completions and calls on_packet(Packet, bool truncated) for every
+    // filled buffer, which is owned by the callee from then on. Returns false when no buffer
+    // could be provided to the kernel, in which case the caller should poll again soon.
+    template <typename F> bool poll(int timeout_ms, F&& on_packet)
+    {
+        replenish();
+        submit_and_wait(timeout_ms);
+
+        uint32_t head = std::atomic_ref(*cq_head_).load(std::memory_order_relaxed);
+        uint32_t tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            if (cqe.user_data != RECV_TAG)
+            {
+                continue;
+            }
+
+            if ((cqe.flags & IORING_CQE_F_MORE) == 0)
+            {
+                armed_ = false; // multishot ended, ENOBUFS or error, re-armed by replenish()
+            }
+
+            if (cqe.res < 0 || (cqe.flags & IORING_CQE_F_BUFFER) == 0)
+            {
+                if (cqe.res != -ENOBUFS)
+                {
+                    report_error(-cqe.res);
+                }
+                continue;
+            }
+
+            auto index = static_cast<PacketPool::Index>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            in_ring_--;
+
+            // msg_ reserves no room for the peer address, res counts the reserved control space
+            io_uring_recvmsg_out out;
+            std::memcpy(&out, pool_.buffer(index).data(), sizeof(out));
+            auto   offset = static_cast<uint32_t>(HEADROOM + msg_.msg_controllen);
+            Packet packet{&pool_, index, static_cast<uint32_t>(cqe.res) - offset, offset};
+            if (out.controllen != 0)
+            {
+                packet.segment = segment_size(index, out.controllen);
+            }
+            on_packet(packet, (out.flags & MSG_TRUNC) != 0);
+        }
+
+        std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+        return replenish();
+    }
+
+  private:
+    static constexpr uint64_t RECV_TAG = 1;
+
+    void setup_ring();
+    void setup_buffer_ring();
+    void teardown() noexcept;
+    bool replenish() noexcept;
+    void arm() noexcept;
+    void submit_and_wait(int timeout_ms) noexcept;
+    [[nodiscard]] uint16_t segment_size(PacketPool::Index index, uint32_t controllen) noexcept;
+    static void report_error(int error);
+
+    int         fd_;
+    PacketPool& pool_;
+    int         ring_fd_{-1};
+
+    void*       ring_ptr_{nullptr};
+    std::size_t ring_size_{0};
+    void*       sqes_ptr_{nullptr};
+    std::size_t sqes_size_{0};
+
+    // ring indices shared with the kernel, accessed through std::atomic_ref
+    uint32_t*     sq_tail_{nullptr};
+    uint32_t      sq_mask_{0};
+    uint32_t*     sq_array_{nullptr};
+    io_uring_sqe* sqes_{nullptr};
+    uint32_t      to_submit_{0};
+
+    uint32_t*     cq_head_{nullptr};
+    uint32_t*     cq_tail_{nullptr};
+    uint32_t      cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+
+    io_uring_buf_ring* buf_ring_{nullptr}; // only for the tail, which overlays slot 0
+    io_uring_buf*      buf_slots_{nullptr};
+    uint16_t           buf_tail_{0};
+    std::size_t        in_ring_{0};
+    bool               armed_{false};
+    msghdr             msg_{};
+};
+} // namespace metric_collector::ingestion
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef METRIC_COLLECTOR_INGESTION_WAKEUP_HPP
+#define METRIC_COLLECTOR_INGESTION_WAKEUP_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace metric_collector::ingestion
+{
+// Lets one consumer sleep until a producer has published work, without the producer paying a
+// syscall unless the consumer is actually asleep. The consumer calls prepare(), checks for work
+// once more and then either cancel()s or wait()s; a producer calls notify() after publishing.
+// The seq_cst fences on both sides make sure that either the consumer's last check sees the
+// work or the producer sees it parked, so a wakeup is never lost.
+// Waiting is a futex on Linux, std::atomic::wait on a 32 bit word.
+class Wakeup
+{
+  public:
+    // consumer only
+    void prepare() noexcept
+    {
+        state_.store(PARKED, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    // consumer only, the check after prepare() found work
+    void cancel() noexcept { state_.store(AWAKE, std::memory_order_relaxed); }
+
+    // consumer only, returns once a notify() has come in since prepare()
+    void wait() noexcept
+    {
+        while (state_.load(std::memory_order_acquire) == PARKED)
+        {
+            state_.wait(PARKED, std::memory_order_acquire);
+        }
+    }
+
+    // any thread, after publishing work; true if it woke the consumer up
+    bool notify() noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (state_.load(std::memory_order_relaxed) != PARKED ||
+            state_.exchange(AWAKE, std::memory_order_acq_rel) != PARKED)
+        {
+            return false;
+        }
+        state_.notify_one();
+        return true;
+    }
+
+  private:
+    static constexpr uint32_t AWAKE  = 0;
+    static constexpr uint32_t PARKED = 1;
+
+    std::atomic<uint32_t> state_{AWAKE};
+};
+} // namespace metric_collector::ingestion
+
+#endif
@@ -1,25 +1,34 @@
 #ifndef METRIC_COLLECTOR_INGESTION_WORKER
 #define METRIC_COLLECTOR_INGESTION_WORKER
 
+#include "aggregator.hpp"
+#include "cpu_affinity.hpp"
+#include "packet_pool.hpp"
 #include "spsc_queue.hpp"
+#include "wakeup.hpp"
 
+#include <array>
+#include <bucket_ring.hpp>
 #include <cstddef>
-#include <iostream>
-#include <span>
+#include <self_stats.hpp>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <utility>
 
 namespace metric_collector::ingestion
 {
 
 constexpr std::size_t WORKER_QUEUE_CAPACITY = 8192;
+constexpr std::size_t WORKER_DRAIN_BATCH    = 64;
 
 class Worker
 {
   public:
-    using Packet = std::span<std::byte>;
-    using Queue  = SpscQueue<Packet, WORKER_QUEUE_CAPACITY>;
+    // the pool is never larger than a queue, so dropping only guards against misconfiguration
+    using Queue = SpscQueue<Packet, WORKER_QUEUE_CAPACITY, FullPolicy::DropNewest>;
 
-    Worker() = default;
+    explicit Worker(aggregation::MetricRing& ring) : aggregator_(ring) {}
     ~Worker() { stop(); }
 
     Worker(const Worker&)            = delete;
@@ -28,12 +37,24 @@ class Worker
     Worker(Worker&&)            = delete;
     Worker& operator=(Worker&&) = delete;
 
-    [[nodiscard]] Queue& queue() noexcept { return queue_; }
+    [[nodiscard]] Queue&       queue() noexcept { return queue_; }
+    [[nodiscard]] const Queue& queue() const noexcept { return queue_; }
 
-    void start()
+    // the producer calls this after a batch of pushes, not after each one: every call pays a
+    // full fence, and a syscall if the worker is asleep
+    void wake() noexcept { wakeup_.notify(); }
+
+    // name labels the thread's self stats, cpu pins it unless ANY_CPU
+    void start(std::string name = "worker", int cpu = ANY_CPU)
     {
         running_.store(true, std::memory_order_release);
-        thread_ = std::thread([this]() { run(); });
+        thread_ = std::thread(
+            [this, cpu, name = std::move(name)]() mutable
+            {
+                pin_thread(cpu);
+                aggregation::SelfStats::name_thread(std::move(name));
+                run();
+            });
     }
 
     void stop()
@@ -42,6 +63,7 @@ class Worker
         {
             return; // already stopped
         }
+        wakeup_.notify();
 
         if (thread_.joinable())
         {
@@ -50,8 +72,9 @@ class Worker
     }
 
   private:
+    // idle rounds spent spinning, then yielding, before the worker parks
     static constexpr std::size_t SPIN_ITERATIONS  = 256;
-    static constexpr std::size_t YIELD_ITERATIONS = 256;
+    static constexpr std::size_t YIELD_ITERATIONS = 64;
 
     void run()
     {
@@ -59,33 +82,55 @@ class Worker
 
         while (running_.load(std::memory_order_acquire))
         {
-            auto pkt = queue_.pop();
+            std::size_t count = queue_.pop_n(batch_);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                process(batch_[i]);
+            }
 
-            if (pkt != std::nullopt)
+            if (count != 0)
             {
-                std::cout << "processing packet\n";
-                // TODO process packet
+                record_depth(count);
                 idle = 0;
             }
             else
             {
                 adaptive_wait(idle);
             }
+
+            aggregator_.tick();
         }
 
         // drain any remaning packets
         drain();
+        aggregator_.merge();
     }
 
     void drain()
     {
-        auto packet = queue_.pop();
-        while (packet != std::nullopt)
+        for (auto count = queue_.pop_n(batch_); count != 0; count = queue_.pop_n(batch_))
         {
-            // process packet
+            for (std::size_t i = 0; i < count; i++)
+            {
+                process(batch_[i]);
+            }
         }
     }
 
+    void process(Packet& packet)
+    {
+        packet.for_each_datagram([this](std::string_view payload)
+                                 { aggregator_.process(payload); });
+        packet.release();
+    }
+
+    // a short pop emptied the queue, so only a full batch needs to look at what is left
+    void record_depth(std::size_t popped)
+    {
+        std::size_t depth = popped < batch_.size() ? popped : popped + queue_.size();
+        aggregation::SelfStats::record(aggregation::SelfHistogram::QueueDepth, depth);
+    }
+
     void adaptive_wait(std::size_t& idle)
     {
         ++idle;
@@ -98,19 +143,41 @@ class Worker
             asm volatile("yield"); // arm system
 #endif
         }
-        else if (idle <= YIELD_ITERATIONS)
+        else if (idle <= SPIN_ITERATIONS + YIELD_ITERATIONS)
         {
             std::this_thread::yield();
         }
         else
         {
-            std::this_thread::sleep_for(std::chrono::microseconds(10));
+            park();
+            idle = 0;
+        }
+    }
+
+    // sleeps until the listener pushes into the empty queue or stop() is called
+    void park()
+    {
+        // nothing ticks while parked, so hand the local table over now rather than when traffic
+        // resumes; an idle worker pays for it
+        aggregator_.merge();
+
+        wakeup_.prepare();
+        if (queue_.size() != 0 || !running_.load(std::memory_order_acquire))
+        {
+            wakeup_.cancel();
+            return;
         }
+
+        aggregation::SelfStats::add(aggregation::SelfCounter::WorkerParks);
+        wakeup_.wait();
     }
 
-    Queue             queue_;
-    std::thread       thread_;
-    std::atomic<bool> running_{false};
+    Queue                                  queue_;
+    std::array<Packet, WORKER_DRAIN_BATCH> batch_;      // popped together, one index update
+    Aggregator                             aggregator_; // only touched by the worker thread
+    std::thread                            thread_;
+    std::atomic<bool>                      running_{false};
+    alignas(64) Wakeup                     wakeup_; // read by the producer after every batch
 };
 } // namespace metric_collector::ingestion
 
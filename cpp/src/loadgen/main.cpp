@@ -0,0 +1,509 @@
+#include "sender.hpp"
+#include "workload.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <bucket_ring.hpp>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <netinet/in.h>
+#include <rotation_scheduler.hpp>
+#include <self_stats.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+#include <udp_server.hpp>
+#include <unistd.h>
+#include <vector>
+
+using namespace metric_collector::aggregation;
+using namespace metric_collector::ingestion;
+using namespace metric_collector::loadgen;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr std::string_view PROBE_NAME = "loadgen.probe";
+
+struct Config
+{
+    WorkloadOptions  workload;
+    SenderOptions    sender;
+    UdpServerOptions server;
+    std::size_t      senders{1};
+    double           rate{0.0}; // over all senders
+    double           duration{10.0};
+    double           window{std::chrono::duration<double>(DEFAULT_WINDOW_INTERVAL).count()};
+    double           probe_interval_ms{10.0};
+};
+
+// Counters of every stage a datagram passes, summed over threads; the collector's come from its
+// SelfStats counters. Reads are relaxed and taken one after the other, so a snapshot of a
+// running collector can be off by a few datagrams.
+struct Totals
+{
+    uint64_t sent{0};
+    uint64_t lines_sent{0};
+    uint64_t send_errors{0};
+    uint64_t received{0};
+    uint64_t socket_drops{0};
+    uint64_t truncated{0};
+    uint64_t queue_drops{0};
+    uint64_t lines{0};
+    uint64_t parse_errors{0};
+    uint64_t local_mismatches{0};
+    uint64_t window_mismatches{0};
+};
+
+Totals collect(const std::vector<std::unique_ptr<Sender>>& senders, const UdpServer& server)
+{
+    Totals totals;
+    for (const auto& sender : senders)
+    {
+        totals.sent += sender->datagrams_sent();
+        totals.lines_sent += sender->lines_sent();
+        totals.send_errors += sender->send_errors();
+    }
+    totals.received          = server.counted(SelfCounter::PacketsReceived);
+    totals.socket_drops      = server.socket_drops();
+    totals.truncated         = server.counted(SelfCounter::DatagramsTruncated);
+    totals.queue_drops       = server.counted(SelfCounter::QueueDrops);
+    totals.lines             = server.counted(SelfCounter::LinesParsed);
+    totals.parse_errors      = server.counted(SelfCounter::ParseErrors);
+    totals.local_mismatches  = server.counted(SelfCounter::LocalTypeMismatches);
+    totals.window_mismatches = server.counted(SelfCounter::WindowTypeMismatches);
+    return totals;
+}
+
+// Sends a gauge carrying a sequence number every interval and polls the ring for it. A probe
+// counts as visible once get_metric() returns its number or a later one: workers merge on a
+// timer, so intermediate numbers are usually overwritten before anyone can see them.
+class Prober
+{
+  public:
+    Prober(const Config& config, const MetricRing& ring)
+        : ring_(ring),
+          interval_(std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double, std::milli>(config.probe_interval_ms)))
+    {
+        fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd_ < 0)
+        {
+            std::cerr << "---> probe socket() failed\n";
+            throw std::runtime_error("socket() failed");
+        }
+        dest_.sin_family = AF_INET;
+        dest_.sin_port   = htons(config.server.port);
+        inet_pton(AF_INET, config.sender.addr.c_str(), &dest_.sin_addr);
+    }
+
+    ~Prober()
+    {
+        stop();
+        close(fd_);
+    }
+
+    Prober(const Prober&)            = delete;
+    Prober& operator=(const Prober&) = delete;
+
+    void start()
+    {
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    // no new probes are sent after this, the ones in flight are still waited for
+    void stop_sending() { sending_.store(false, std::memory_order_release); }
+
+    void stop()
+    {
+        polling_.store(false, std::memory_order_release);
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    // every probe sent has been seen
+    [[nodiscard]] bool settled() const noexcept
+    {
+        return visible_.load(std::memory_order_acquire) + 1 ==
+               sent_count_.load(std::memory_order_acquire);
+    }
+
+    // only valid after stop()
+    [[nodiscard]] std::vector<double> latencies_ms() const { return latencies_ms_; }
+    [[nodiscard]] std::size_t         probes_sent() const { return sent_at_.size() - 1; }
+
+  private:
+    static constexpr auto POLL_INTERVAL = std::chrono::milliseconds(1);
+
+    void run()
+    {
+        // the first probe is number 1, a gauge reads 0 before it was ever set
+        sent_at_.push_back(Clock::now());
+        sent_count_.store(1, std::memory_order_release);
+
+        auto next_probe = Clock::now();
+        while (polling_.load(std::memory_order_acquire))
+        {
+            auto now = Clock::now();
+            if (sending_.load(std::memory_order_acquire) && now >= next_probe)
+            {
+                send_probe(sent_at_.size());
+                next_probe = now + interval_;
+            }
+
+            poll(Clock::now());
+            std::this_thread::sleep_for(POLL_INTERVAL);
+        }
+    }
+
+    void send_probe(uint64_t seq)
+    {
+        auto payload = std::string(PROBE_NAME) + ":" + std::to_string(seq) + "|g\n";
+        sent_at_.push_back(Clock::now());
+        sendto(fd_, payload.data(), payload.size(), 0, reinterpret_cast<sockaddr*>(&dest_),
+               sizeof(dest_));
+        sent_count_.store(sent_at_.size(), std::memory_order_release);
+    }
+
+    void poll(Clock::time_point now)
+    {
+        auto value = ring_.get_metric<Gauge>(PROBE_NAME);
+        if (!value.has_value())
+        {
+            return;
+        }
+
+        uint64_t seq     = std::get<Gauge>(value->metric).get();
+        uint64_t visible = visible_.load(std::memory_order_relaxed);
+        for (uint64_t s = visible + 1; s <= seq && s < sent_at_.size(); s++)
+        {
+            latencies_ms_.push_back(
+                std::chrono::duration<double, std::milli>(now - sent_at_[s]).count());
+            visible = s;
+        }
+        visible_.store(visible, std::memory_order_release);
+    }
+
+    const MetricRing&              ring_;
+    Clock::duration                interval_;
+    int                            fd_{-1};
+    sockaddr_in                    dest_{};
+    std::thread                    thread_;
+    std::atomic<bool>              sending_{true};
+    std::atomic<bool>              polling_{true};
+    std::atomic<uint64_t>          sent_count_{0};
+    std::atomic<uint64_t>          visible_{0};
+    std::vector<Clock::time_point> sent_at_; // by sequence number, [0] is unused
+    std::vector<double>            latencies_ms_;
+};
+
+template <typename T> bool parse_number(std::string_view text, T& out)
+{
+    auto res = std::from_chars(text.data(), text.data() + text.size(), out);
+    return res.ec == std::errc{} && res.ptr == text.data() + text.size();
+}
+
+bool parse_mix(std::string_view text, TypeMix& mix)
+{
+    std::array<uint32_t*, 4> weights = {&mix.counters, &mix.gauges, &mix.timers, &mix.sets};
+    for (std::size_t i = 0; i < weights.size(); i++)
+    {
+        auto comma = text.find(',');
+        if ((comma == std::string_view::npos) != (i + 1 == weights.size()) ||
+            !parse_number(text.substr(0, comma), *weights[i]))
+        {
+            return false;
+        }
+        text.remove_prefix(comma == std::string_view::npos ? text.size() : comma + 1);
+    }
+    return mix.counters + mix.gauges + mix.timers + mix.sets > 0;
+}
+
+void usage()
+{
+    std::cout << "usage: loadgen [--option=value ...]\n"
+                 "Runs a collector in process and blasts StatsD traffic at it over loopback.\n\n"
+                 "workload\n"
+                 "  --keys=10000          distinct metric names\n"
+                 "  --mix=60,10,25,5      weights of counters, gauges, timers and sets\n"
+                 "  --lines=16            lines per datagram\n"
+                 "  --max-datagram=512    bytes per datagram, lines are packed up to it\n"
+                 "  --malformed=0         percent of lines that are not valid StatsD\n"
+                 "  --conflicting=0       percent of keys also sent under another type\n"
+                 "  --seed=42\n"
+                 "senders\n"
+                 "  --senders=1           sending threads\n"
+                 "  --batch=64            datagrams per sendmmsg\n"
+                 "  --rate=0              datagrams per second over all senders, 0 is unlimited\n"
+                 "  --duration=10         seconds of load\n"
+                 "  --probe-interval=10   ms between latency probes\n"
+                 "collector\n"
+                 "  --port=9125\n"
+                 "  --listeners=1\n"
+                 "  --workers=1           ignored with --inline\n"
+                 "  --inline              parse on the listener threads\n"
+                 "  --backend=epoll       epoll or uring\n"
+                 "  --receive-buffer=1472 largest datagram received whole\n"
+                 "  --gro                 enable UDP_GRO on the listener sockets\n"
+                 "  --window=10           seconds per window\n";
+}
+
+bool parse_args(int argc, char** argv, Config& config)
+{
+    using Setter = std::function<bool(std::string_view)>;
+    auto& w      = config.workload;
+    auto& s      = config.server;
+
+    auto positive = [](auto& out)
+    { return [&out](std::string_view v) { return parse_number(v, out) && out > 0; }; };
+    auto any = [](auto& out)
+    { return [&out](std::string_view v) { return parse_number(v, out); }; };
+
+    std::map<std::string_view, Setter> options = {
+        {"keys", positive(w.keys)},
+        {"mix", [&w](std::string_view v) { return parse_mix(v, w.mix); }},
+        {"lines", positive(w.lines_per_datagram)},
+        {"max-datagram", positive(w.max_datagram)},
+        {"malformed", any(w.malformed)},
+        {"conflicting", any(w.conflicting)},
+        {"seed", any(w.seed)},
+        {"senders", positive(config.senders)},
+        {"batch", positive(config.sender.batch)},
+        {"rate", any(config.rate)},
+        {"duration", positive(config.duration)},
+        {"probe-interval", positive(config.probe_interval_ms)},
+        {"port", any(s.port)},
+        {"listeners", positive(s.num_listeners)},
+        {"workers", any(s.num_workers)},
+        {"window", positive(config.window)},
+        {"receive-buffer", positive(s.max_datagram)},
+        {"backend",
+         [&s](std::string_view v)
+         {
+             s.backend = v == "uring" ? Backend::IoUring : Backend::Epoll;
+             return v == "uring" || v == "epoll";
+         }},
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--inline")
+        {
+            s.inline_parse = true;
+            continue;
+        }
+        if (arg == "--gro")
+        {
+            s.udp_gro = true;
+            continue;
+        }
+        if (arg == "--help" || !arg.starts_with("--"))
+        {
+            return false;
+        }
+
+        arg.remove_prefix(2);
+        auto eq     = arg.find('=');
+        auto option = options.find(arg.substr(0, eq));
+        if (eq == std::string_view::npos || option == options.end() ||
+            !option->second(arg.substr(eq + 1)))
+        {
+            std::cerr << "---> bad option: " << argv[i] << "\n";
+            return false;
+        }
+    }
+
+    if (!s.inline_parse && s.num_workers < s.num_listeners)
+    {
+        std::cerr << "---> every listener needs a worker, use --inline to parse on listeners\n";
+        return false;
+    }
+    if (w.keys < config.senders)
+    {
+        std::cerr << "---> fewer keys than senders\n";
+        return false;
+    }
+    return true;
+}
+
+// 1234567 -> "1.23M"
+std::string human(double value)
+{
+    constexpr std::array<const char*, 4> UNITS = {"", "k", "M", "G"};
+
+    std::size_t unit = 0;
+    while (value >= 1000.0 && unit + 1 < UNITS.size())
+    {
+        value /= 1000.0;
+        unit++;
+    }
+
+    std::array<char, 32> text{};
+    std::snprintf(text.data(), text.size(), unit == 0 ? "%.0f%s" : "%.2f%s", value, UNITS[unit]);
+    return text.data();
+}
+
+void print_interval(double elapsed, const Totals& now, const Totals& before, double seconds)
+{
+    auto rate = [seconds](uint64_t after, uint64_t earlier)
+    { return human(static_cast<double>(after - earlier) / seconds); };
+
+    std::cout << "[" << static_cast<int>(elapsed) << "s] sent " << rate(now.sent, before.sent)
+              << " pkt/s, received " << rate(now.received, before.received) << " pkt/s, parsed "
+              << rate(now.lines, before.lines) << " lines/s | drops: socket "
+              << now.socket_drops - before.socket_drops << ", queue "
+              << now.queue_drops - before.queue_drops << ", parse "
+              << now.parse_errors - before.parse_errors << ", mismatch "
+              << now.local_mismatches - before.local_mismatches << " lines + "
+              << now.window_mismatches - before.window_mismatches << " entries\n";
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    return sorted[static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1))];
+}
+
+void print_summary(const Config& config, const Totals& totals, double seconds,
+                   std::vector<double> latencies, std::size_t probes)
+{
+    auto per_second = [seconds](uint64_t count)
+    { return human(static_cast<double>(count) / seconds); };
+
+    uint64_t accepted_packets = totals.received - std::min(totals.received, totals.queue_drops);
+    // window mismatches drop merged entries, each standing for an unknown number of lines, so
+    // only the lines refused by the local tables are taken off
+    uint64_t accepted_lines = totals.lines - std::min(totals.lines, totals.local_mismatches);
+
+    std::cout << "\n---> " << config.workload.keys << " keys, " << config.senders
+              << " sender(s), " << config.server.num_listeners << " listener(s), "
+              << (config.server.inline_parse ? std::string("inline parsing")
+                                             : std::to_string(config.server.num_workers) +
+                                                   " worker(s)")
+              << ", " << seconds << "s\n";
+    std::cout << "sent              " << totals.sent << " datagrams, " << totals.lines_sent
+              << " lines (" << per_second(totals.sent) << " pkt/s, "
+              << per_second(totals.lines_sent) << " lines/s), " << totals.send_errors
+              << " send errors\n";
+    std::cout << "accepted          " << accepted_packets << " datagrams, " << accepted_lines
+              << " lines (" << per_second(accepted_packets) << " pkt/s, "
+              << per_second(accepted_lines) << " lines/s)\n";
+    std::cout << "dropped\n";
+    std::cout << "  socket buffer   " << totals.socket_drops << " datagrams\n";
+    std::cout << "  truncated       " << totals.truncated
+              << " datagrams over the receive buffer, partial last line dropped\n";
+    std::cout << "  worker queue    " << totals.queue_drops << " datagrams\n";
+    std::cout << "  parse error     " << totals.parse_errors << " lines\n";
+    std::cout << "  type mismatch   " << totals.local_mismatches << " lines in local tables, "
+              << totals.window_mismatches << " merged entries in windows\n";
+    // sent but neither received nor counted dropped, e.g. lost while the last ones drained
+    uint64_t seen = totals.received + totals.socket_drops;
+    std::cout << "  unaccounted     " << totals.sent - std::min(totals.sent, seen)
+              << " datagrams\n";
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "send to visible   " << latencies.size() << " of " << probes
+              << " probes seen, ms p50 " << percentile(latencies, 0.5) << ", p90 "
+              << percentile(latencies, 0.9) << ", p99 " << percentile(latencies, 0.99)
+              << ", max " << percentile(latencies, 1.0) << "\n";
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Config config;
+    config.server.addr           = "127.0.0.1";
+    config.server.port           = 9125;
+    if (!parse_args(argc, argv, config))
+    {
+        usage();
+        return 1;
+    }
+    config.sender.port = config.server.port;
+    config.sender.rate = config.rate / static_cast<double>(config.senders);
+
+    auto ring   = std::make_unique<MetricRing>();
+    auto server = std::make_unique<UdpServer>(config.server, *ring);
+    RotationScheduler<MetricRing> scheduler(
+        *ring, std::chrono::duration_cast<Clock::duration>(
+                   std::chrono::duration<double>(config.window)));
+
+    std::cout << "---> building datagrams\n";
+    std::vector<std::unique_ptr<Sender>> senders;
+    for (std::size_t i = 0; i < config.senders; i++)
+    {
+        senders.push_back(std::make_unique<Sender>(
+            config.sender, make_datagrams(config.workload, i, config.senders)));
+    }
+
+    std::thread server_thread([&server]() { server->run(); });
+    scheduler.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // listeners up
+
+    std::atomic<bool>        running{true};
+    std::vector<std::thread> sender_threads;
+    for (auto& sender : senders)
+    {
+        sender_threads.emplace_back([&sender, &running]() { sender->run(running); });
+    }
+    Prober prober(config, *ring);
+    prober.start();
+
+    auto start    = Clock::now();
+    auto end      = start + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(config.duration));
+    auto previous = collect(senders, *server);
+    auto tick     = start;
+    while (Clock::now() < end)
+    {
+        auto next = std::min(tick + std::chrono::seconds(1), end);
+        std::this_thread::sleep_until(next);
+
+        auto current = collect(senders, *server);
+        print_interval(std::chrono::duration<double>(next - start).count(), current, previous,
+                       std::chrono::duration<double>(next - tick).count());
+        previous = current;
+        tick     = next;
+    }
+
+    running.store(false, std::memory_order_release);
+    prober.stop_sending();
+    for (auto& thread : sender_threads)
+    {
+        thread.join();
+    }
+    auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // the sockets drain quickly, the last probe needs a worker merge which runs on a timer
+    auto deadline = Clock::now() + std::chrono::seconds(3);
+    while (!prober.settled() && Clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    prober.stop();
+
+    server->stop();
+    server_thread.join();
+    scheduler.stop();
+
+    print_summary(config, collect(senders, *server), seconds, prober.latencies_ms(),
+                  prober.probes_sent());
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include "sender.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+namespace metric_collector::loadgen
+{
+Sender::Sender(SenderOptions options, std::vector<std::string> datagrams)
+    : options_(std::move(options)), datagrams_(std::move(datagrams)), iovecs_(options_.batch),
+      msgs_(options_.batch)
+{
+    if (datagrams_.empty())
+    {
+        std::cerr << "---> sender has no datagrams to send\n";
+        throw std::runtime_error("sender has no datagrams to send");
+    }
+
+    for (const auto& datagram : datagrams_)
+    {
+        lines_.push_back(static_cast<uint32_t>(std::count(datagram.begin(), datagram.end(), '\n')));
+    }
+
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0)
+    {
+        std::cerr << "---> socket() failed: " << strerror(errno) << "\n";
+        throw std::runtime_error("socket() failed");
+    }
+
+    // connected, so the kernel resolves the route once instead of per datagram
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port   = htons(options_.port);
+    if (inet_pton(AF_INET, options_.addr.c_str(), &dest.sin_addr) != 1 ||
+        connect(fd_, reinterpret_cast<sockaddr*>(&dest), sizeof(dest)) < 0)
+    {
+        std::cerr << "---> connect() to " << options_.addr << ":" << options_.port
+                  << " failed: " << strerror(errno) << "\n";
+        close(fd_);
+        throw std::runtime_error("connect() failed");
+    }
+
+    for (std::size_t i = 0; i < options_.batch; i++)
+    {
+        msgs_[i].msg_hdr.msg_iov    = &iovecs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+Sender::~Sender()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+    }
+}
+
+void Sender::run(const std::atomic<bool>& running)
+{
+    using Clock = std::chrono::steady_clock;
+
+    auto        start = Clock::now();
+    uint64_t    sent  = 0;
+    uint64_t    lines = 0;
+    std::size_t next  = 0;
+
+    while (running.load(std::memory_order_acquire))
+    {
+        if (options_.rate > 0)
+        {
+            // paced against the start, so a late batch is caught up rather than lost
+            auto due = start + std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double>(sent / options_.rate));
+            if (due > Clock::now())
+            {
+                std::this_thread::sleep_until(due);
+            }
+        }
+
+        for (std::size_t i = 0; i < options_.batch; i++)
+        {
+            auto& datagram      = datagrams_[(next + i) % datagrams_.size()];
+            iovecs_[i].iov_base = datagram.data();
+            iovecs_[i].iov_len  = datagram.size();
+        }
+
+        int n = sendmmsg(fd_, msgs_.data(), static_cast<unsigned int>(msgs_.size()), 0);
+        if (n < 0)
+        {
+            send_errors_.store(send_errors_.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1)); // don't spin on errors
+            continue;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            lines += lines_[(next + static_cast<std::size_t>(i)) % datagrams_.size()];
+        }
+        next = (next + static_cast<std::size_t>(n)) % datagrams_.size();
+        sent += static_cast<uint64_t>(n);
+
+        datagrams_sent_.store(sent, std::memory_order_relaxed);
+        lines_sent_.store(lines, std::memory_order_relaxed);
+    }
+}
+} // namespace metric_collector::loadgen
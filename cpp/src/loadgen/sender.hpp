@@ -0,0 +1,64 @@
+#ifndef METRIC_COLLECTOR_LOADGEN_SENDER_HPP
+#define METRIC_COLLECTOR_LOADGEN_SENDER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+namespace metric_collector::loadgen
+{
+struct SenderOptions
+{
+    std::string addr{"127.0.0.1"};
+    uint16_t    port{8125};
+    std::size_t batch{64}; // datagrams per sendmmsg
+    double      rate{0.0}; // datagrams per second, 0 sends as fast as the socket takes them
+};
+
+// One sending thread's socket, cycling through its prebuilt datagrams with sendmmsg. Counters
+// are written by the sending thread only and can be read from any other.
+class Sender
+{
+  public:
+    Sender(SenderOptions options, std::vector<std::string> datagrams);
+    ~Sender();
+
+    Sender(const Sender&)            = delete;
+    Sender& operator=(const Sender&) = delete;
+
+    // sends until running is cleared
+    void run(const std::atomic<bool>& running);
+
+    [[nodiscard]] uint64_t datagrams_sent() const noexcept
+    {
+        return datagrams_sent_.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] uint64_t lines_sent() const noexcept
+    {
+        return lines_sent_.load(std::memory_order_relaxed);
+    }
+    // failed sendmmsg calls, e.g. ECONNREFUSED while nothing listens
+    [[nodiscard]] uint64_t send_errors() const noexcept
+    {
+        return send_errors_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    SenderOptions            options_;
+    std::vector<std::string> datagrams_;
+    std::vector<uint32_t>    lines_; // per datagram
+    int                      fd_{-1};
+
+    std::vector<iovec>   iovecs_;
+    std::vector<mmsghdr> msgs_;
+
+    std::atomic<uint64_t> datagrams_sent_{0};
+    std::atomic<uint64_t> lines_sent_{0};
+    std::atomic<uint64_t> send_errors_{0};
+};
+} // namespace metric_collector::loadgen
+
+#endif
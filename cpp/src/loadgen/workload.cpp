@@ -0,0 +1,126 @@
+#include "workload.hpp"
+
+#include <algorithm>
+#include <array>
+#include <metrics.hpp>
+#include <numeric>
+#include <random>
+
+namespace metric_collector::loadgen
+{
+namespace
+{
+using aggregation::MetricType;
+
+constexpr std::array<const char*, 4> SUFFIXES = {"requests", "queue_depth", "latency", "users"};
+constexpr std::array<const char*, 4> TYPES    = {"c", "g", "t", "s"};
+
+// the same key always draws the same type, whichever sender builds it
+MetricType type_of(std::size_t key, const TypeMix& mix)
+{
+    std::array<uint32_t, 4> weights = {mix.counters, mix.gauges, mix.timers, mix.sets};
+    uint64_t total = std::accumulate(weights.begin(), weights.end(), uint64_t{0});
+
+    // splitmix64 finaliser, a whole generator per key would dominate setup at 1M keys
+    uint64_t pick = key + 0x9E3779B97F4A7C15ULL;
+    pick          = (pick ^ (pick >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    pick          = (pick ^ (pick >> 27)) * 0x94D049BB133111EBULL;
+    pick          = (pick ^ (pick >> 31)) % total;
+    for (std::size_t i = 0; i < weights.size(); i++)
+    {
+        if (pick < weights[i])
+        {
+            return static_cast<MetricType>(i);
+        }
+        pick -= weights[i];
+    }
+    return MetricType::Counter;
+}
+
+std::string value_of(MetricType type, std::mt19937_64& rng)
+{
+    switch (type)
+    {
+    case MetricType::Counter:
+        return std::to_string(1 + rng() % 10);
+    case MetricType::Gauge:
+        return std::to_string(rng() % 1000);
+    case MetricType::Timer:
+    {
+        // latencies in ms, mostly fast with a long tail
+        std::exponential_distribution<double> latency(1.0 / 50.0);
+        return std::to_string(static_cast<uint64_t>(latency(rng)));
+    }
+    default:
+        return "user" + std::to_string(rng() % 10000);
+    }
+}
+
+std::string line_of(std::size_t key, const WorkloadOptions& options, std::mt19937_64& rng)
+{
+    auto        type = type_of(key, options.mix);
+    auto        kind = static_cast<std::size_t>(type);
+    std::string name = "service" + std::to_string(key % 64) + ".api.endpoint" +
+                       std::to_string(key) + "." + SUFFIXES[kind];
+
+    std::uniform_real_distribution<double> percent(0.0, 100.0);
+    if (percent(rng) < options.malformed)
+    {
+        // the usual client bugs: no type, a value that is not a number, an unknown type
+        switch (rng() % 3)
+        {
+        case 0:
+            return name + ":" + value_of(type, rng) + "\n";
+        case 1:
+            return name + ":n/a|c\n";
+        default:
+            return name + ":1|x\n";
+        }
+    }
+
+    auto line = name + ":" + value_of(type, rng) + "|" + TYPES[kind] + "\n";
+    if (percent(rng) < options.conflicting)
+    {
+        // next to the real line, so the name is seen with both types every round
+        auto other = type == MetricType::Set ? MetricType::Counter : MetricType::Set;
+        line += name + ":" + value_of(other, rng) + "|" + TYPES[static_cast<std::size_t>(other)] +
+                "\n";
+    }
+    return line;
+}
+} // namespace
+
+std::vector<std::string> make_datagrams(const WorkloadOptions& options, std::size_t sender,
+                                        std::size_t senders)
+{
+    std::vector<std::size_t> keys(options.keys * (sender + 1) / senders -
+                                  options.keys * sender / senders);
+    std::iota(keys.begin(), keys.end(), options.keys * sender / senders);
+
+    std::mt19937_64 rng(options.seed + sender);
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    std::vector<std::string> datagrams;
+    std::string              datagram;
+    std::size_t              lines = 0;
+    for (auto key : keys)
+    {
+        auto line = line_of(key, options, rng);
+        if (lines != 0 && (lines == options.lines_per_datagram ||
+                           datagram.size() + line.size() > options.max_datagram))
+        {
+            datagrams.push_back(std::move(datagram));
+            datagram.clear();
+            lines = 0;
+        }
+        datagram += line;
+        lines++;
+    }
+
+    if (lines != 0)
+    {
+        datagrams.push_back(std::move(datagram));
+    }
+    return datagrams;
+}
+} // namespace metric_collector::loadgen
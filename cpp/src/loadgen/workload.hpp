@@ -0,0 +1,40 @@
+#ifndef METRIC_COLLECTOR_LOADGEN_WORKLOAD_HPP
+#define METRIC_COLLECTOR_LOADGEN_WORKLOAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace metric_collector::loadgen
+{
+// Relative weights of the metric types, every key keeps the type it is drawn once.
+struct TypeMix
+{
+    uint32_t counters{60};
+    uint32_t gauges{10};
+    uint32_t timers{25};
+    uint32_t sets{5};
+};
+
+struct WorkloadOptions
+{
+    std::size_t keys{10000};
+    TypeMix     mix;
+    std::size_t lines_per_datagram{16};
+    // lines are packed up to this many bytes even if that leaves a datagram short of lines
+    std::size_t max_datagram{512};
+    // percent of lines that are garbage, and of keys also sent under another type
+    double   malformed{0.0};
+    double   conflicting{0.0};
+    uint64_t seed{42};
+};
+
+// Ready to send StatsD payloads for one of senders threads. The senders split the keys between
+// them, and the datagrams of each one cover its share once in random order with realistic
+// names and values, so cycling through them keeps every key alive.
+std::vector<std::string> make_datagrams(const WorkloadOptions& options, std::size_t sender,
+                                        std::size_t senders);
+} // namespace metric_collector::loadgen
+
+#endif
@@ -1,9 +1,232 @@
 #include "bucket_ring.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <cpu_affinity.hpp>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <metrics.hpp>
+#include <metrics_server.hpp>
+#include <optional>
+#include <prometheus_page.hpp>
+#include <rotation_scheduler.hpp>
+#include <self_stats.hpp>
+#include <snapshot_file.hpp>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include <udp_server.hpp>
+#include <upstream_forwarder.hpp>
+#include <utility>
+#include <vector>
 
 using namespace metric_collector::aggregation;
+using namespace metric_collector::exposition;
+using namespace metric_collector::ingestion;
 
-int main() { auto server = new metric_collector::ingestion::UdpServer(8080, "localhost", 10); }
\ No newline at end of file
+// collectors forward to collectors, a forwarded datagram has to arrive whole at the next tier
+static_assert(DEFAULT_UPSTREAM_PAYLOAD <= MAX_PACKET);
+
+namespace
+{
+// the whole of digits as a number, nullopt on anything else
+std::optional<std::size_t> parse_size(std::string_view digits)
+{
+    std::size_t value  = 0;
+    auto        end    = digits.data() + digits.size();
+    auto        parsed = std::from_chars(digits.data(), end, value);
+    if (parsed.ec != std::errc{} || parsed.ptr != end)
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// a limit that does not parse keeps its default rather than turning into 0, i.e. no limit
+void read_limit(const char* variable, std::size_t& limit)
+{
+    const char* value = std::getenv(variable);
+    if (value == nullptr)
+    {
+        return;
+    }
+
+    auto parsed = parse_size(value);
+    if (!parsed.has_value())
+    {
+        std::cerr << "---> " << variable << " must be a number of names, ignoring it\n";
+        return;
+    }
+    limit = *parsed;
+}
+
+// prefix=n,prefix=n; an item without a prefix or a limit of at least 1 is left out
+std::vector<PrefixLimit> parse_prefix_limits(std::string_view list)
+{
+    std::vector<PrefixLimit> prefixes;
+    while (!list.empty())
+    {
+        auto             comma = list.find(',');
+        std::string_view item  = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+
+        auto equals = item.rfind('=');
+        auto limit  = equals == std::string_view::npos ? std::nullopt
+                                                       : parse_size(item.substr(equals + 1));
+        if (equals == 0 || !limit.has_value() || *limit == 0)
+        {
+            std::cerr << "---> METRIC_COLLECTOR_PREFIX_LIMITS item '" << item
+                      << "' must be prefix=n with n >= 1, ignoring it\n";
+            continue;
+        }
+        prefixes.push_back({std::string(item.substr(0, equals)), *limit});
+    }
+    return prefixes;
+}
+} // namespace
+
+int main()
+{
+    // METRIC_COLLECTOR_MAX_NAMES=n caps the distinct names of a window, the rest are dropped
+    CardinalityLimits limits;
+    read_limit("METRIC_COLLECTOR_MAX_NAMES", limits.max_names);
+    // METRIC_COLLECTOR_MAX_INTERNED=n caps the names in use across windows
+    read_limit("METRIC_COLLECTOR_MAX_INTERNED", limits.max_interned);
+    // METRIC_COLLECTOR_PREFIX_LIMITS=api.=1000,batch.=50 caps the names of a window under each
+    // prefix, a name counts against the longest prefix it starts with
+    if (const char* prefixes = std::getenv("METRIC_COLLECTOR_PREFIX_LIMITS"))
+    {
+        limits.prefixes = parse_prefix_limits(prefixes);
+    }
+    // METRIC_COLLECTOR_OVERFLOW=fold sends the samples of names over a limit to the limit's
+    // overflow metric, reject (the default) drops them
+    if (const char* overflow = std::getenv("METRIC_COLLECTOR_OVERFLOW"))
+    {
+        std::string_view action(overflow);
+        if (action == "reject")
+        {
+            limits.action = OverflowAction::Reject;
+        }
+        else if (action == "fold")
+        {
+            limits.action = OverflowAction::Fold;
+        }
+        else
+        {
+            std::cerr << "---> METRIC_COLLECTOR_OVERFLOW must be reject or fold, ignoring it\n";
+        }
+    }
+
+    // METRIC_COLLECTOR_LISTENER_CPUS and METRIC_COLLECTOR_WORKER_CPUS=0-3,8 pin the threads,
+    // METRIC_COLLECTOR_NIC=eth0 runs one listener on each cpu taking the NIC's rx interrupts and
+    // steers every datagram to the listener on the cpu that received it
+    UdpServerOptions options{.port = 8080, .addr = "0.0.0.0", .num_workers = 10};
+    if (const char* cpus = std::getenv("METRIC_COLLECTOR_LISTENER_CPUS"))
+    {
+        options.listener_cpus = parse_cpu_list(cpus);
+    }
+    if (const char* cpus = std::getenv("METRIC_COLLECTOR_WORKER_CPUS"))
+    {
+        options.worker_cpus = parse_cpu_list(cpus);
+    }
+    // METRIC_COLLECTOR_MAX_DATAGRAM=n receives datagrams up to n bytes whole,
+    // METRIC_COLLECTOR_UDP_GRO=1 lets the kernel coalesce datagrams into one receive buffer
+    if (const char* max_datagram = std::getenv("METRIC_COLLECTOR_MAX_DATAGRAM"))
+    {
+        auto parsed = parse_size(max_datagram);
+        if (!parsed.has_value() || *parsed == 0 || *parsed > MAX_DATAGRAM)
+        {
+            std::cerr << "---> METRIC_COLLECTOR_MAX_DATAGRAM must be between 1 and "
+                      << MAX_DATAGRAM << ", keeping " << options.max_datagram << "\n";
+        }
+        else
+        {
+            options.max_datagram = *parsed;
+        }
+    }
+    if (const char* gro = std::getenv("METRIC_COLLECTOR_UDP_GRO"))
+    {
+        std::string_view value(gro);
+        if (value == "1" || value == "0")
+        {
+            options.udp_gro = value == "1";
+        }
+        else
+        {
+            std::cerr << "---> METRIC_COLLECTOR_UDP_GRO must be 0 or 1, ignoring it\n";
+        }
+    }
+    if (const char* nic = std::getenv("METRIC_COLLECTOR_NIC"))
+    {
+        auto irq_cpus = nic_irq_cpus(nic);
+        if (!irq_cpus.empty())
+        {
+            options.listener_cpus = std::move(irq_cpus);
+            options.num_listeners = options.listener_cpus.size();
+            options.num_workers   = std::max(options.num_workers, options.num_listeners);
+            options.steering      = Steering::CpuBpf;
+        }
+    }
+
+    auto ring   = std::make_unique<MetricRing>(std::move(limits));
+    auto server = std::make_unique<UdpServer>(std::move(options), *ring);
+
+    // every sealed window is exported for the control plane and rendered for scrapes
+    SnapshotFileWriter exporter("/dev/shm/metric_collector.snapshot");
+    PrometheusPage     page;
+    MetricsServer      metrics_server(DEFAULT_METRICS_PORT, "0.0.0.0", page);
+    metrics_server.start();
+
+    // METRIC_COLLECTOR_UPSTREAM=host:port forwards every sealed window to the next tier, host
+    // is a name, an IPv4 address or an IPv6 address in brackets
+    std::unique_ptr<UpstreamForwarder> forwarder;
+    if (const char* upstream = std::getenv("METRIC_COLLECTOR_UPSTREAM"))
+    {
+        std::string_view target(upstream);
+        auto             colon = target.rfind(':');
+        std::string_view host  = target.substr(0, std::min(colon, target.size()));
+        std::string_view digits =
+            colon == std::string_view::npos ? std::string_view{} : target.substr(colon + 1);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+        {
+            host = host.substr(1, host.size() - 2);
+        }
+
+        uint16_t port   = 0;
+        auto     end    = digits.data() + digits.size();
+        auto     parsed = std::from_chars(digits.data(), end, port);
+        if (host.empty() || parsed.ec != std::errc{} || parsed.ptr != end || port == 0)
+        {
+            std::cerr << "---> METRIC_COLLECTOR_UPSTREAM must be host:port with a port in "
+                         "1-65535, not forwarding\n";
+        }
+        else
+        {
+            forwarder = std::make_unique<UpstreamForwarder>(
+                ForwarderOptions{.host = std::string(host), .port = port});
+            forwarder->start();
+        }
+    }
+
+    RotationScheduler<MetricRing> scheduler(*ring, DEFAULT_WINDOW_INTERVAL,
+                                            [&ring, &exporter, &page, &forwarder]()
+                                            {
+                                                auto snapshot = ring->snapshot();
+                                                if (snapshot == nullptr)
+                                                {
+                                                    return;
+                                                }
+                                                exporter.write(*snapshot);
+                                                page.render(*snapshot, SelfStats::read(),
+                                                            ring->cardinality_stats());
+                                                if (forwarder != nullptr)
+                                                {
+                                                    forwarder->submit(std::move(snapshot));
+                                                }
+                                            });
+    scheduler.start();
+
+    server->run();
+}
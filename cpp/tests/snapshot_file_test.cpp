@@ -0,0 +1,207 @@
+#include <bucket_ring.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <local_table.hpp>
+#include <memory>
+#include <snapshot_file.hpp>
+#include <snapshot_format.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Writes a window holding every metric type, reads it back and compares it with the snapshot it
+// came from, then checks that damaged copies of the file are refused.
+
+using namespace metric_collector::aggregation;
+
+namespace fmt = snapshot_format;
+
+namespace
+{
+constexpr std::size_t NUM_NAMES = 4096;
+
+int failures = 0;
+
+void expect(bool ok, std::string_view what)
+{
+    if (!ok)
+    {
+        std::cerr << "---> FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+// why the file disagrees with the snapshot it was written from, nullptr if it does not
+const char* compare(const Snapshot& snapshot, const SnapshotFileReader& reader)
+{
+    if (reader.epoch() != snapshot.epoch() || reader.size() != snapshot.size())
+    {
+        return "header differs from the snapshot";
+    }
+
+    const char* mismatch = nullptr;
+    snapshot.for_each(
+        [&reader, &mismatch](std::string_view name, const MetricValue& value)
+        {
+            auto row = reader.find(name);
+            if (!row.has_value() || reader.name(*row) != name)
+            {
+                mismatch = "a name is not found";
+                return;
+            }
+            if (static_cast<std::size_t>(reader.type(*row)) != value.metric.index())
+            {
+                mismatch = "a type differs";
+                return;
+            }
+
+            bool same = std::visit(
+                [&reader, &row](const auto& metric)
+                {
+                    using T = std::decay_t<decltype(metric)>;
+                    if constexpr (std::same_as<T, Timer>)
+                    {
+                        auto summary = reader.timer(*row);
+                        return summary.count == metric.count() && summary.sum == metric.sum() &&
+                               summary.max == metric.max() &&
+                               summary.p99 == metric.percentile(0.99) &&
+                               summary.p999 == metric.percentile(0.999);
+                    }
+                    else if constexpr (std::same_as<T, Set>)
+                    {
+                        return reader.value(*row) == metric.count();
+                    }
+                    else
+                    {
+                        return reader.value(*row) == metric.get();
+                    }
+                },
+                value.metric);
+            if (!same)
+            {
+                mismatch = "a value differs";
+            }
+        });
+    if (mismatch == nullptr && reader.find("no.such.metric").has_value())
+    {
+        mismatch = "a missing name is found";
+    }
+    return mismatch;
+}
+
+std::string read_file(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// a copy of the file changed by damage has to be refused when opened
+void expect_refused(const std::string& path, const std::string& original, std::string_view what,
+                    const std::function<void(std::string&)>& damage)
+{
+    std::string bytes = original;
+    damage(bytes);
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+
+    bool refused = false;
+    try
+    {
+        SnapshotFileReader reader(path);
+    }
+    catch (const std::runtime_error&)
+    {
+        refused = true;
+    }
+    expect(refused, what);
+}
+
+uint32_t* name_offsets(std::string& bytes)
+{
+    fmt::Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    auto offset = header.columns[static_cast<std::size_t>(fmt::ColumnId::NameOffsets)].offset;
+    return reinterpret_cast<uint32_t*>(bytes.data() + offset);
+}
+} // namespace
+
+int main()
+{
+    std::string path =
+        (std::filesystem::temp_directory_path() / "metric_collector_test.snapshot").string();
+
+    auto       ring = std::make_unique<MetricRing>();
+    LocalTable local(ring->names());
+    for (std::size_t i = 0; i < NUM_NAMES; i++)
+    {
+        auto suffix = std::to_string(i);
+        local.add<Counter>("roundtrip.counter" + suffix, i);
+        local.add<Gauge>("roundtrip.gauge" + suffix, i);
+        local.add<Timer>("roundtrip.timer" + suffix, i);
+        local.add<Timer>("roundtrip.timer" + suffix, 2 * i + 1);
+        local.add<Set>("roundtrip.set" + suffix, i);
+        local.add<Set>("roundtrip.set" + suffix, i + 1);
+    }
+    ring->merge(local);
+    ring->rotate();
+    auto snapshot = ring->snapshot();
+
+    SnapshotFileWriter writer(path);
+    expect(writer.write(*snapshot), "the snapshot file is written");
+
+    std::string names[2];
+    try
+    {
+        SnapshotFileReader reader(path);
+        if (const char* mismatch = compare(*snapshot, reader))
+        {
+            expect(false, mismatch);
+        }
+        names[0] = reader.name(0);
+        names[1] = reader.name(1);
+    }
+    catch (const std::runtime_error& e)
+    {
+        expect(false, e.what());
+    }
+
+    auto original = read_file(path);
+
+    expect_refused(path, original, "a file with two names swapped is refused",
+                   [&names](std::string& bytes)
+                   {
+                       auto first  = bytes.find(names[0]);
+                       auto second = bytes.find(names[1], first + names[0].size());
+                       bytes.replace(second, names[1].size(), names[0]);
+                       bytes.replace(first, names[0].size(), names[1]);
+                   });
+
+    // the ends stay in bounds, the offsets in between point far past the mapping
+    expect_refused(path, original, "a file with name offsets past the names is refused",
+                   [](std::string& bytes)
+                   {
+                       auto* offsets = name_offsets(bytes);
+                       offsets[1]    = UINT32_MAX - 1;
+                       offsets[2]    = UINT32_MAX;
+                   });
+
+    expect_refused(path, original, "a truncated file is refused",
+                   [](std::string& bytes) { bytes.resize(bytes.size() / 2); });
+
+    expect_refused(path, original, "a file with another magic is refused",
+                   [](std::string& bytes) { bytes[0] ^= 1; });
+
+    std::remove(path.c_str());
+
+    if (failures != 0)
+    {
+        return 1;
+    }
+    std::cout << "snapshot_file: all checks passed\n";
+    return 0;
+}